@@ -0,0 +1,329 @@
+//----------------------------------------------------------------------------
+// Python binding of the HF channel.
+//
+//   import chansim, numpy as np
+//   ch = chansim.Channel(snr=15, chan=3, seed=1)
+//   ch.process(x)          # float32 array, in place
+//   ch.process(x, y)       # from x into y, same length
+//   iq = chansim.Channel(snr=15, chan=3, rate=192000, iq=True)
+//   iq.process(z)          # complex64 array
+//
+// Any object with a contiguous float32 (complex64 in IQ mode) buffer
+// works. No data is copied, and the GIL is released while processing, so
+// threads can run many channels at once. Each Channel holds a lock: calls on the same object
+// are serialized.
+//----------------------------------------------------------------------------
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+
+#include <string.h>
+#include <time.h>
+
+#include "channel.h"
+#include "filter.h"
+
+typedef struct {
+	PyObject_HEAD
+	struct channel_s *ch;
+	PyThread_type_lock lock;
+} ChannelObject;
+
+static const char *const ParmKeys[] = {
+	"snr", "chan", "noise", "seed", "rate", "bw", "ampl",
+	"offset", "drift", "doppler0", "doppler1", "ramp", "iq", "hilbert", NULL
+};
+
+/*
+ * Parse keyword settings on top of 'p'. 'ramp' may be NULL.
+ * Returns 0, or -1 with an exception set.
+ */
+static int parse_parms(PyObject *args, PyObject *kwds, struct chan_parms_s *p, float *ramp)
+{
+	unsigned long seed = p->seed;
+	float r = 0.0F;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|fiikifffffffpi", (char **)ParmKeys,
+					 &p->snr, &p->simform, &p->noisetype, &seed,
+					 &p->samplerate, &p->bandwidth, &p->amplitude,
+					 &p->offset, &p->drift, &p->doppler0, &p->doppler1, &r,
+					 &p->iq, &p->hilbert))
+		return -1;
+	p->seed = (unsigned int)seed;
+
+	if (p->simform < 0 || p->simform > 7) {
+		PyErr_SetString(PyExc_ValueError, "invalid channel type");
+		return -1;
+	}
+	if (p->noisetype < 0 || p->noisetype > 2) {
+		PyErr_SetString(PyExc_ValueError, "invalid noise type");
+		return -1;
+	}
+	if (p->samplerate <= 0 || p->bandwidth <= 0.0F) {
+		PyErr_SetString(PyExc_ValueError, "invalid rate or bandwidth");
+		return -1;
+	}
+	if (p->hilbert < FILTER_FIR || p->hilbert > FILTER_IIR_BAND) {
+		PyErr_SetString(PyExc_ValueError, "invalid Hilbert transformer");
+		return -1;
+	}
+	if (r < 0.0F || (r != 0.0F && !ramp)) {
+		PyErr_SetString(PyExc_ValueError, "invalid ramp");
+		return -1;
+	}
+	if (ramp)
+		*ramp = r;
+
+	return 0;
+}
+
+static int Channel_init(ChannelObject *self, PyObject *args, PyObject *kwds)
+{
+	struct chan_parms_s p;
+
+	memset(&p, 0, sizeof(p));
+	p.snr = 30.0F;
+	p.samplerate = 8000;
+	p.bandwidth = 3000.0F;
+	p.seed = (unsigned int)time(NULL);
+
+	if (parse_parms(args, kwds, &p, NULL) < 0)
+		return -1;
+
+	if (self->ch)
+		clear_channel(self->ch);
+	if ((self->ch = init_channel(&p)) == NULL) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	return 0;
+}
+
+static PyObject *Channel_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	ChannelObject *self;
+
+	(void)args;
+	(void)kwds;
+
+	if ((self = (ChannelObject *)type->tp_alloc(type, 0)) == NULL)
+		return NULL;
+
+	if ((self->lock = PyThread_allocate_lock()) == NULL) {
+		Py_DECREF(self);
+		return PyErr_NoMemory();
+	}
+
+	return (PyObject *)self;
+}
+
+static void Channel_dealloc(ChannelObject *self)
+{
+	if (self->ch)
+		clear_channel(self->ch);
+	if (self->lock)
+		PyThread_free_lock(self->lock);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Get a contiguous buffer of float32, or complex64 (format "Zf") for a
+ * channel in IQ mode.
+ */
+static int get_float_buffer(PyObject *obj, Py_buffer *view, int writable, int iq)
+{
+	int flags = PyBUF_FORMAT | PyBUF_ANY_CONTIGUOUS | (writable ? PyBUF_WRITABLE : 0);
+	const char *fmt;
+
+	if (PyObject_GetBuffer(obj, view, flags) < 0)
+		return -1;
+
+	// accept native types only: "f", "=f" or "<f"/">f" matching this host
+	fmt = view->format ? view->format : "B";
+	if (*fmt == '@' || *fmt == '=')
+		fmt++;
+#if PY_LITTLE_ENDIAN
+	else if (*fmt == '<')
+		fmt++;
+#else
+	else if (*fmt == '>' || *fmt == '!')
+		fmt++;
+#endif
+	if (iq && (strcmp(fmt, "Zf") || view->itemsize != sizeof(float_complex))) {
+		PyBuffer_Release(view);
+		PyErr_SetString(PyExc_TypeError, "expected a contiguous complex64 buffer");
+		return -1;
+	}
+	if (!iq && (strcmp(fmt, "f") || view->itemsize != sizeof(float))) {
+		PyBuffer_Release(view);
+		PyErr_SetString(PyExc_TypeError, "expected a contiguous float32 buffer");
+		return -1;
+	}
+
+	return 0;
+}
+
+static PyObject *Channel_process(ChannelObject *self, PyObject *args)
+{
+	PyObject *inobj, *outobj = NULL;
+	Py_buffer in, out;
+	Py_ssize_t len, n;
+	const float *ip;
+	float *op;
+	int iq = self->ch->parms.iq;
+	int step = iq ? 2 : 1;		/* floats per sample */
+
+	if (!PyArg_ParseTuple(args, "O|O:process", &inobj, &outobj))
+		return NULL;
+
+	if (outobj == NULL || outobj == inobj) {
+		if (get_float_buffer(inobj, &in, 1, iq) < 0)
+			return NULL;
+		ip = op = in.buf;
+		len = in.len / in.itemsize;
+	} else {
+		if (get_float_buffer(inobj, &in, 0, iq) < 0)
+			return NULL;
+		if (get_float_buffer(outobj, &out, 1, iq) < 0) {
+			PyBuffer_Release(&in);
+			return NULL;
+		}
+		if (out.len != in.len) {
+			PyBuffer_Release(&in);
+			PyBuffer_Release(&out);
+			PyErr_SetString(PyExc_ValueError, "input and output differ in length");
+			return NULL;
+		}
+		ip = in.buf;
+		op = out.buf;
+		len = in.len / in.itemsize;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(self->lock, WAIT_LOCK);
+	// channel_process() takes an int length
+	for (; len > 0; len -= n, ip += n * step, op += n * step) {
+		n = (len > (1 << 29)) ? (1 << 29) : len;
+		if (iq)
+			channel_process_iq(self->ch, (const float_complex *)ip, (float_complex *)op, (int)n);
+		else
+			channel_process(self->ch, ip, op, (int)n);
+	}
+	PyThread_release_lock(self->lock);
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&in);
+	if (outobj != NULL && outobj != inobj)
+		PyBuffer_Release(&out);
+
+	Py_RETURN_NONE;
+}
+
+static PyObject *Channel_reconfigure(ChannelObject *self, PyObject *args, PyObject *kwds)
+{
+	struct chan_parms_s p;
+	float ramp = 0.0F;
+	int err;
+
+	PyThread_acquire_lock(self->lock, WAIT_LOCK);
+	p = self->ch->parms;
+	PyThread_release_lock(self->lock);
+
+	if (parse_parms(args, kwds, &p, &ramp) < 0)
+		return NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	PyThread_acquire_lock(self->lock, WAIT_LOCK);
+	err = channel_reconfigure(self->ch, &p, ramp);
+	PyThread_release_lock(self->lock);
+	Py_END_ALLOW_THREADS
+
+	if (err < 0) {
+		PyErr_SetString(PyExc_ValueError, "reconfiguration failed (rate, seed and iq are fixed)");
+		return NULL;
+	}
+
+	Py_RETURN_NONE;
+}
+
+static PyObject *Channel_get_parms(ChannelObject *self, void *closure)
+{
+	const struct chan_parms_s *p = &self->ch->parms;
+
+	(void)closure;
+
+	return Py_BuildValue("{s:f,s:i,s:i,s:k,s:i,s:f,s:f,s:f,s:f,s:f,s:f,s:O,s:i}",
+			     "snr", p->snr, "chan", p->simform, "noise", p->noisetype,
+			     "seed", (unsigned long)p->seed, "rate", p->samplerate,
+			     "bw", p->bandwidth, "ampl", p->amplitude,
+			     "offset", p->offset, "drift", p->drift,
+			     "doppler0", p->doppler0, "doppler1", p->doppler1,
+			     "iq", p->iq ? Py_True : Py_False, "hilbert", p->hilbert);
+}
+
+static PyMethodDef Channel_methods[] = {
+	{ "process", (PyCFunction)Channel_process, METH_VARARGS,
+	  "process(x[, y])\n\n"
+	  "Push the float32 samples of x (complex64 in IQ mode) through the\n"
+	  "channel, in place or into y." },
+	{ "reconfigure", (PyCFunction)(void (*)(void))Channel_reconfigure, METH_VARARGS | METH_KEYWORDS,
+	  "reconfigure(**settings)\n\n"
+	  "Change settings of the running channel, except rate, seed and iq.\n"
+	  "ramp=<seconds> ramps an SNR change." },
+	{ NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef Channel_getset[] = {
+	{ "parms", (getter)Channel_get_parms, NULL, "current settings as a dict", NULL },
+	{ NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject ChannelType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "chansim.Channel",
+	.tp_basicsize = sizeof(ChannelObject),
+	.tp_dealloc = (destructor)Channel_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Channel(snr=30, chan=0, noise=0, seed=<time>, rate=8000, bw=3000,\n"
+		  "        ampl=0, offset=0, drift=0, doppler0=0, doppler1=0, iq=False,\n"
+		  "        hilbert=0)\n\n"
+		  "Watterson HF channel. chan is the channel type 0..7, noise the\n"
+		  "noise type 0..2, ampl the input RMS (0 = measure at runtime).\n"
+		  "iq=True processes complex baseband instead of real audio.\n"
+		  "hilbert selects the Hilbert transformer like chansim -H.",
+	.tp_methods = Channel_methods,
+	.tp_getset = Channel_getset,
+	.tp_init = (initproc)Channel_init,
+	.tp_new = Channel_new,
+};
+
+static struct PyModuleDef chansim_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "chansim",
+	.m_doc = "Watterson Ionospheric Gaussian-Scatter HF Channel Model",
+	.m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_chansim(void)
+{
+	PyObject *m;
+
+	if (PyType_Ready(&ChannelType) < 0)
+		return NULL;
+
+	if ((m = PyModule_Create(&chansim_module)) == NULL)
+		return NULL;
+
+	Py_INCREF(&ChannelType);
+	if (PyModule_AddObject(m, "Channel", (PyObject *)&ChannelType) < 0) {
+		Py_DECREF(&ChannelType);
+		Py_DECREF(m);
+		return NULL;
+	}
+
+	PyModule_AddStringConstant(m, "version", Version);
+
+	return m;
+}
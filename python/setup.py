@@ -0,0 +1,27 @@
+# Build the chansim Python module:
+#   python3 setup.py build_ext --inplace
+# or: pip install ./python
+
+import os
+from setuptools import setup, Extension
+
+src = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+src = os.path.relpath(src)
+
+core = ["channel.c", "delay.c", "fade.c", "filter.c", "nco.c", "noise.c", "qrm.c", "ring.c", "rms.c"]
+
+chansim = Extension(
+    "chansim",
+    sources=["chansimmodule.c"] + [os.path.join(src, f) for f in core],
+    include_dirs=[src],
+    define_macros=[("_GNU_SOURCE", None)],
+    extra_compile_args=["-std=c99", "-O2"] if os.name != "nt" else [],
+    libraries=["m"] if os.name != "nt" else [],
+)
+
+setup(
+    name="chansim",
+    version="0.56",
+    description="Watterson Ionospheric Gaussian-Scatter HF Channel Model",
+    ext_modules=[chansim],
+)
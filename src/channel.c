@@ -0,0 +1,913 @@
+
+#define _USE_MATH_DEFINES
+
+#include "chansim.h"
+#include "channel.h"
+#include "filter.h"
+#include "rms.h"
+#include "noise.h"
+#include "nco.h"
+#include "fade.h"
+#include "delay.h"
+#include "qrm.h"
+#include "fpmode.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DIRECT		1.0F	// These describe how to combine
+#define DELAYED		1.0F	// direct and delayed paths
+
+#define RAMP_STEP	16	// samples per step of an SNR ramp
+#define SILENT_MAX	(1 << 30)	// zero input samples counted at most
+#define SEED_NOISEQ	0x4e5351U	// the quadrature noise is seeded with seed ^ this ("NSQ")
+
+//----------------------------------------------------------------------------
+// Initialize simulation paramaters.
+//----------------------------------------------------------------------------
+static void SetParms(struct channel_s *ch, float snr, int simform)
+{
+	// convert from dB to voltage ratio
+	ch->SigLvl = powf(10.0F, snr / 20.0F);
+	ch->SigTarget = ch->SigLvl;
+	ch->SigStep = 0.0F;
+	ch->rampleft = 0;
+
+	switch (simform) {
+	default:
+	case 0:				// NOISE ONLY
+		ch->DelTime = 0.0F;
+		ch->FrSpread = 0.0F;
+		break;
+	case 1:				// FLAT 1
+		ch->DelTime = 0.0F;	// 0.0 ms delay
+		ch->FrSpread = 0.2F;	// 0.2 Hz spread
+		break;
+	case 2:				// FLAT 2
+		ch->DelTime = 0.0F;	// 0.0 ms delay
+		ch->FrSpread = 1.0F;	// 1.0 Hz spread
+		break;
+	case 3:				// CCIR GOOD
+		ch->DelTime = 0.5e-3F;	// 0.5 ms delay
+		ch->FrSpread = 0.1F;	// 0.1 Hz spread
+		break;
+	case 4:				// CCIR MODERATE
+		ch->DelTime = 1.0e-3F;	// 1.0 ms delay
+		ch->FrSpread = 0.5F;	// 0.5 Hz spread
+		break;
+	case 5:				// CCIR POOR
+		ch->DelTime = 2.0e-3F;	// 2.0 ms delay
+		ch->FrSpread = 1.0F;	// 1.0 Hz spread
+		break;
+	case 6:				// CCIR FLUTTER FADING
+		ch->DelTime = 0.5e-3F;	// 0.5 ms delay
+		ch->FrSpread = 10.0F;	// 10.0 Hz spread
+		break;
+	case 7:				// EXTREME
+		ch->DelTime = 2.0e-3F;	// 2.0 ms delay
+		ch->FrSpread = 5.0F;	// 5.0 Hz spread
+		break;
+	}
+	ch->TapUpdRate = (int)(50.0F * ch->FrSpread + 1.0F);
+}
+
+//------------------------------------------------------------------
+// Count the zero input samples in a row. Returns nonzero if this block
+// and the 'settle' samples before it are zero.
+//------------------------------------------------------------------
+static inline int silence(struct channel_s *ch, const float *in, int size, int iq, int settle)
+{
+	int quiet;
+	int i;
+
+	for (i = 0; i < (iq ? 2 * size : size); i++) {
+		if (in[i] != 0.0F) {
+			ch->silent = 0;
+			return 0;
+		}
+	}
+
+	// an IIR filter still ringing: count from when it has decayed
+	if (settle < 0) {
+		ch->silent = 0;
+		return 0;
+	}
+
+	quiet = (ch->silent >= settle);
+	if (ch->silent < SILENT_MAX)
+		ch->silent += size;
+
+	return quiet;
+}
+
+//------------------------------------------------------------------
+// Pass the state of samples i ... i+n-1 to the probe. The noise is
+// computed like in the kernel, so it is the noise in the output, with
+// the interference.
+//------------------------------------------------------------------
+static void probe_segment(struct channel_s *ch, const struct chan_work_s *w,
+	int i, int n, float SigLvl, int iq, int autorms)
+{
+	struct chan_state_s st;
+	float noise[2 * CHAN_BLOCK];
+	float ampl;
+	int k;
+
+	for (k = 0; k < n; k++) {
+		ampl = (autorms ? w->rmsval[i + k] : ch->parms.amplitude) / SigLvl;
+		if (iq) {
+			ampl *= (float)M_SQRT1_2;
+			noise[2 * k] = w->nbuf[i + k] * ampl;
+			noise[2 * k + 1] = w->nbufq[i + k] * ampl;
+		} else {
+			noise[k] = w->nbuf[i + k] * ampl;
+		}
+	}
+
+	if (ch->qrm) {
+		for (k = 0; k < n; k++) {
+			ampl = autorms ? w->rmsval[i + k] : ch->parms.amplitude;
+			if (iq) {
+				noise[2 * k] += crealf(w->qrm[i + k]) * ampl;
+				noise[2 * k + 1] += cimagf(w->qrm[i + k]) * ampl;
+			} else {
+				noise[k] += crealf(w->qrm[i + k]) * ampl * (float)M_SQRT2;
+			}
+		}
+	}
+
+	st.sample = ch->samples + i;
+	st.n = n;
+	st.iq = iq;
+	st.fade0 = ch->fade0;
+	st.fade1 = ch->fade1;
+	st.delay = ch->delay ? ch->delay->taps : 0;
+	st.noise = noise;
+
+	ch->probe(ch->probe_arg, &st);
+}
+
+//------------------------------------------------------------------
+// Simulated HF channel.
+//------------------------------------------------------------------
+// 1) Form analytic signal, data saved into tapped delay line.
+//    In IQ mode, the input is the analytic (baseband) signal.
+// 2) Shift the frequency (offset, drift and per-path Doppler).
+// 3) Compute fading gain factors (done at an update rate equal
+//    to the symbol rate.)
+// 4) Complex multiply fading gain factors with path components.
+// 5) Add Gaussian noise component magnitude for the specified SNR.
+// 6) Extract real part, or keep the complex signal in IQ mode.
+//
+// The configuration flags are compile time constants in each
+// instantiation below, such that the sample loops carry no
+// configuration branches. Fading gains are held constant over
+// segments between two updates.
+//------------------------------------------------------------------
+static ALWAYS_INLINE void simprocess(struct channel_s *ch, struct chan_work_s *w,
+	const float *input_signal, float *output, int size,
+	const int iq, const int multipath, const int fading, const int shift, const int autorms)
+{
+	float_complex *sig = w->sig;
+	float_complex *dsig = w->dsig;
+	const float_complex *zin = (const float_complex *)input_signal;
+	float_complex *zout = (float_complex *)output;
+	const float *rmsval = w->rmsval;
+	const float *nbuf = w->nbuf;
+	const float *nbufq = w->nbufq;
+	const float amplitude = ch->parms.amplitude;
+	float SigLvl;
+	float f0r, f0i, f1r, f1i;
+	int quiet, settle;
+	int i, k, n, steps;
+
+	// Silent input: once the filter and the delay line hold nothing but
+	// zeros, both paths are zero. Their states are advanced as if the
+	// zeros had been processed, only the noise is computed.
+	if (iq)
+		settle = 0;
+	else
+		settle = ch->analytic ? ch->analytic->settle : filter_settle(ch->filter);
+	if (settle >= 0 && multipath)
+		settle += ch->delay->taps;
+	quiet = silence(ch, input_signal, size, iq, settle);
+
+	if (quiet) {
+		if (!iq && !ch->analytic)
+			filter_zero(ch->filter, size);
+		if (shift && ch->offset)
+			nco_skip(ch->offset, size);
+		if (multipath) {
+			delay_zero(ch->delay, size);
+			if (shift && ch->delayed)
+				nco_skip(ch->delayed, size);
+		}
+		if (shift && ch->direct)
+			nco_skip(ch->direct, size);
+	} else {
+		// Create analytic input signal
+		if (iq) {
+			for (i = 0; i < size; i++)
+				sig[i] = zin[i];
+		} else if (ch->analytic) {
+			memcpy(sig, ch->analytic->sig, size * sizeof(float_complex));
+		} else {
+			filter_block(ch->filter, input_signal, sig, size, 1.0F / (float)M_SQRT2);
+		}
+
+		// Shift the frequency if requested
+		if (shift && ch->offset)
+			nco_mix(ch->offset, sig, size);
+
+		// Delayed (second) path, with its own Doppler shift
+		if (multipath) {
+			delay_block(ch->delay, sig, dsig, size);
+			if (shift && ch->delayed)
+				nco_mix(ch->delayed, dsig, size);
+		}
+
+		// Doppler shift of the direct (first) path
+		if (shift && ch->direct)
+			nco_mix(ch->direct, sig, size);
+	}
+
+	// Compute input signal's RMS
+	// This is needed to scale noise magnitude.
+	if (autorms) {
+		if (iq)
+			rms_block_iq(ch->rms, zin, w->rmsval, size);
+		else
+			rms_block(ch->rms, input_signal, w->rmsval, size);
+	}
+
+	if (ch->qrm)
+		qrm_block(ch->qrm, w->qrm, size);
+
+	for (i = 0; i < size; i += n) {
+		// Fading gain is activated at the "symbol" (update) rate.
+		// Update direct and delayed path fading gain coefficients if needed,
+		// for noise-only simulation, fading gain coefficients stay constant.
+		// The remainder of samplerate / TapUpdRate is carried over, so
+		// the update rate is exact on average at any sample rate.
+		n = size - i;
+		if (fading) {
+			if (ch->pointsleft <= 0) {
+				if (ch->source)
+					ch->source->fade(ch->source->arg, &ch->fade0, &ch->fade1);
+				else
+					FadeGains(ch->fade, &ch->fade0, &ch->fade1);
+				ch->pointsleft = (ch->parms.samplerate + ch->updrem) / ch->TapUpdRate;
+				ch->updrem = (ch->parms.samplerate + ch->updrem) % ch->TapUpdRate;
+			}
+			if (n > ch->pointsleft)
+				n = ch->pointsleft;
+		}
+
+		// SNR ramp after a reconfiguration: the level is held
+		// for RAMP_STEP samples, the sample loop stays the same.
+		// The steps are counted back from the end of the ramp, each
+		// one the same number of dB, wherever the blocks are cut.
+		SigLvl = ch->SigLvl;
+		if (ch->rampleft > 0) {
+			steps = (ch->rampleft + RAMP_STEP - 1) / RAMP_STEP;
+			if (n > ch->rampleft - (steps - 1) * RAMP_STEP)
+				n = ch->rampleft - (steps - 1) * RAMP_STEP;
+			SigLvl = ch->SigTarget * powf(ch->SigStep, (float)steps);
+			ch->rampleft -= n;
+			ch->SigLvl = ch->rampleft ? SigLvl : ch->SigTarget;
+		}
+
+		if (fading)
+			ch->pointsleft -= n;
+
+		// Noise generator generates in-phase and quadrature
+		// noise components that are jointly normal, with each
+		// component having RMS amplitude of unity and RMS noise power
+		// is unity.
+		// Note: noise gets compensated for bandwidth-limiting filter loss.
+		if (ch->source) {
+			ch->source->noise(ch->source->arg, w->nbuf + i, iq ? w->nbufq + i : NULL, n);
+		} else {
+			BandLtdNoiseBlock(ch->noise, w->nbuf + i, n);
+			if (iq)
+				BandLtdNoiseBlock(ch->noiseq, w->nbufq + i, n);
+		}
+
+		if (ch->probe)
+			probe_segment(ch, w, i, n, SigLvl, iq, autorms);
+
+		if (quiet) {
+			for (k = i; k < i + n; k++) {
+				float ampl = (autorms ? rmsval[k] : amplitude) / SigLvl;
+
+				if (iq) {
+					ampl *= (float)M_SQRT1_2;
+					zout[k] = make_float_complex(nbuf[k] * ampl, nbufq[k] * ampl);
+				} else {
+					output[k] = nbuf[k] * ampl;
+				}
+			}
+			continue;
+		}
+
+		f0r = crealf(ch->fade0);
+		f0i = cimagf(ch->fade0);
+		f1r = crealf(ch->fade1);
+		f1i = cimagf(ch->fade1);
+
+		//------------------------------------------------------------------
+		// Holding the fading gain constant for a symbol time,
+		// Use I and Q data for two paths, complex multiply with fading gain
+		// to generate effective outputs for each symbol sample point.
+		// We also have to convert the input RMS to voltage levels.
+		// We don't use imaginary part of the output, except in IQ mode.
+		// There the power of both paths is halved instead of taking
+		// the real part, the noise power is split between I and Q.
+		//------------------------------------------------------------------
+		for (k = i; k < i + n; k++) {
+			float y, yq, inoise, ampl;
+
+			ampl = (autorms ? rmsval[k] : amplitude) / SigLvl;
+
+			if (iq) {
+				if (multipath) {
+					y = (DIRECT * (crealf(sig[k]) * f0r - cimagf(sig[k]) * f0i)
+					  + DELAYED * (crealf(dsig[k]) * f1r - cimagf(dsig[k]) * f1i)) * (float)M_SQRT1_2;
+					yq = (DIRECT * (crealf(sig[k]) * f0i + cimagf(sig[k]) * f0r)
+					   + DELAYED * (crealf(dsig[k]) * f1i + cimagf(dsig[k]) * f1r)) * (float)M_SQRT1_2;
+				} else {
+					y = DIRECT * (crealf(sig[k]) * f0r - cimagf(sig[k]) * f0i);
+					yq = DIRECT * (crealf(sig[k]) * f0i + cimagf(sig[k]) * f0r);
+				}
+				ampl *= (float)M_SQRT1_2;
+				zout[k] = make_float_complex(y + nbuf[k] * ampl, yq + nbufq[k] * ampl);
+				continue;
+			}
+
+			if (multipath) {
+				y = DIRECT * (crealf(sig[k]) * f0r - cimagf(sig[k]) * f0i)
+				  + DELAYED * (crealf(dsig[k]) * f1r - cimagf(dsig[k]) * f1i);
+			} else {
+				// Flat fading
+				y = DIRECT * ((crealf(sig[k]) * f0r - cimagf(sig[k]) * f0i) * (float)M_SQRT2);
+			}
+
+			inoise = nbuf[k] * ampl;
+			output[k] = y + inoise;
+		}
+	}
+
+	// Interference, relative to the input signal like the noise. The
+	// real part of a unit phasor has an RMS of 1 / sqrt(2).
+	if (ch->qrm) {
+		for (k = 0; k < size; k++) {
+			float ampl = autorms ? rmsval[k] : amplitude;
+
+			if (iq)
+				zout[k] = make_float_complex(crealf(zout[k]) + crealf(w->qrm[k]) * ampl,
+							     cimagf(zout[k]) + cimagf(w->qrm[k]) * ampl);
+			else
+				output[k] += crealf(w->qrm[k]) * ampl * (float)M_SQRT2;
+		}
+	}
+
+	ch->samples += size;
+}
+
+//------------------------------------------------------------------
+// Kernel instantiations: iq, multipath, fading, shift, autorms
+//------------------------------------------------------------------
+#define CHAN_KERNEL(IQ, MP, FD, SH, AR) \
+static void simprocess_##IQ##MP##FD##SH##AR(struct channel_s *ch, \
+	struct chan_work_s *w, const float *in, float *out, int size) \
+{ \
+	simprocess(ch, w, in, out, size, IQ, MP, FD, SH, AR); \
+}
+
+#define CHAN_KERNELS(IQ) \
+CHAN_KERNEL(IQ, 0, 0, 0, 0) \
+CHAN_KERNEL(IQ, 0, 0, 0, 1) \
+CHAN_KERNEL(IQ, 0, 0, 1, 0) \
+CHAN_KERNEL(IQ, 0, 0, 1, 1) \
+CHAN_KERNEL(IQ, 0, 1, 0, 0) \
+CHAN_KERNEL(IQ, 0, 1, 0, 1) \
+CHAN_KERNEL(IQ, 0, 1, 1, 0) \
+CHAN_KERNEL(IQ, 0, 1, 1, 1) \
+CHAN_KERNEL(IQ, 1, 0, 0, 0) \
+CHAN_KERNEL(IQ, 1, 0, 0, 1) \
+CHAN_KERNEL(IQ, 1, 0, 1, 0) \
+CHAN_KERNEL(IQ, 1, 0, 1, 1) \
+CHAN_KERNEL(IQ, 1, 1, 0, 0) \
+CHAN_KERNEL(IQ, 1, 1, 0, 1) \
+CHAN_KERNEL(IQ, 1, 1, 1, 0) \
+CHAN_KERNEL(IQ, 1, 1, 1, 1)
+
+CHAN_KERNELS(0)
+CHAN_KERNELS(1)
+
+#define CHAN_KERNEL_TABLE(IQ) \
+	simprocess_##IQ##0000, simprocess_##IQ##0001, simprocess_##IQ##0010, simprocess_##IQ##0011, \
+	simprocess_##IQ##0100, simprocess_##IQ##0101, simprocess_##IQ##0110, simprocess_##IQ##0111, \
+	simprocess_##IQ##1000, simprocess_##IQ##1001, simprocess_##IQ##1010, simprocess_##IQ##1011, \
+	simprocess_##IQ##1100, simprocess_##IQ##1101, simprocess_##IQ##1110, simprocess_##IQ##1111
+
+static const chan_kernel_t Kernels[32] = {
+	CHAN_KERNEL_TABLE(0),
+	CHAN_KERNEL_TABLE(1)
+};
+
+static chan_kernel_t select_kernel(const struct channel_s *ch)
+{
+	int multipath = (ch->DelTime > 0.0F);
+	int fading = (ch->FrSpread > 0.0F);
+	int shift = (ch->offset || ch->direct || ch->delayed);
+	int autorms = (ch->parms.amplitude == 0.0F);
+	int iq = (ch->parms.iq != 0);
+
+	return Kernels[(iq << 4) | (multipath << 3) | (fading << 2) | (shift << 1) | autorms];
+}
+
+//----------------------------------------------------------------------------
+// RMS window of 32 ms, 256 samples at 8000 sps.
+//----------------------------------------------------------------------------
+static int rms_len(int samplerate)
+{
+	int len = (int)((long)samplerate * 4 / 125);
+
+	return (len < 16) ? 16 : len;
+}
+
+//----------------------------------------------------------------------------
+// Fading gains without fading: (1 + j) / sqrt(2) for the real signal,
+// 1 in IQ mode, where there is no real part taken.
+//----------------------------------------------------------------------------
+static void set_constant_gains(struct channel_s *ch)
+{
+	if (ch->parms.iq) {
+		ch->fade0 = make_float_complex(1.0F, 0.0F);
+		ch->fade1 = make_float_complex(1.0F, 0.0F);
+	} else {
+		ch->fade0 = make_float_complex(1.0F / (float)M_SQRT2, 1.0F / (float)M_SQRT2);
+		ch->fade1 = make_float_complex(1.0F / (float)M_SQRT2, 1.0F / (float)M_SQRT2);
+	}
+}
+
+//----------------------------------------------------------------------------
+// Hilbert transformer of the kind selected, passing 200 Hz ... bw + 200 Hz.
+//----------------------------------------------------------------------------
+static struct filter_s *hilbert(const struct chan_parms_s *p)
+{
+	float f1 = 200.0F / p->samplerate;
+	float f2 = (p->bandwidth + 200.0F) / p->samplerate;
+
+	if (p->hilbert == FILTER_FIR)
+		return init_filter(f1, f2, filter_len(p->samplerate));
+
+	return init_filter_iir(f1, f2, p->hilbert == FILTER_IIR_BAND);
+}
+
+void channel_seed(struct channel_s *ch, unsigned int seed)
+{
+	rng_seed(&ch->rng, seed);
+	rng_seed(&ch->rngq, seed ^ SEED_NOISEQ);
+}
+
+//----------------------------------------------------------------------------
+// Set up all modules of one channel.
+//----------------------------------------------------------------------------
+struct channel_s *init_channel_shared(const struct chan_parms_s *p)
+{
+	struct channel_s *ch;
+	int err = 0;
+
+	if ((ch = calloc(1, sizeof(struct channel_s))) == NULL)
+		return NULL;
+
+	ch->parms = *p;
+
+	// Seed the random number generators
+	channel_seed(ch, p->seed);
+
+	// Initialize HF channel simulation parameters
+	SetParms(ch, p->snr, p->simform);
+
+	// Initialize the noise module. In IQ mode, the noise is complex
+	// with I and Q limited to half the bandwidth.
+	if (p->iq) {
+		err |= !(ch->noise = init_noise(p->noisetype, (float)p->samplerate, p->bandwidth / 2, &ch->rng));
+		err |= !(ch->noiseq = init_noise(p->noisetype, (float)p->samplerate, p->bandwidth / 2, &ch->rngq));
+	} else {
+		err |= !(ch->noise = init_noise(p->noisetype, (float)p->samplerate, p->bandwidth, &ch->rng));
+	}
+
+	// Initialize HF channel Rayleigh fading coefficients
+	if (ch->FrSpread > 0.0F)
+		err |= !(ch->fade = GaussInit(ch->FrSpread, ch->TapUpdRate, &ch->rng));
+
+	// Initialize tapped delay line channel
+	if (ch->DelTime > 0.0F)
+		err |= !(ch->delay = init_delayline(ch->DelTime, p->samplerate));
+
+	// Calculate RMS over 32 ms, update every 8 ms
+	if (p->amplitude == 0.0F)
+		err |= !(ch->rms = init_rms(rms_len(p->samplerate), rms_len(p->samplerate) / 4, p->iq));
+
+	// Initialize the Hilbert transformer (200...3800Hz @ 8000sps),
+	// not needed for complex input
+	if (!p->iq)
+		err |= !(ch->filter = hilbert(p));
+
+	// The shifters are only created when needed
+	if (p->offset != 0.0F || p->drift != 0.0F)
+		err |= !(ch->offset = init_nco(p->offset, p->drift, (float)p->samplerate));
+	if (p->doppler0 != 0.0F)
+		err |= !(ch->direct = init_nco(p->doppler0, 0.0F, (float)p->samplerate));
+	if (p->doppler1 != 0.0F && ch->DelTime > 0.0F)
+		err |= !(ch->delayed = init_nco(p->doppler1, 0.0F, (float)p->samplerate));
+
+	if (err) {
+		clear_channel(ch);
+		return NULL;
+	}
+
+	// constant gains, if there is no fading
+	set_constant_gains(ch);
+	ch->pointsleft = 0;
+	ch->updrem = 0;
+
+	ch->kernel = select_kernel(ch);
+
+	return ch;
+}
+
+struct channel_s *init_channel(const struct chan_parms_s *p)
+{
+	struct channel_s *ch;
+
+	if ((ch = init_channel_shared(p)) == NULL)
+		return NULL;
+
+	if ((ch->work = malloc(sizeof(struct chan_work_s))) == NULL) {
+		clear_channel(ch);
+		return NULL;
+	}
+
+	return ch;
+}
+
+void clear_channel(struct channel_s *ch)
+{
+	if (ch->filter)
+		clear_filter(ch->filter);
+	if (ch->rms)
+		clear_rms(ch->rms);
+	if (ch->noise)
+		clear_noise(ch->noise);
+	if (ch->noiseq)
+		clear_noise(ch->noiseq);
+	if (ch->fade)
+		clear_fade(ch->fade);
+	if (ch->delay)
+		clear_delayline(ch->delay);
+	if (ch->offset)
+		clear_nco(ch->offset);
+	if (ch->direct)
+		clear_nco(ch->direct);
+	if (ch->delayed)
+		clear_nco(ch->delayed);
+	free(ch->work);
+	free(ch);
+}
+
+//----------------------------------------------------------------------------
+// Hand a shifter over: keep the running one with the new frequency (the
+// phase stays continuous), take the new one, or give it away for freeing.
+//----------------------------------------------------------------------------
+static void retune(struct nco_s **n, struct nco_s **fresh, int on, float freq, float drift)
+{
+	if (!on) {
+		*fresh = *n;
+		*n = NULL;
+	} else if (*n) {
+		nco_retune(*n, freq, drift);
+	} else {
+		*n = *fresh;
+		*fresh = NULL;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Change the settings of a running channel, called between two blocks.
+// Only the modules the running ones cannot stand in for are set up, then
+// switched to; a failure leaves the channel as it was.
+//----------------------------------------------------------------------------
+int channel_reconfigure(struct channel_s *ch, const struct chan_parms_s *p, float ramp)
+{
+	const int rate = ch->parms.samplerate;
+	struct channel_s *t;
+	float cutoff = p->iq ? p->bandwidth / 2 : p->bandwidth;
+	int err = 0;
+
+	if (p->samplerate != rate || !p->iq != !ch->parms.iq)
+		return -1;
+
+	if ((t = calloc(1, sizeof(struct channel_s))) == NULL)
+		return -1;
+
+	t->parms = *p;
+	SetParms(t, p->snr, p->simform);
+
+	// New modules, only where the running ones cannot be reused
+	if (!p->iq && (p->bandwidth != ch->parms.bandwidth || p->hilbert != ch->parms.hilbert))
+		err |= !(t->filter = hilbert(p));
+	if (p->noisetype != ch->parms.noisetype || p->bandwidth != ch->parms.bandwidth) {
+		err |= !(t->noise = init_noise(p->noisetype, (float)rate, cutoff, &ch->rng));
+		if (p->iq)
+			err |= !(t->noiseq = init_noise(p->noisetype, (float)rate, cutoff, &ch->rngq));
+	}
+	if (t->FrSpread > 0.0F && !ch->fade)
+		err |= !(t->fade = GaussInit(t->FrSpread, t->TapUpdRate, &ch->rng));
+	if (t->DelTime > 0.0F && (!ch->delay || delay_taps(t->DelTime, rate) > ch->delay->maxtaps))
+		err |= !(t->delay = init_delayline(t->DelTime, rate));
+	if (p->amplitude == 0.0F && !ch->rms)
+		err |= !(t->rms = init_rms(rms_len(rate), rms_len(rate) / 4, p->iq));
+	if ((p->offset != 0.0F || p->drift != 0.0F) && !ch->offset)
+		err |= !(t->offset = init_nco(p->offset, p->drift, (float)rate));
+	if (p->doppler0 != 0.0F && !ch->direct)
+		err |= !(t->direct = init_nco(p->doppler0, 0.0F, (float)rate));
+	if (p->doppler1 != 0.0F && t->DelTime > 0.0F && !ch->delayed)
+		err |= !(t->delayed = init_nco(p->doppler1, 0.0F, (float)rate));
+
+	if (!err)
+		err = channel_switch(ch, t, ramp) < 0;
+
+	clear_channel(t);
+
+	return err ? -1 : 0;
+}
+
+//----------------------------------------------------------------------------
+// Switch a running channel to the settings of 't', taking over modules of
+// 't' where needed. Nothing is allocated or designed here. The modules
+// replaced are collected in 't' and freed with it.
+//----------------------------------------------------------------------------
+int channel_switch(struct channel_s *ch, struct channel_s *t, float ramp)
+{
+	const struct chan_parms_s *p = &t->parms;
+	const int rate = ch->parms.samplerate;
+	const unsigned int seed = ch->parms.seed;
+	struct filter_s *oldfilter;
+	struct noise_s *oldnoise;
+	struct fade_s *oldfade;
+	struct delay_s *olddelay;
+	float ratio;
+	int nramp;
+
+	if (p->samplerate != rate || !p->iq != !ch->parms.iq)
+		return -1;
+
+	// Hilbert transformer: new coefficients, same input history
+	// (a new kind of filter starts empty)
+	if (t->filter) {
+		oldfilter = ch->filter;
+		filter_copy(t->filter, oldfilter);
+		ch->filter = t->filter;
+		t->filter = oldfilter;
+	}
+
+	// Noise: new shaping filter and type, same filter state
+	if (t->noise) {
+		oldnoise = ch->noise;
+		memcpy(t->noise->xv, oldnoise->xv, sizeof(oldnoise->xv));
+		memcpy(t->noise->yv, oldnoise->yv, sizeof(oldnoise->yv));
+		ch->noise = t->noise;
+		ch->noise->rng = &ch->rng;
+		t->noise = oldnoise;
+	}
+	if (t->noiseq) {
+		oldnoise = ch->noiseq;
+		memcpy(t->noiseq->xv, oldnoise->xv, sizeof(oldnoise->xv));
+		memcpy(t->noiseq->yv, oldnoise->yv, sizeof(oldnoise->yv));
+		ch->noiseq = t->noiseq;
+		ch->noiseq->rng = &ch->rngq;
+		t->noiseq = oldnoise;
+	}
+
+	// Fading: a running generator keeps its state with new coefficients
+	if (t->FrSpread > 0.0F) {
+		if (!ch->fade) {
+			ch->fade = t->fade;
+			ch->fade->rng = &ch->rng;
+			t->fade = NULL;
+			ch->pointsleft = 0;
+		} else if (t->fade) {
+			oldfade = ch->fade;
+			memcpy(t->fade->IFade0, oldfade->IFade0, sizeof(oldfade->IFade0));
+			memcpy(t->fade->QFade0, oldfade->QFade0, sizeof(oldfade->QFade0));
+			memcpy(t->fade->IFade1, oldfade->IFade1, sizeof(oldfade->IFade1));
+			memcpy(t->fade->QFade1, oldfade->QFade1, sizeof(oldfade->QFade1));
+			ch->fade = t->fade;
+			ch->fade->rng = &ch->rng;
+			t->fade = oldfade;
+		} else {
+			GaussSetSpread(ch->fade, t->FrSpread, t->TapUpdRate);
+		}
+		if (ch->pointsleft > rate / t->TapUpdRate)
+			ch->pointsleft = rate / t->TapUpdRate;
+		if (t->TapUpdRate != ch->TapUpdRate)
+			ch->updrem = 0;
+	} else if (ch->fade) {
+		t->fade = ch->fade;
+		ch->fade = NULL;
+		set_constant_gains(ch);
+	}
+
+	// Delayed path: the delay line keeps its samples, a longer line
+	// takes them over
+	if (t->DelTime > 0.0F) {
+		if (ch->delay && set_delayline(ch->delay, t->DelTime, rate) == 0) {
+			// the running line is long enough
+		} else {
+			olddelay = ch->delay;
+			if (olddelay)
+				ring_copy(t->delay->line, olddelay->line);
+			ch->delay = t->delay;
+			t->delay = olddelay;
+		}
+	} else if (ch->delay) {
+		t->delay = ch->delay;
+		ch->delay = NULL;
+	}
+
+	if (p->amplitude == 0.0F) {
+		if (!ch->rms) {
+			ch->rms = t->rms;
+			t->rms = NULL;
+		}
+	} else if (ch->rms) {
+		t->rms = ch->rms;
+		ch->rms = NULL;
+	}
+
+	retune(&ch->offset, &t->offset, p->offset != 0.0F || p->drift != 0.0F, p->offset, p->drift);
+	retune(&ch->direct, &t->direct, p->doppler0 != 0.0F, p->doppler0, 0.0F);
+	retune(&ch->delayed, &t->delayed, p->doppler1 != 0.0F && t->DelTime > 0.0F, p->doppler1, 0.0F);
+
+	// SNR: step, or ramp in dB from the current level
+	nramp = (int)(ramp * rate + 0.5F);
+	ratio = ch->SigLvl / t->SigLvl;
+	ch->SigTarget = t->SigLvl;
+	if (nramp > 0 && ratio != 1.0F && isnormal(ratio)) {
+		ch->SigStep = powf(ratio, 1.0F / ((nramp + RAMP_STEP - 1) / RAMP_STEP));
+		ch->rampleft = nramp;
+	} else {
+		ch->SigLvl = t->SigLvl;
+		ch->rampleft = 0;
+	}
+
+	ch->DelTime = t->DelTime;
+	ch->FrSpread = t->FrSpread;
+	ch->TapUpdRate = t->TapUpdRate;
+
+	ch->parms = *p;
+	ch->parms.seed = seed;
+
+	ch->kernel = select_kernel(ch);
+
+	return 0;
+}
+
+void channel_set_probe(struct channel_s *ch, chan_probe_t probe, void *arg)
+{
+	ch->probe = probe;
+	ch->probe_arg = arg;
+}
+
+void channel_set_source(struct channel_s *ch, const struct chan_source_s *source)
+{
+	ch->source = source;
+}
+
+void channel_set_qrm(struct channel_s *ch, struct qrm_s *qrm)
+{
+	ch->qrm = qrm;
+}
+
+void channel_process_work(struct channel_s *ch, struct chan_work_s *w,
+			  const float *in, float *out, int len)
+{
+	fpmode_t mode = denormals_off();
+	int n;
+
+	while (len > 0) {
+		n = (len < CHAN_BLOCK) ? len : CHAN_BLOCK;
+		ch->kernel(ch, w, in, out, n);
+		in += n;
+		out += n;
+		len -= n;
+	}
+
+	denormals_restore(mode);
+}
+
+void channel_process(struct channel_s *ch, const float *in, float *out, int len)
+{
+	channel_process_work(ch, ch->work, in, out, len);
+}
+
+//----------------------------------------------------------------------------
+// With an infinite signal level the kernel leaves the noise out and
+// writes the faded signal. The noise of each SNR is added like in the
+// kernel, from the unit noise and the RMS values still in the scratch
+// buffers.
+//----------------------------------------------------------------------------
+void channel_process_snrs(struct channel_s *ch, const float *in, float *const *out,
+			  const float *snr, int k, int len)
+{
+	struct chan_work_s *w = ch->work;
+	const int iq = (ch->parms.iq != 0);
+	const int autorms = (ch->parms.amplitude == 0.0F);
+	fpmode_t mode = denormals_off();
+	float siglvl = ch->SigTarget;
+	float lvl, ampl, *y;
+	int done, i, j, n;
+
+	ch->rampleft = 0;
+
+	for (done = 0; done < len; done += n) {
+		n = (len - done < CHAN_BLOCK) ? len - done : CHAN_BLOCK;
+		y = out[0] + (iq ? 2 : 1) * done;
+
+		ch->SigLvl = HUGE_VALF;
+		ch->kernel(ch, w, in + (iq ? 2 : 1) * done, y, n);
+
+		// out[0] last, it holds the faded signal
+		for (j = k - 1; j >= 0; j--) {
+			float *o = out[j] + (iq ? 2 : 1) * done;
+
+			// convert from dB to voltage ratio, as in SetParms()
+			lvl = powf(10.0F, snr[j] / 20.0F);
+			for (i = 0; i < n; i++) {
+				ampl = (autorms ? w->rmsval[i] : ch->parms.amplitude) / lvl;
+				if (iq) {
+					ampl *= (float)M_SQRT1_2;
+					o[2 * i] = y[2 * i] + w->nbuf[i] * ampl;
+					o[2 * i + 1] = y[2 * i + 1] + w->nbufq[i] * ampl;
+				} else {
+					o[i] = y[i] + w->nbuf[i] * ampl;
+				}
+			}
+		}
+	}
+
+	ch->SigLvl = siglvl;
+	denormals_restore(mode);
+}
+
+void channel_analytic(struct channel_s *src, const float *in,
+		      struct chan_analytic_s *a, int len)
+{
+	fpmode_t mode = denormals_off();
+
+	// zeros keep a settled filter settled, as filter_zero() in the kernel
+	a->settle = filter_settle(src->filter);
+	filter_block(src->filter, in, a->sig, len, 1.0F / (float)M_SQRT2);
+
+	denormals_restore(mode);
+}
+
+void channel_process_analytic(struct channel_s *ch, struct chan_work_s *w,
+			      const struct chan_analytic_s *a, const float *in,
+			      float *out, int len)
+{
+	fpmode_t mode = denormals_off();
+
+	ch->analytic = a;
+	ch->kernel(ch, w, in, out, len);
+	ch->analytic = NULL;
+
+	denormals_restore(mode);
+}
+
+void channel_process_iq_work(struct channel_s *ch, struct chan_work_s *w,
+			     const float_complex *in, float_complex *out, int len)
+{
+	fpmode_t mode = denormals_off();
+	int n;
+
+	while (len > 0) {
+		n = (len < CHAN_BLOCK) ? len : CHAN_BLOCK;
+		ch->kernel(ch, w, (const float *)in, (float *)out, n);
+		in += n;
+		out += n;
+		len -= n;
+	}
+
+	denormals_restore(mode);
+}
+
+void channel_process_iq(struct channel_s *ch, const float_complex *in, float_complex *out, int len)
+{
+	channel_process_iq_work(ch, ch->work, in, out, len);
+}
@@ -0,0 +1,222 @@
+#ifndef _CHANNEL_H
+#define _CHANNEL_H
+
+#include "chansim.h"
+#include "cplx.h"
+
+#define CHAN_BLOCK	512	/* samples per kernel call */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * User settings of one simulated HF channel.
+ */
+struct chan_parms_s {
+	float snr;		/* signal to noise ratio in dB */
+	int simform;		/* HF channel type 0..7 */
+	int noisetype;		/* 0 Gaussian, 1 LaPlacian, 2 impulse */
+	int samplerate;		/* samples per second */
+	float bandwidth;	/* noise bandwidth in Hz */
+	float amplitude;	/* input RMS amplitude, 0 = measure at runtime */
+	float offset;		/* frequency offset in Hz */
+	float drift;		/* linear drift of the offset in Hz/s */
+	float doppler0;		/* Doppler shift of the direct path in Hz */
+	float doppler1;		/* Doppler shift of the delayed path in Hz */
+	unsigned int seed;	/* seed of the random number generator */
+	int iq;			/* complex baseband input and output */
+	int hilbert;		/* FILTER_FIR, FILTER_IIR or FILTER_IIR_BAND */
+};
+
+/*
+ * Scratch buffers of the kernels. Their content does not survive a
+ * kernel call, so channels processed by the same thread may share one.
+ */
+struct chan_work_s {
+	float_complex sig[CHAN_BLOCK];
+	float_complex dsig[CHAN_BLOCK];
+	float rmsval[CHAN_BLOCK];
+	float nbuf[CHAN_BLOCK];
+	float nbufq[CHAN_BLOCK];	/* quadrature noise in IQ mode */
+	float_complex qrm[CHAN_BLOCK];	/* interference, see channel_set_qrm() */
+};
+
+struct channel_s;
+struct qrm_s;
+
+/*
+ * Channel state over a segment of samples with constant fading gains,
+ * passed to a probe, see channel_set_probe().
+ */
+struct chan_state_s {
+	long long sample;		/* first sample, counted from 0 */
+	int n;				/* number of samples */
+	int iq;
+	float_complex fade0, fade1;	/* gains of the direct and delayed path */
+	int delay;			/* delayed path in samples, 0 = none */
+	const float *noise;		/* noise and interference added, I/Q pairs if iq */
+};
+
+typedef void (*chan_probe_t)(void *arg, const struct chan_state_s *);
+
+/*
+ * A block of real input turned into the analytic signal once, for
+ * several channels fed with the same input, see channel_analytic().
+ */
+struct chan_analytic_s {
+	float_complex sig[CHAN_BLOCK];
+	int settle;			/* filter_settle() before the block */
+};
+
+/*
+ * Noise and fading made elsewhere instead of in the kernel, e.g. ahead
+ * of time on other threads, see channel_set_source(). Called in the
+ * kernel's order: the fading gains at each update, then the unit noise
+ * of the samples up to the next update or the block end.
+ */
+struct chan_source_s {
+	void (*fade)(void *arg, float_complex *fade0, float_complex *fade1);
+	void (*noise)(void *arg, float *n, float *nq, int len);	/* nq NULL unless IQ */
+	void *arg;
+};
+
+/*
+ * Processing kernel, specialized for one channel configuration.
+ * Processes up to CHAN_BLOCK samples; 'out' may be the same as 'in'.
+ * In IQ mode 'in' and 'out' hold interleaved I/Q pairs.
+ */
+typedef void (*chan_kernel_t)(struct channel_s *ch, struct chan_work_s *w,
+			      const float *in, float *out, int size);
+
+struct channel_s {
+	struct chan_parms_s parms;
+
+	/* derived from channel type and SNR */
+	float SigLvl;			/* Signal level for given SNR */
+	float SigStep;			/* SigLvl factor per RAMP_STEP while ramping */
+	float SigTarget;		/* SigLvl at the end of the ramp */
+	int rampleft;			/* samples until the end of the ramp */
+	float DelTime;			/* Time difference between two paths */
+	float FrSpread;			/* Frequency (doppler) spread */
+	int TapUpdRate;			/* Update rate for the fading gain params */
+	int updrem;			/* samplerate / TapUpdRate remainder carried */
+
+	struct filter_s *filter;	/* Hilbert transformer, NULL in IQ mode */
+	struct rms_s *rms;		/* RMS calculations, NULL if amplitude is given */
+	struct noise_s *noise;		/* Noise generation */
+	struct noise_s *noiseq;		/* quadrature noise, IQ mode only */
+	struct fade_s *fade;		/* Fading generator, NULL without spread */
+	struct delay_s *delay;		/* Delayed path, NULL for flat channels */
+	struct nco_s *offset;		/* Frequency offset (and drift) shifter */
+	struct nco_s *direct;		/* Doppler shifter of the direct path */
+	struct nco_s *delayed;		/* Doppler shifter of the delayed path */
+
+	float_complex fade0, fade1;	/* current fading gains */
+	int pointsleft;			/* samples until next fading gain update */
+	int silent;			/* zero input samples in a row */
+	long long samples;		/* processed so far */
+
+	chan_probe_t probe;		/* state export, NULL if off */
+	void *probe_arg;
+	const struct chan_source_s *source;	/* noise and fading, NULL = own */
+	const struct chan_analytic_s *analytic;	/* input made elsewhere, NULL = own */
+	struct qrm_s *qrm;		/* interference, NULL if none (not owned) */
+
+	struct rng_s rng;		/* used by fading and noise generators */
+	struct rng_s rngq;		/* quadrature noise, IQ mode only */
+
+	chan_kernel_t kernel;		/* selected once in init_channel() */
+	struct chan_work_s *work;	/* own scratch buffers, NULL if shared */
+};
+
+/* ---------------------------------------------------------------------- */
+
+extern struct channel_s *init_channel(const struct chan_parms_s *);
+extern void clear_channel(struct channel_s *);
+
+/* without own scratch buffers, process with channel_process_work() */
+extern struct channel_s *init_channel_shared(const struct chan_parms_s *);
+
+/*
+ * Restart the random number generators with 'seed'. The quadrature
+ * noise of IQ mode has a generator of its own, so which random number
+ * goes to which sample does not depend on how the blocks are cut.
+ */
+extern void channel_seed(struct channel_s *, unsigned int seed);
+
+/*
+ * Apply new settings to a running channel at the next block boundary.
+ * Filter, delay line and fading states are kept. An SNR change is
+ * ramped over 'ramp' seconds in equal dB steps (0 = step). The sample
+ * rate, the seed and IQ mode cannot be changed. Returns 0, or -1 leaving
+ * the channel unchanged.
+ */
+extern int channel_reconfigure(struct channel_s *, const struct chan_parms_s *, float ramp);
+
+/*
+ * channel_reconfigure() to settings known in advance: 't' is set up
+ * beforehand with init_channel_shared(), so the switch itself allocates
+ * nothing. The modules of the channel that are replaced go to 't', to be
+ * freed with clear_channel(); 't' is used up. Returns 0, or -1 if the
+ * sample rate or IQ mode differ.
+ */
+extern int channel_switch(struct channel_s *, struct channel_s *t, float ramp);
+
+/*
+ * Have 'probe' called with the channel state of every segment processed,
+ * from the processing thread. NULL turns it off.
+ */
+extern void channel_set_probe(struct channel_s *, chan_probe_t probe, void *arg);
+
+/*
+ * Take the noise and fading gains from 'source' (NULL = generate them).
+ * The channel's fading and noise generators and its random numbers are
+ * then the source's to use.
+ */
+extern void channel_set_source(struct channel_s *, const struct chan_source_s *source);
+
+/*
+ * Add the interference of 'qrm' (qrm.h, NULL = none) to the output, at
+ * its levels relative to the input signal. Like the noise, it follows
+ * the measured input RMS if the amplitude is not given.
+ */
+extern void channel_set_qrm(struct channel_s *, struct qrm_s *qrm);
+
+/* process any number of samples, 'out' may be the same as 'in' */
+extern void channel_process(struct channel_s *, const float *in, float *out, int len);
+extern void channel_process_work(struct channel_s *, struct chan_work_s *,
+				 const float *in, float *out, int len);
+
+/*
+ * Process once for 'k' outputs at the SNRs snr[0..k-1] in dB, instead of
+ * the channel's own SNR. Filter, fading, delay and noise are computed
+ * once, so the outputs share one channel realization; each is the same
+ * as processing at its SNR alone with the same seed. Needs the channel's
+ * own scratch buffers (init_channel()). In IQ mode 'in' and 'out[]' hold
+ * I/Q pairs, 'len' counts pairs. out[0] may be the same as 'in'.
+ */
+extern void channel_process_snrs(struct channel_s *, const float *in, float *const *out,
+				 const float *snr, int k, int len);
+
+/*
+ * One Hilbert transformer for several channels with the same real input:
+ * channel_analytic() runs the one of 'src' (not processed otherwise) on
+ * up to CHAN_BLOCK samples, then channel_process_analytic() of each
+ * channel takes the result instead of running its own. The output is
+ * the same as from channel_process(), if the channel's bandwidth and
+ * Hilbert transformer are those of 'src'.
+ */
+extern void channel_analytic(struct channel_s *src, const float *in,
+			     struct chan_analytic_s *a, int len);
+extern void channel_process_analytic(struct channel_s *, struct chan_work_s *,
+				     const struct chan_analytic_s *a, const float *in,
+				     float *out, int len);
+
+/* same for channels in IQ mode */
+extern void channel_process_iq(struct channel_s *, const float_complex *in,
+			       float_complex *out, int len);
+extern void channel_process_iq_work(struct channel_s *, struct chan_work_s *,
+				    const float_complex *in, float_complex *out, int len);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _CHANNEL_H */
@@ -0,0 +1,517 @@
+
+#define _USE_MATH_DEFINES
+
+#include "channel_fx.h"
+#include "filter.h"
+#include "noise.h"
+#include "fade.h"
+#include "delay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FX_CLIP		32735	/* 0.999 in Q15 */
+
+/*
+ * Noise source tables, filled once from the inverse distribution
+ * functions. A random index picks one entry.
+ */
+static int16_t GaussTab[1 << FX_GAUSS_BITS];	/* Q12, unit variance */
+static int16_t LaplaceTab[1 << FX_GAUSS_BITS];	/* Q12, unit variance */
+static int16_t ImpulseTab[1 << FX_GAUSS_BITS];	/* Q10, impulse heights */
+static uint32_t ImpulseProb;			/* probability of an impulse, Q32 */
+static int16_t SineTab[(1 << FX_SINE_BITS) + 1];	/* Q15 */
+static int TablesReady = 0;
+
+/* inverse of the standard normal distribution function */
+static double inv_normal(double p)
+{
+	double lo = -10.0, hi = 10.0, x = 0.0;
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		x = 0.5 * (lo + hi);
+		if (0.5 * erfc(-x / M_SQRT2) < p)
+			lo = x;
+		else
+			hi = x;
+	}
+	return x;
+}
+
+static void normalize_table(int16_t *tab, const double *v, int len, double scale)
+{
+	double pwr = 0.0;
+	int i;
+
+	for (i = 0; i < len; i++)
+		pwr += v[i] * v[i];
+	pwr = sqrt(pwr / len);
+
+	for (i = 0; i < len; i++)
+		tab[i] = (int16_t)floor(v[i] / pwr * scale + 0.5);
+}
+
+static int init_tables(void)
+{
+	const int len = 1 << FX_GAUSS_BITS;
+	double *v, p;
+	int i;
+
+	if (TablesReady)
+		return 0;
+
+	if ((v = malloc(len * sizeof(double))) == NULL)
+		return -1;
+
+	// Gaussian: variance normalized, the tails are cut at 3.7 sigma
+	for (i = 0; i < len; i++)
+		v[i] = inv_normal((i + 0.5) / len);
+	normalize_table(GaussTab, v, len, 4096.0);
+
+	// La Placian, same distribution as in BandLtdNoise()
+	for (i = 0; i < len; i++) {
+		p = (i + 0.5) / len;
+		if (p < 0.5)
+			v[i] = log(2.0 * p) / M_SQRT2;
+		else
+			v[i] = -log(2.0 * (1.0 - p)) / M_SQRT2;
+	}
+	normalize_table(LaplaceTab, v, len, 4096.0);
+
+	// Impulsive: z = -sqrt(2) * log(u) is kept only above 8. Above that
+	// threshold, z - 8 is exponentially distributed again.
+	ImpulseProb = (uint32_t)(exp(-8.0 / M_SQRT2) * 4294967296.0);
+	for (i = 0; i < len; i++) {
+		p = (i + 0.5) / len;
+		ImpulseTab[i] = (int16_t)floor((8.0 - M_SQRT2 * log(1.0 - p)) * 1024.0 + 0.5);
+	}
+
+	for (i = 0; i <= (1 << FX_SINE_BITS); i++)
+		SineTab[i] = (int16_t)floor(32767.0 * sin(2.0 * M_PI * i / (1 << FX_SINE_BITS)) + 0.5);
+
+	free(v);
+	TablesReady = 1;
+	return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static inline int16_t sat16(int32_t x)
+{
+	if (x > 32767)
+		return 32767;
+	if (x < -32768)
+		return -32768;
+	return (int16_t)x;
+}
+
+static inline uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static inline int32_t q28(double x)
+{
+	return (int32_t)floor(x * (1 << 28) + 0.5);
+}
+
+/* Direct form I biquad, 64 bit products */
+static inline int32_t biquad_fx(struct biquad_fx_s *q, int32_t x)
+{
+	int64_t acc;
+	int32_t y;
+
+	acc = (int64_t)q->b0 * x + (int64_t)q->b1 * q->x1 + (int64_t)q->b2 * q->x2
+	    - (int64_t)q->a1 * q->y1 - (int64_t)q->a2 * q->y2;
+	y = (int32_t)((acc + (1 << 27)) >> 28);
+
+	q->x2 = q->x1;
+	q->x1 = x;
+	q->y2 = q->y1;
+	q->y1 = y;
+
+	return y;
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+	uint64_t r = 0, b = (uint64_t)1 << 62;
+
+	while (b > x)
+		b >>= 2;
+	while (b) {
+		if (x >= r + b) {
+			x -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+	return (uint32_t)r;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static inline int16_t sine_fx(uint32_t phase)
+{
+	uint32_t i = phase >> (32 - FX_SINE_BITS);
+	int32_t frac = (int32_t)((phase >> (32 - FX_SINE_BITS - 15)) & 0x7fff);
+	int32_t a = SineTab[i];
+	int32_t b = SineTab[i + 1];
+
+	return (int16_t)(a + (((b - a) * frac) >> 15));
+}
+
+/*
+ * freq is the phase increment per sample in units of 2^-48 cycles,
+ * which keeps slow drifts representable.
+ */
+void init_nco_fx(struct nco_fx_s *n, float freq, float drift, float samplerate)
+{
+	init_tables();
+
+	n->phase = 0;
+	n->freq = (int64_t)floor((double)freq / samplerate * 281474976710656.0 + 0.5);
+	n->drift = (int64_t)floor((double)drift / samplerate / samplerate * 281474976710656.0 + 0.5);
+}
+
+/* phase increment for the next 'len' samples, mean over the block */
+static inline uint32_t nco_fx_step(struct nco_fx_s *n, int len)
+{
+	uint32_t inc = (uint32_t)((uint64_t)(n->freq + n->drift * len / 2) >> 16);
+
+	n->freq += n->drift * len;
+	return inc;
+}
+
+void nco_fx_real(struct nco_fx_s *n, int16_t *out, int len)
+{
+	uint32_t inc = nco_fx_step(n, len);
+	int i;
+
+	for (i = 0; i < len; i++) {
+		out[i] = sine_fx(n->phase + 0x40000000U);
+		n->phase += inc;
+	}
+}
+
+static void nco_fx_mix(struct nco_fx_s *n, int16_t *re, int16_t *im, int len)
+{
+	uint32_t inc = nco_fx_step(n, len);
+	int32_t c, s, x, y;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		c = sine_fx(n->phase + 0x40000000U);
+		s = sine_fx(n->phase);
+		x = re[i];
+		y = im[i];
+		re[i] = sat16((x * c - y * s + (1 << 14)) >> 15);
+		im[i] = sat16((x * s + y * c + (1 << 14)) >> 15);
+		n->phase += inc;
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+
+static inline int32_t noise_fx(struct channel_fx_s *ch)
+{
+	uint32_t r = xorshift32(&ch->rng);
+
+	switch (ch->parms.noisetype) {
+	default:
+	case 0:					// Gaussian
+		return (int32_t)GaussTab[r >> (32 - FX_GAUSS_BITS)] << 4;
+	case 1:					// La Placian
+		return (int32_t)LaplaceTab[r >> (32 - FX_GAUSS_BITS)] << 4;
+	case 2:					// Impulsive
+		if (r >= ImpulseProb)
+			return 0;
+		r = xorshift32(&ch->rng);
+		return (int32_t)ImpulseTab[r >> (32 - FX_GAUSS_BITS)] << 6;
+	}
+}
+
+static void fade_gains_fx(struct channel_fx_s *ch)
+{
+	int32_t g[4];
+	int i;
+
+	// Rayleigh: complex Gaussian input, each component of unit variance
+	for (i = 0; i < 4; i++) {
+		int32_t x = (int32_t)GaussTab[xorshift32(&ch->rng) >> (32 - FX_GAUSS_BITS)] << 4;
+		g[i] = biquad_fx(&ch->fade[i], x) >> 4;
+	}
+
+	if (ch->multipath) {
+		ch->fade0[0] = g[0];
+		ch->fade0[1] = g[1];
+	} else {
+		// flat fading: scale the single path by sqrt(2)
+		ch->fade0[0] = (int32_t)(((int64_t)g[0] * 46341) >> 15);
+		ch->fade0[1] = (int32_t)(((int64_t)g[1] * 46341) >> 15);
+	}
+	ch->fade1[0] = g[2];
+	ch->fade1[1] = g[3];
+}
+
+static inline int32_t rms_fx(struct channel_fx_s *ch, int16_t input)
+{
+	int64_t sum, pwr, var;
+	int i;
+
+	ch->rmsbuf[ch->rmsptr] = input;
+	ch->rmsptr = (ch->rmsptr + 1) & 255;
+
+	if (ch->rmscounter++ == 64) {
+		sum = 0;
+		pwr = 0;
+		for (i = 0; i < 256; i++) {
+			sum += ch->rmsbuf[i];
+			pwr += (int32_t)ch->rmsbuf[i] * ch->rmsbuf[i];
+		}
+		var = pwr / 256 - (sum / 256) * (sum / 256);
+		ch->rmsval = (int32_t)isqrt64(var > 0 ? (uint64_t)var : 0);
+		ch->rmscounter = 0;
+	}
+
+	return ch->rmsval;
+}
+
+/* ---------------------------------------------------------------------- */
+
+struct channel_fx_s *init_channel_fx(const struct chan_parms_s *p)
+{
+	struct channel_fx_s *ch;
+	struct filter_s *f;
+	struct noise_s *n;
+	struct fade_s *fd;
+	struct channel_s *c;
+	double l1i, l1q, gain;
+	int i, dllen;
+
+	if (p->iq || init_tables())
+		return NULL;
+
+	if ((ch = calloc(1, sizeof(struct channel_fx_s))) == NULL)
+		return NULL;
+
+	ch->parms = *p;
+	ch->rng = p->seed ? p->seed : 2463534242U;
+
+	// Derived parameters and float coefficients come from the float
+	// channel, they are converted below.
+	c = init_channel_shared(p);
+	if (!c) {
+		free(ch);
+		return NULL;
+	}
+
+	ch->invsiglvl = (int32_t)floor((1 << 24) / c->SigLvl + 0.5);
+	ch->multipath = (c->DelTime > 0.0F);
+	ch->fading = (c->FrSpread > 0.0F);
+
+	// Hilbert transformer: Q15 coefficients, unless the 32 bit
+	// accumulator could overflow for a full scale input.
+	f = init_filter(200.0F / p->samplerate, (p->bandwidth + 200.0F) / p->samplerate, FX_FILTERLEN);
+	if (!f) {
+		clear_channel(c);
+		free(ch);
+		return NULL;
+	}
+	ch->hshift = 15;
+	l1i = 0.0;
+	l1q = 0.0;
+	for (i = 0; i < FX_FILTERLEN; i++) {
+		l1i += fabs(f->ifilter[i]);
+		l1q += fabs(f->qfilter[i]);
+	}
+	if (l1q > l1i)
+		l1i = l1q;
+	while (ch->hshift > 8 && l1i * 23170.0 * (1 << ch->hshift) >= 2147483647.0)
+		ch->hshift--;
+	for (i = 0; i < FX_FILTERLEN; i++) {
+		ch->hfilter[0][i] = (int16_t)floor(f->ifilter[i] * (1 << ch->hshift) + 0.5);
+		ch->hfilter[1][i] = (int16_t)floor(f->qfilter[i] * (1 << ch->hshift) + 0.5);
+	}
+	ch->hptr = FX_FILTERLEN;
+	clear_filter(f);
+
+	// Delay line
+	dllen = delay_taps(c->DelTime, p->samplerate);
+	if (dllen > FX_DELAYTAPS - 1) {
+		dllen = FX_DELAYTAPS - 1;
+		fprintf(stderr,
+			"Warning: path delay too long, limiting to %.1f ms\n",
+			(float) dllen / p->samplerate * 1000.0);
+	}
+	ch->dptr = 0;
+	ch->ddelay = FX_DELAYTAPS - dllen;
+
+	// Noise shaping biquad, BGG and 1/bn0 folded into the numerator
+	n = c->noise;
+	gain = n->BGG / n->bn0;
+	ch->noise.b0 = q28(n->an0 * gain);
+	ch->noise.b1 = q28(n->an1 * gain);
+	ch->noise.b2 = q28(n->an2 * gain);
+	ch->noise.a1 = q28(n->bn1);
+	ch->noise.a2 = q28(n->bn2);
+
+	// Gaussian fading filters, primed as in GaussInit()
+	fd = c->fade;
+	if (fd) {
+		for (i = 0; i < 4; i++) {
+			ch->fade[i].b0 = q28(fd->g / fd->a0);
+			ch->fade[i].b1 = q28(2.0 * fd->g / fd->a0);
+			ch->fade[i].b2 = q28(fd->g / fd->a0);
+			ch->fade[i].a1 = q28(fd->a1 / fd->a0);
+			ch->fade[i].a2 = q28(fd->a2 / fd->a0);
+		}
+		ch->updrate = c->TapUpdRate;
+		gain = 2.0 * M_PI * c->FrSpread / c->TapUpdRate / M_SQRT2;
+		for (i = 0; i < 1.0 / gain; i++)
+			fade_gains_fx(ch);
+	} else {
+		// constant gains (1 + j) / sqrt(2), flat: times sqrt(2)
+		ch->fade0[0] = ch->fade0[1] = ch->multipath ? 2896 : 4096;
+		ch->fade1[0] = ch->fade1[1] = 2896;
+	}
+
+	// Oscillators
+	ch->shift = (p->offset != 0.0F || p->drift != 0.0F || p->doppler0 != 0.0F ||
+		     (p->doppler1 != 0.0F && ch->multipath));
+	init_nco_fx(&ch->offset, p->offset, p->drift, (float)p->samplerate);
+	init_nco_fx(&ch->direct, p->doppler0, 0.0F, (float)p->samplerate);
+	init_nco_fx(&ch->delayed, p->doppler1, 0.0F, (float)p->samplerate);
+
+	clear_channel(c);
+
+	return ch;
+}
+
+void clear_channel_fx(struct channel_fx_s *ch)
+{
+	free(ch);
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void simprocess_fx(struct channel_fx_s *ch, const int16_t *in, int16_t *out, int size)
+{
+	int16_t sr[CHAN_BLOCK], si[CHAN_BLOCK];
+	int16_t dr[CHAN_BLOCK], di[CHAN_BLOCK];
+	int32_t ampl[CHAN_BLOCK];
+	int32_t accr, acci, amp, inoise;
+	int64_t acc;
+	int16_t *hp;
+	int i, k, n;
+
+	// Analytic signal: x / sqrt(2) into both branches of the Hilbert pair
+	for (i = 0; i < size; i++) {
+		hp = ch->hbuffer + ch->hptr;
+		*hp = (int16_t)(((int32_t)in[i] * 23170 + (1 << 14)) >> 15);
+
+		accr = 0;
+		acci = 0;
+		hp -= FX_FILTERLEN;
+		for (k = 0; k < FX_FILTERLEN; k++) {
+			accr += (int32_t)hp[k] * ch->hfilter[0][k];
+			acci += (int32_t)hp[k] * ch->hfilter[1][k];
+		}
+		sr[i] = sat16((accr + (1 << (ch->hshift - 1))) >> ch->hshift);
+		si[i] = sat16((acci + (1 << (ch->hshift - 1))) >> ch->hshift);
+
+		if (++ch->hptr == FX_BUFFERLEN) {
+			memcpy(ch->hbuffer, ch->hbuffer + FX_BUFFERLEN - FX_FILTERLEN, FX_FILTERLEN * sizeof(int16_t));
+			ch->hptr = FX_FILTERLEN;
+		}
+	}
+
+	if (ch->shift)
+		nco_fx_mix(&ch->offset, sr, si, size);
+
+	if (ch->multipath) {
+		for (i = 0; i < size; i++) {
+			ch->dline[0][ch->dptr] = sr[i];
+			ch->dline[1][ch->dptr] = si[i];
+			dr[i] = ch->dline[0][ch->ddelay];
+			di[i] = ch->dline[1][ch->ddelay];
+			ch->dptr = (ch->dptr + 1) % FX_DELAYTAPS;
+			ch->ddelay = (ch->ddelay + 1) % FX_DELAYTAPS;
+		}
+		if (ch->shift)
+			nco_fx_mix(&ch->delayed, dr, di, size);
+	}
+
+	if (ch->shift)
+		nco_fx_mix(&ch->direct, sr, si, size);
+
+	// Noise amplitude: input RMS / SigLvl, Q15
+	if (ch->parms.amplitude == 0.0F) {
+		for (i = 0; i < size; i++)
+			ampl[i] = (int32_t)(((int64_t)rms_fx(ch, in[i]) * ch->invsiglvl) >> 24);
+	} else {
+		amp = (int32_t)(((int64_t)floor(ch->parms.amplitude * 32768.0F + 0.5F) * ch->invsiglvl) >> 24);
+		for (i = 0; i < size; i++)
+			ampl[i] = amp;
+	}
+
+	ch->clipped = 0;
+	for (i = 0; i < size; i += n) {
+		n = size - i;
+		if (ch->fading) {
+			if (ch->pointsleft <= 0) {
+				fade_gains_fx(ch);
+				ch->pointsleft = (ch->parms.samplerate + ch->updrem) / ch->updrate;
+				ch->updrem = (ch->parms.samplerate + ch->updrem) % ch->updrate;
+			}
+			if (n > ch->pointsleft)
+				n = ch->pointsleft;
+			ch->pointsleft -= n;
+		}
+
+		for (k = i; k < i + n; k++) {
+			acc = (int64_t)sr[k] * ch->fade0[0] - (int64_t)si[k] * ch->fade0[1];
+			if (ch->multipath)
+				acc += (int64_t)dr[k] * ch->fade1[0] - (int64_t)di[k] * ch->fade1[1];
+
+			inoise = (int32_t)(((int64_t)biquad_fx(&ch->noise, noise_fx(ch)) * ampl[k]) >> 16);
+			acc = ((acc + (1 << 11)) >> 12) + inoise;
+
+			// Saturate instead of wraparound
+			if (acc > FX_CLIP) {
+				acc = FX_CLIP;
+				ch->clipped++;
+			}
+			if (acc < -FX_CLIP) {
+				acc = -FX_CLIP;
+				ch->clipped++;
+			}
+			out[k] = (int16_t)acc;
+		}
+	}
+}
+
+void channel_fx_process(struct channel_fx_s *ch, const int16_t *in, int16_t *out, int len)
+{
+	int n, clipped = 0;
+
+	while (len > 0) {
+		n = (len < CHAN_BLOCK) ? len : CHAN_BLOCK;
+		simprocess_fx(ch, in, out, n);
+		clipped += ch->clipped;
+		in += n;
+		out += n;
+		len -= n;
+	}
+	ch->clipped = clipped;
+}
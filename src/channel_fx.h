@@ -0,0 +1,89 @@
+#ifndef _CHANNEL_FX_H
+#define _CHANNEL_FX_H
+
+#include <stdint.h>
+
+#include "channel.h"
+#include "filter.h"
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Fixed-point channel for targets without a fast FPU.
+ *
+ * Formats:
+ *   samples          Q15 in int16_t (the PCM samples)
+ *   Hilbert FIR      Q15 coefficients, 32 bit accumulator
+ *   IIR filters      Q28 coefficients, Q16 data, 64 bit products
+ *   fading gains     Q12
+ *   oscillators      32 bit phase accumulator, interpolated Q15 sine table
+ *
+ * Floating point is used at initialization only. The buffers have the
+ * fixed sizes of an audio rate channel: the Hilbert transformer keeps
+ * the 64 taps of 8000 sps and path delays are limited to 255 samples.
+ * There is no IQ mode.
+ */
+
+#define FX_GAUSS_BITS	12	/* 4096 entry noise tables */
+#define FX_SINE_BITS	10	/* 1024 entry sine table */
+#define FX_FILTERLEN	FILTER_LEN_8K	/* Hilbert transformer length */
+#define FX_BUFFERLEN	1024	/* Hilbert input history */
+#define FX_DELAYTAPS	256	/* longest path delay + 1 */
+
+struct biquad_fx_s {
+	int32_t b0, b1, b2;	/* Q28 */
+	int32_t a1, a2;		/* Q28 */
+	int32_t x1, x2;		/* Q16 */
+	int32_t y1, y2;		/* Q16 */
+};
+
+struct nco_fx_s {
+	uint32_t phase;
+	int64_t freq;		/* phase increment per sample, Q32 */
+	int64_t drift;		/* change of freq per sample, Q32 */
+};
+
+struct channel_fx_s {
+	struct chan_parms_s parms;
+
+	int16_t hfilter[2][FX_FILTERLEN];	/* I and Q Hilbert coefficients */
+	int16_t hbuffer[FX_BUFFERLEN];	/* I and Q see the same input */
+	int hptr;
+	int hshift;			/* fraction bits of the coefficients */
+
+	int16_t dline[2][FX_DELAYTAPS];	/* delayed path I and Q */
+	int dptr, ddelay;
+
+	int16_t rmsbuf[256];		/* RMS over 256 samples */
+	int rmsptr, rmscounter;
+	int32_t rmsval;			/* Q15 */
+
+	struct biquad_fx_s noise;	/* noise shaping filter */
+	struct biquad_fx_s fade[4];	/* I/Q of both path fading filters */
+	int32_t fade0[2], fade1[2];	/* current fading gains, Q12 */
+	int pointsleft;
+	int updrate, updrem;		/* fading gain updates per second, remainder */
+
+	struct nco_fx_s offset, direct, delayed;
+
+	int32_t invsiglvl;		/* 1 / SigLvl, Q24 */
+	int multipath, fading, shift;
+	uint32_t rng;			/* xorshift32 state */
+
+	int clipped;			/* clipped samples in the last call */
+};
+
+/* ---------------------------------------------------------------------- */
+
+extern struct channel_fx_s *init_channel_fx(const struct chan_parms_s *);
+extern void clear_channel_fx(struct channel_fx_s *);
+
+/* process any number of samples, 'out' may be the same as 'in' */
+extern void channel_fx_process(struct channel_fx_s *, const int16_t *in, int16_t *out, int len);
+
+extern void init_nco_fx(struct nco_fx_s *, float freq, float drift, float samplerate);
+extern void nco_fx_real(struct nco_fx_s *, int16_t *out, int len);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _CHANNEL_FX_H */
@@ -2,21 +2,73 @@
 #define _CHANSIM_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "cplx.h"
 
 #define Version "0.56-bns-4"
 
-static inline float RNG(void)
+/* force inlining of kernel templates, such that constant
+ * configuration parameters are folded away */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE	inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define ALWAYS_INLINE	__forceinline
+#else
+#define ALWAYS_INLINE	inline
+#endif
+
+/*
+ * Additive feedback random number generator. This is the algorithm
+ * of rand() in the GNU C library, but every channel owns its state:
+ * channels are reproducible and independent of each other.
+ */
+#define RNG_MAX	2147483647
+
+struct rng_s {
+	uint32_t state[31];
+	int f, r;	/* front and rear index, 3 apart */
+};
+
+static inline int32_t rng_next(struct rng_s *g)
 {
-        return ((float) rand() / RAND_MAX);
+	uint32_t val = g->state[g->f] += g->state[g->r];
+
+	if (++g->f >= 31)
+		g->f = 0;
+	if (++g->r >= 31)
+		g->r = 0;
+
+	/* chucking least random bit */
+	return (int32_t)(val >> 1);
 }
 
-/* in fade.c */
-extern void GaussInit(float frspread, int tapupdrate);
-extern void FadeGains(float_complex *, float_complex *);
+static inline void rng_seed(struct rng_s *g, unsigned int seed)
+{
+	int32_t word;
+	long hi, lo;
+	int i;
+
+	if (seed == 0)
+		seed = 1;
+	g->state[0] = word = (int32_t)seed;
+	for (i = 1; i < 31; i++) {
+		hi = word / 127773;
+		lo = word % 127773;
+		word = (int32_t)(16807 * lo - 2836 * hi);
+		if (word < 0)
+			word += 2147483647;
+		g->state[i] = (uint32_t)word;
+	}
+	g->f = 3;
+	g->r = 0;
+
+	for (i = 0; i < 310; i++)
+		(void)rng_next(g);
+}
 
-/* in delay.c */
-extern void init_delayline(float delay_time_in_sec, int samplerate);
-extern float_complex delayline(float_complex);
+static inline float RNG(struct rng_s *g)
+{
+        return ((float) rng_next(g) / RNG_MAX);
+}
 
 #endif
@@ -0,0 +1,415 @@
+//----------------------------------------------------------------------------
+// Chunk mode: one long file processed in parallel, see chunk.h.
+//
+// Chunk c holds the samples c * L ... (c + 1) * L - 1. Its channel
+// starts CHUNK_WARMUP seconds earlier, at s0, and takes the noise and
+// fading from a source here (channel_set_source()), which draws the
+// random numbers of every span with a seed of its own:
+//
+//     noise     span_seed(seed, tag, s / NOISE_SPAN), s the sample
+//     fading    span_seed(seed, tag, u / FADE_SPAN), u the update
+//
+// The fading updates are those of the sequential run: update u is at
+// sample floor(u * rate / TapUpdRate), so the channel's update count is
+// set for s0 like the shifters' phases and the RMS update count.
+//
+// The workers (the main thread being one) take a chunk each per round,
+// the main thread then writes them in order.
+//----------------------------------------------------------------------------
+
+#define _USE_MATH_DEFINES
+
+#include "chunk.h"
+#include "channel.h"
+#include "noise.h"
+#include "fade.h"
+#include "nco.h"
+#include "rms.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#define TAG_NOISE	0x4e
+#define TAG_NOISEQ	0x51
+#define TAG_FADE	0x46
+
+struct chunk_src_s {
+	struct chan_source_s source;
+	struct noise_s *noise[2];	/* I and Q in IQ mode */
+	struct fade_s *fade;		/* NULL without fading */
+	struct rng_s nrng[2];
+	struct rng_s frng;
+	long long pos;			/* next noise sample */
+	long long upd;			/* next fading update */
+	unsigned int seed;
+};
+
+struct chunk_worker_s {
+	struct chan_work_s *work;
+	struct chunk_src_s src;
+	float *buf;			/* warm-up and chunk, I/Q pairs in IQ mode */
+	int16_t *pcm;
+	long long first;		/* the chunk's first sample */
+	int count;			/* its samples, 0 = none this round */
+	int clipped;
+	int error;
+};
+
+static struct chan_parms_s Parms;
+static int IQ;
+static float Gain;
+static int Fd;				/* the input file */
+static off_t Base;			/* its offset at the start */
+static long long Total;			/* samples */
+static int Len;				/* samples per chunk */
+static int Warmup;			/* samples ahead of a chunk */
+static struct chunk_worker_s *Worker;
+
+//----------------------------------------------------------------------------
+// Noise and fading
+//----------------------------------------------------------------------------
+
+// Seed of span 'k' of a random number stream (splitmix64 finalizer).
+static unsigned int span_seed(unsigned int seed, unsigned int tag, long long k)
+{
+	uint64_t z = ((uint64_t)seed << 32) ^ ((uint64_t)tag << 56) ^ (uint64_t)k;
+
+	z += 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+
+	return (unsigned int)z;
+}
+
+static void chunk_noise(void *arg, float *n, float *nq, int len)
+{
+	struct chunk_src_s *s = arg;
+	int i, k;
+
+	for (i = 0; i < len; i += k) {
+		if (s->pos % NOISE_SPAN == 0) {
+			rng_seed(&s->nrng[0], span_seed(s->seed, TAG_NOISE, s->pos / NOISE_SPAN));
+			rng_seed(&s->nrng[1], span_seed(s->seed, TAG_NOISEQ, s->pos / NOISE_SPAN));
+		}
+		k = NOISE_SPAN - (int)(s->pos % NOISE_SPAN);
+		if (k > len - i)
+			k = len - i;
+
+		BandLtdNoiseBlock(s->noise[0], n + i, k);
+		if (nq)
+			BandLtdNoiseBlock(s->noise[1], nq + i, k);
+		s->pos += k;
+	}
+}
+
+static void chunk_fade(void *arg, float_complex *fade0, float_complex *fade1)
+{
+	struct chunk_src_s *s = arg;
+
+	if (s->upd % FADE_SPAN == 0)
+		rng_seed(&s->frng, span_seed(s->seed, TAG_FADE, s->upd / FADE_SPAN));
+	FadeGains(s->fade, fade0, fade1);
+	s->upd++;
+}
+
+static void free_source(struct chunk_src_s *s)
+{
+	clear_noise(s->noise[0]);
+	clear_noise(s->noise[1]);
+	clear_fade(s->fade);
+}
+
+//----------------------------------------------------------------------------
+// A channel starting at sample s0, as far as the sequential run there
+// can be known without processing what is before.
+//----------------------------------------------------------------------------
+static struct channel_s *chunk_channel(struct chunk_src_s *s, long long s0)
+{
+	float n[CHAN_BLOCK], nq[CHAN_BLOCK];
+	struct channel_s *ch;
+	long long rate = Parms.samplerate;
+	long long k, u0;
+	float cutoff = IQ ? Parms.bandwidth / 2 : Parms.bandwidth;
+	float spread;
+	int err = 0;
+	int len;
+
+	memset(s, 0, sizeof(struct chunk_src_s));
+	s->seed = Parms.seed;
+	s->source.noise = chunk_noise;
+	s->source.fade = chunk_fade;
+	s->source.arg = s;
+
+	err |= !(ch = init_channel_shared(&Parms));
+	err |= !(s->noise[0] = init_noise(Parms.noisetype, (float)rate, cutoff, &s->nrng[0]));
+	if (IQ)
+		err |= !(s->noise[1] = init_noise(Parms.noisetype, (float)rate, cutoff, &s->nrng[1]));
+	if (!err && ch->FrSpread > 0.0F)
+		err |= !(s->fade = GaussInit(ch->FrSpread, ch->TapUpdRate, &s->frng));
+	if (err) {
+		if (ch)
+			clear_channel(ch);
+		free_source(s);
+		return NULL;
+	}
+	channel_set_source(ch, &s->source);
+
+	// the noise from the start of its span
+	s->pos = s0 - s0 % NOISE_SPAN;
+	while (s->pos < s0) {
+		len = (s0 - s->pos < CHAN_BLOCK) ? (int)(s0 - s->pos) : CHAN_BLOCK;
+		chunk_noise(s, n, IQ ? nq : NULL, len);
+	}
+
+	// the first fading update at s0 or after, the filter primed with
+	// the updates before, the gains of the last one held until then
+	if (s->fade) {
+		memset(s->fade->IFade0, 0, sizeof(s->fade->IFade0));
+		memset(s->fade->QFade0, 0, sizeof(s->fade->QFade0));
+		memset(s->fade->IFade1, 0, sizeof(s->fade->IFade1));
+		memset(s->fade->QFade1, 0, sizeof(s->fade->QFade1));
+
+		// the time constant in updates, as in GaussInit()
+		spread = ch->FrSpread * 2.0F * (float)M_PI / ch->TapUpdRate / (float)M_SQRT2;
+		k = (s0 * ch->TapUpdRate + rate - 1) / rate;
+		u0 = k - (long long)(FADE_PRIME / spread);
+		if (u0 < 0)
+			u0 = 0;
+		s->upd = u0 - u0 % FADE_SPAN;
+		while (s->upd < k)
+			chunk_fade(s, &ch->fade0, &ch->fade1);
+
+		ch->pointsleft = (int)(k * rate / ch->TapUpdRate - s0);
+		ch->updrem = (int)(k * rate % ch->TapUpdRate);
+	}
+
+	// the RMS updates every interval + 1 samples, counted from 0
+	if (ch->rms)
+		ch->rms->counter = (int)(s0 % (ch->rms->interval + 1));
+
+	if (ch->offset)
+		nco_seek(ch->offset, s0);
+	if (ch->direct)
+		nco_seek(ch->direct, s0);
+	if (ch->delayed)
+		nco_seek(ch->delayed, s0);
+	ch->samples = s0;
+
+	return ch;
+}
+
+//----------------------------------------------------------------------------
+// One chunk
+//----------------------------------------------------------------------------
+static int read_at(int16_t *pcm, long long first, int n)
+{
+	size_t want = (size_t)n * (IQ ? 4 : 2);
+	off_t off = Base + (off_t)first * (IQ ? 4 : 2);
+	char *p = (char *)pcm;
+	ssize_t got;
+
+	while (want > 0) {
+		if ((got = pread(Fd, p, want, off)) <= 0)
+			return -1;
+		p += got;
+		off += got;
+		want -= got;
+	}
+
+	return 0;
+}
+
+static void process_chunk(struct chunk_worker_s *wk)
+{
+	int w = IQ ? 2 : 1;
+	long long s0 = (wk->first > Warmup) ? wk->first - Warmup : 0;
+	int n = (int)(wk->first + wk->count - s0);
+	int skip = (int)(wk->first - s0);
+	struct channel_s *ch;
+	float x;
+	int i;
+
+	wk->clipped = 0;
+	if (read_at(wk->pcm, s0, n) < 0) {
+		wk->error = 1;
+		return;
+	}
+	for (i = 0; i < w * n; i++)
+		wk->buf[i] = wk->pcm[i] * Gain / 32768.0F;
+
+	if ((ch = chunk_channel(&wk->src, s0)) == NULL) {
+		wk->error = 1;
+		return;
+	}
+	if (IQ)
+		channel_process_iq_work(ch, wk->work, (const float_complex *)wk->buf,
+					(float_complex *)wk->buf, n);
+	else
+		channel_process_work(ch, wk->work, wk->buf, wk->buf, n);
+	clear_channel(ch);
+	free_source(&wk->src);
+
+	for (i = 0; i < w * wk->count; i++) {
+		x = wk->buf[w * skip + i];
+		if (x > 0.999F || x < -0.999F) {
+			x = (x > 0.0F) ? 0.999F : -0.999F;
+			wk->clipped++;
+		}
+		wk->pcm[i] = (int16_t)(x * 32768.0F);
+	}
+}
+
+//----------------------------------------------------------------------------
+// Worker pool. Worker k takes the k-th chunk of a round.
+//----------------------------------------------------------------------------
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t Done = PTHREAD_COND_INITIALIZER;
+static int Workers;
+static int Round;			/* rounds started */
+static int Pending;			/* workers still busy with this round */
+
+static void *worker(void *arg)
+{
+	struct chunk_worker_s *wk = &Worker[(intptr_t)arg];
+	int round = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&Lock);
+		while (Round == round)
+			pthread_cond_wait(&Start, &Lock);
+		round = Round;
+		pthread_mutex_unlock(&Lock);
+
+		if (wk->count)
+			process_chunk(wk);
+
+		pthread_mutex_lock(&Lock);
+		if (--Pending == 0)
+			pthread_cond_signal(&Done);
+		pthread_mutex_unlock(&Lock);
+	}
+
+	return NULL;
+}
+
+static void run_round(void)
+{
+	pthread_mutex_lock(&Lock);
+	Round++;
+	Pending = Workers - 1;
+	pthread_cond_broadcast(&Start);
+	pthread_mutex_unlock(&Lock);
+
+	if (Worker[0].count)
+		process_chunk(&Worker[0]);
+
+	pthread_mutex_lock(&Lock);
+	while (Pending > 0)
+		pthread_cond_wait(&Done, &Lock);
+	pthread_mutex_unlock(&Lock);
+}
+
+//----------------------------------------------------------------------------
+// Main loop
+//----------------------------------------------------------------------------
+int run_chunks(double seconds, int workers, const struct chan_parms_s *p,
+	       float gain, long long total)
+{
+	int w = p->iq ? 2 : 1;
+	long long chunks, next;
+	struct stat st;
+	pthread_t tid;
+	int i;
+
+	Parms = *p;
+	Parms.amplitude *= gain;
+	IQ = p->iq;
+	Gain = gain;
+	Fd = fileno(stdin);
+
+	if (fstat(Fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		fprintf(stderr, "chansim: chunk mode needs a file on stdin\n");
+		return -1;
+	}
+	Base = lseek(Fd, 0, SEEK_CUR);
+	Total = (st.st_size - Base) / (2 * w);
+	if (total > 0 && total < Total)
+		Total = total;
+
+	Len = (int)(seconds * p->samplerate + 0.5);
+	Warmup = (int)(CHUNK_WARMUP * p->samplerate + 0.5);
+	if (Len < CHAN_BLOCK) {
+		fprintf(stderr, "chansim: chunks of at least %d samples\n", CHAN_BLOCK);
+		return -1;
+	}
+	chunks = (Total + Len - 1) / Len;
+	Workers = (workers < 1) ? 1 : workers;
+	if (Workers > chunks)
+		Workers = chunks ? (int)chunks : 1;
+
+	if ((Worker = calloc(Workers, sizeof(struct chunk_worker_s))) == NULL) {
+		fprintf(stderr, "chansim: out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < Workers; i++) {
+		Worker[i].work = malloc(sizeof(struct chan_work_s));
+		Worker[i].buf = malloc((size_t)w * (Warmup + Len) * sizeof(float));
+		Worker[i].pcm = malloc((size_t)w * (Warmup + Len) * sizeof(int16_t));
+		if (!Worker[i].work || !Worker[i].buf || !Worker[i].pcm) {
+			fprintf(stderr, "chansim: out of memory\n");
+			return -1;
+		}
+	}
+
+	for (i = 1; i < Workers; i++) {
+		if (pthread_create(&tid, NULL, worker, (void *)(intptr_t)i)) {
+			perror("chansim: pthread_create");
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	fprintf(stderr, "Chunks: %lld of %.1f s, %d worker(s)\n", chunks, seconds, Workers);
+
+	for (next = 0; next < chunks; ) {
+		for (i = 0; i < Workers; i++, next++) {
+			Worker[i].first = next * Len;
+			Worker[i].count = (next < chunks) ?
+				(int)((Total - Worker[i].first < Len) ? Total - Worker[i].first : Len) : 0;
+		}
+
+		run_round();
+
+		for (i = 0; i < Workers && Worker[i].count; i++) {
+			if (Worker[i].error) {
+				fprintf(stderr, "chansim: chunk at sample %lld failed\n", Worker[i].first);
+				return -1;
+			}
+			if (Worker[i].clipped)
+				fprintf(stderr, "chansim: clipping! (%d samples)\n", Worker[i].clipped);
+			if (fwrite(Worker[i].pcm, w * sizeof(int16_t), Worker[i].count, stdout)
+			    != (size_t)Worker[i].count) {
+				perror("chansim: write");
+				return -1;
+			}
+		}
+	}
+
+	fflush(stdout);
+	for (i = 0; i < Workers; i++) {
+		free(Worker[i].work);
+		free(Worker[i].buf);
+		free(Worker[i].pcm);
+	}
+	free(Worker);
+
+	return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef _CHUNK_H
+#define _CHUNK_H
+
+#include "channel.h"
+
+#define CHUNK_WARMUP	0.25	/* seconds processed ahead of a chunk, discarded */
+#define NOISE_SPAN	4096	/* noise samples per random number seed */
+#define FADE_SPAN	64	/* fading updates per random number seed */
+#define FADE_PRIME	40	/* fading filter priming in 1 / spread updates */
+
+/*
+ * Chunk mode: a PCM file on stdin is cut into chunks of 'seconds', which
+ * 'workers' threads process in parallel, the output going to stdout in
+ * order. Every chunk has its own channel, primed by CHUNK_WARMUP seconds
+ * of the input before it: the Hilbert transformer, delay line, RMS
+ * window and noise filter are in the state the sequential run has there.
+ *
+ * The random numbers are not those of one long sequence. The noise of
+ * every NOISE_SPAN samples and the fading inputs of every FADE_SPAN
+ * updates are drawn with a seed derived from 'p->seed' and their
+ * position in the file. A chunk starts drawing at the span before its
+ * warm-up, its fading filter FADE_PRIME time constants before, so the
+ * noise and fading are the same sequence in every chunk and go on over
+ * the seams. The shifters are set to their phase at the chunk's start.
+ *
+ * The output does not depend on the number of workers; a chunk length
+ * changes it only within the precision of the primed filters. 'total'
+ * limits the samples processed (0 = the whole file). Returns nonzero on
+ * errors.
+ */
+extern int run_chunks(double seconds, int workers, const struct chan_parms_s *p,
+		      float gain, long long total);
+
+#endif
@@ -0,0 +1,149 @@
+
+#include "control.h"
+#include "filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Parse "key=value" settings, separated by blanks.
+//----------------------------------------------------------------------------
+const char *parse_settings(struct chan_settings_s *s, char *line)
+{
+	struct chan_settings_s n = *s;
+	struct chan_parms_s *p = &n.parms;
+	char *tok, *val;
+	size_t len;
+
+	for (tok = line + strspn(line, " \t\r\n"); *tok; tok += len, tok += strspn(tok, " \t\r\n")) {
+		len = strcspn(tok, " \t\r\n");
+		if (tok[len])
+			tok[len++] = 0;
+
+		if ((val = strchr(tok, '=')) == NULL)
+			return "expected key=value";
+		*val++ = 0;
+
+		if (!strcmp(tok, "snr"))
+			p->snr = (float)atof(val);
+		else if (!strcmp(tok, "chan"))
+			p->simform = atoi(val);
+		else if (!strcmp(tok, "noise"))
+			p->noisetype = atoi(val);
+		else if (!strcmp(tok, "seed")) {
+			p->seed = (unsigned int)strtoul(val, NULL, 0);
+			n.seeded = 1;
+		} else if (!strcmp(tok, "rate"))
+			p->samplerate = atoi(val);
+		else if (!strcmp(tok, "bw"))
+			p->bandwidth = (float)atof(val);
+		else if (!strcmp(tok, "ampl"))
+			p->amplitude = (float)atof(val);
+		else if (!strcmp(tok, "gain"))
+			n.gain = (float)atof(val);
+		else if (!strcmp(tok, "offset"))
+			p->offset = (float)atof(val);
+		else if (!strcmp(tok, "drift"))
+			p->drift = (float)atof(val);
+		else if (!strcmp(tok, "doppler0"))
+			p->doppler0 = (float)atof(val);
+		else if (!strcmp(tok, "doppler1"))
+			p->doppler1 = (float)atof(val);
+		else if (!strcmp(tok, "iq"))
+			p->iq = atoi(val);
+		else if (!strcmp(tok, "hilbert"))
+			p->hilbert = atoi(val);
+		else if (!strcmp(tok, "ramp"))
+			n.ramp = (float)atof(val);
+		else
+			return "unknown key";
+	}
+
+	if (p->simform < 0 || p->simform > 7)
+		return "invalid channel type";
+	if (p->noisetype < 0 || p->noisetype > 2)
+		return "invalid noise type";
+	if (p->samplerate <= 0 || p->bandwidth <= 0.0F)
+		return "invalid rate or bandwidth";
+	if (p->hilbert < FILTER_FIR || p->hilbert > FILTER_IIR_BAND)
+		return "invalid Hilbert transformer";
+	if (n.ramp < 0.0F)
+		return "invalid ramp";
+
+	*s = n;
+	return NULL;
+}
+
+#ifndef WIN32
+
+//----------------------------------------------------------------------------
+// Control FIFO. It is opened for reading and writing, so it does not
+// report end of file when the last writer closes.
+//----------------------------------------------------------------------------
+struct control_s *init_control(const char *path)
+{
+	struct control_s *c;
+
+	if ((c = calloc(1, sizeof(struct control_s))) == NULL)
+		return NULL;
+
+	if (mkfifo(path, 0600) < 0 && errno != EEXIST) {
+		free(c);
+		return NULL;
+	}
+
+	if ((c->fd = open(path, O_RDWR | O_NONBLOCK)) < 0) {
+		free(c);
+		return NULL;
+	}
+
+	return c;
+}
+
+void clear_control(struct control_s *c)
+{
+	close(c->fd);
+	free(c);
+}
+
+char *control_line(struct control_s *c)
+{
+	char *nl;
+	ssize_t r;
+	int len;
+
+	for (;;) {
+		if ((nl = memchr(c->buf, '\n', c->len)) != NULL) {
+			len = (int)(nl - c->buf);
+			memcpy(c->line, c->buf, len);
+			c->line[len] = 0;
+			c->len -= len + 1;
+			memmove(c->buf, nl + 1, c->len);
+			if (c->skip) {
+				c->skip = 0;
+				continue;
+			}
+			return c->line;
+		}
+
+		// no room left for the newline, drop that line
+		if (c->len == CONTROL_LINE) {
+			c->len = 0;
+			c->skip = 1;
+		}
+
+		r = read(c->fd, c->buf + c->len, CONTROL_LINE - c->len);
+		if (r <= 0)
+			return NULL;
+		c->len += (int)r;
+	}
+}
+
+#endif
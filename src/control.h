@@ -0,0 +1,55 @@
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+#include "channel.h"
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Channel settings as given on a "key=value ..." text line, e.g.
+ * "snr=10 chan=3 ramp=0.5". Used by the daemon handshake and the
+ * control FIFO.
+ */
+struct chan_settings_s {
+	struct chan_parms_s parms;	/* amplitude not scaled by gain */
+	float gain;			/* input gain */
+	float ramp;			/* SNR ramp time in seconds, 0 = step */
+	int seeded;			/* the line had a seed */
+};
+
+/*
+ * Update 's' from the settings in 'line' (which is modified).
+ * Returns NULL, or an error message leaving 's' unchanged.
+ */
+extern const char *parse_settings(struct chan_settings_s *s, char *line);
+
+/* ---------------------------------------------------------------------- */
+
+#ifndef WIN32
+
+#define CONTROL_LINE	256	/* max length of a command line */
+
+/*
+ * Command input from a FIFO. It is polled between two blocks, writers
+ * may come and go, e.g. echo "snr=6 ramp=1" > ctl
+ */
+struct control_s {
+	int fd;
+	int len;			/* bytes in buf */
+	int skip;			/* dropping an overlong line */
+	char buf[CONTROL_LINE];
+	char line[CONTROL_LINE];
+};
+
+/* opens the FIFO, creates it if missing */
+extern struct control_s *init_control(const char *path);
+extern void clear_control(struct control_s *);
+
+/* next complete line without the newline, NULL if there is none */
+extern char *control_line(struct control_s *);
+
+#endif
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _CONTROL_H */
@@ -0,0 +1,576 @@
+//----------------------------------------------------------------------------
+// Daemon mode: many client streams, each through its own channel.
+//
+// Clients connect to a Unix domain socket or a localhost TCP port and
+// send one handshake line of "key=value" settings, for example
+//
+//     snr=15 chan=3 noise=0 seed=42 rate=8000
+//
+// Keys: snr, chan, noise, seed, rate, bw, ampl, gain, offset, drift,
+// doppler0, doppler1, iq, hilbert. Missing keys take the values of the
+// daemon's command line. The daemon answers "OK" or "ERR <reason>" (one
+// line). After OK, the client streams 16-bit PCM (I/Q pairs with iq=1)
+// and reads back the same number of processed samples. Shutting down the
+// write direction flushes the remaining output and closes the stream.
+//
+// One thread runs the epoll event loop and does all socket I/O. Worker
+// threads run the channels. A stream is owned either by the event loop
+// or by one worker, so its buffers need no locks. Streams come from a
+// pool and share the kernel scratch buffers of the workers. A stream's
+// channel is not pooled: init_channel_shared() allocates it and each of
+// its modules separately, as in every other mode, once per connection
+// in the handshake and never while samples flow.
+//----------------------------------------------------------------------------
+
+#include "daemon.h"
+#include "channel.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define STREAM_BUF	1024	/* samples buffered per direction */
+#define POOL_CHUNK	64	/* streams allocated at once */
+#define HANDSHAKE_MAX	256	/* max length of the handshake line */
+#define MAX_EVENTS	64
+
+enum { ST_HANDSHAKE, ST_RUNNING };
+
+struct stream_s {
+	int fd;
+	int state;
+	int busy;			/* owned by a worker */
+	int eof;			/* client closed its write direction */
+	int events;			/* registered epoll events, 0 = none */
+	float gain;			/* input gain */
+	struct channel_s *ch;
+	int inlen;			/* bytes in inbuf */
+	int outlen, outpos;		/* bytes in outbuf, bytes sent */
+	struct stream_s *next;		/* free list and queues */
+	int16_t inbuf[STREAM_BUF];
+	int16_t outbuf[STREAM_BUF];
+};
+
+static struct chan_parms_s Defaults;
+static float DefaultGain;
+static unsigned int Connections;	/* seeds streams without a seed key */
+
+static int Epoll = -1;
+static int Wakeup = -1;			/* eventfd, signals finished jobs */
+static int Listener = -1;
+
+/* epoll tags of the non stream descriptors */
+static char ListenTag, WakeupTag;
+
+//----------------------------------------------------------------------------
+// Stream pool. Only used from the event loop.
+//----------------------------------------------------------------------------
+static struct stream_s *FreeStreams;
+
+static struct stream_s *stream_alloc(void)
+{
+	struct stream_s *s;
+	int i;
+
+	if (!FreeStreams) {
+		s = calloc(POOL_CHUNK, sizeof(struct stream_s));
+		if (!s)
+			return NULL;
+		for (i = 0; i < POOL_CHUNK; i++) {
+			s[i].next = FreeStreams;
+			FreeStreams = &s[i];
+		}
+	}
+
+	s = FreeStreams;
+	FreeStreams = s->next;
+
+	s->fd = -1;
+	s->state = ST_HANDSHAKE;
+	s->busy = 0;
+	s->eof = 0;
+	s->events = 0;
+	s->ch = NULL;
+	s->inlen = 0;
+	s->outlen = 0;
+	s->outpos = 0;
+	s->next = NULL;
+
+	return s;
+}
+
+static void stream_free(struct stream_s *s)
+{
+	s->next = FreeStreams;
+	FreeStreams = s;
+}
+
+//----------------------------------------------------------------------------
+// Job queue (event loop -> workers) and done queue (workers -> event loop)
+//----------------------------------------------------------------------------
+static pthread_mutex_t JobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t JobCond = PTHREAD_COND_INITIALIZER;
+static struct stream_s *JobHead, *JobTail;
+
+static pthread_mutex_t DoneLock = PTHREAD_MUTEX_INITIALIZER;
+static struct stream_s *DoneList;
+
+static void job_push(struct stream_s *s)
+{
+	s->next = NULL;
+	pthread_mutex_lock(&JobLock);
+	if (JobTail)
+		JobTail->next = s;
+	else
+		JobHead = s;
+	JobTail = s;
+	pthread_cond_signal(&JobCond);
+	pthread_mutex_unlock(&JobLock);
+}
+
+static struct stream_s *job_pop(void)
+{
+	struct stream_s *s;
+
+	pthread_mutex_lock(&JobLock);
+	while (!JobHead)
+		pthread_cond_wait(&JobCond, &JobLock);
+	s = JobHead;
+	JobHead = s->next;
+	if (!JobHead)
+		JobTail = NULL;
+	pthread_mutex_unlock(&JobLock);
+
+	return s;
+}
+
+static void done_push(struct stream_s *s)
+{
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&DoneLock);
+	s->next = DoneList;
+	DoneList = s;
+	pthread_mutex_unlock(&DoneLock);
+
+	if (write(Wakeup, &one, sizeof(one)) < 0)
+		perror("chansim: eventfd write");
+}
+
+static struct stream_s *done_take(void)
+{
+	struct stream_s *s;
+
+	pthread_mutex_lock(&DoneLock);
+	s = DoneList;
+	DoneList = NULL;
+	pthread_mutex_unlock(&DoneLock);
+
+	return s;
+}
+
+//----------------------------------------------------------------------------
+// Workers: push the received samples through the stream's channel.
+//----------------------------------------------------------------------------
+static void process_stream(struct stream_s *s, struct chan_work_s *work, float *fbuf)
+{
+	int frame = s->ch->parms.iq ? 2 * sizeof(int16_t) : sizeof(int16_t);
+	int frames = s->inlen / frame;
+	int n = frames * frame / (int)sizeof(int16_t);
+	int rest = s->inlen - frames * frame;
+	float x;
+	int i;
+
+	for (i = 0; i < n; i++)
+		fbuf[i] = s->inbuf[i] * s->gain / 32768.0F;
+
+	if (s->ch->parms.iq)
+		channel_process_iq_work(s->ch, work, (float_complex *)fbuf, (float_complex *)fbuf, frames);
+	else
+		channel_process_work(s->ch, work, fbuf, fbuf, frames);
+
+	for (i = 0; i < n; i++) {
+		// Saturate instead of wraparound
+		x = fbuf[i];
+		if (x > 0.999F)
+			x = 0.999F;
+		if (x < -0.999F)
+			x = -0.999F;
+		s->outbuf[i] = (int16_t)(x * 32768.0F);
+	}
+	s->outlen = n * (int)sizeof(int16_t);
+	s->outpos = 0;
+
+	// keep the bytes of an incomplete sample
+	memmove(s->inbuf, (char *)s->inbuf + s->inlen - rest, rest);
+	s->inlen = rest;
+}
+
+static void *worker(void *arg)
+{
+	struct chan_work_s *work;
+	float *fbuf;
+	struct stream_s *s;
+
+	(void)arg;
+
+	work = malloc(sizeof(struct chan_work_s));
+	fbuf = malloc(STREAM_BUF / 2 * sizeof(float_complex));
+	if (!work || !fbuf) {
+		fprintf(stderr, "chansim: worker initialization failed\n");
+		exit(1);
+	}
+
+	for (;;) {
+		s = job_pop();
+		process_stream(s, work, fbuf);
+		done_push(s);
+	}
+
+	return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Event loop side of a stream
+//----------------------------------------------------------------------------
+static int set_events(struct stream_s *s, int events)
+{
+	struct epoll_event ev;
+	int op;
+
+	if (s->events == events)
+		return 0;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (uint32_t)events;
+	ev.data.ptr = s;
+
+	if (events == 0)
+		op = EPOLL_CTL_DEL;
+	else if (s->events == 0)
+		op = EPOLL_CTL_ADD;
+	else
+		op = EPOLL_CTL_MOD;
+
+	if (epoll_ctl(Epoll, op, s->fd, &ev) < 0) {
+		perror("chansim: epoll_ctl");
+		return -1;
+	}
+	s->events = events;
+	return 0;
+}
+
+static void stream_close(struct stream_s *s)
+{
+	set_events(s, 0);
+	close(s->fd);
+	if (s->ch)
+		clear_channel(s->ch);
+	stream_free(s);
+}
+
+static void reply(struct stream_s *s, const char *msg)
+{
+	if (send(s->fd, msg, strlen(msg), MSG_NOSIGNAL) < 0)
+		s->eof = 1;
+}
+
+// Parse the handshake line and create the channel.
+// Returns an error message or NULL.
+static const char *handshake(struct stream_s *s, char *line)
+{
+	struct chan_settings_s set;
+	const char *err;
+
+	set.parms = Defaults;
+	set.gain = DefaultGain;
+	set.ramp = 0.0F;
+	set.seeded = 0;
+
+	if ((err = parse_settings(&set, line)) != NULL)
+		return err;
+
+	// streams without a seed must not share one realization
+	if (!set.seeded)
+		set.parms.seed += Connections;
+	set.parms.amplitude *= set.gain;
+
+	// the channel and its modules from the heap, freed in stream_close()
+	if ((s->ch = init_channel_shared(&set.parms)) == NULL)
+		return "channel initialization failed";
+	s->gain = set.gain;
+
+	return NULL;
+}
+
+static int read_handshake(struct stream_s *s)
+{
+	char *buf = (char *)s->inbuf;
+	char *nl;
+	const char *err;
+	int len;
+
+	nl = memchr(buf, '\n', s->inlen);
+	if (!nl) {
+		if (s->inlen >= HANDSHAKE_MAX) {
+			reply(s, "ERR handshake too long\n");
+			return -1;
+		}
+		return s->eof ? -1 : 0;
+	}
+
+	*nl = 0;
+	if ((err = handshake(s, buf)) != NULL) {
+		char msg[80];
+
+		snprintf(msg, sizeof(msg), "ERR %s\n", err);
+		reply(s, msg);
+		return -1;
+	}
+	reply(s, "OK\n");
+
+	// the samples following the handshake line
+	len = s->inlen - (int)(nl + 1 - buf);
+	memmove(buf, nl + 1, len);
+	s->inlen = len;
+	s->state = ST_RUNNING;
+
+	return 0;
+}
+
+static int read_input(struct stream_s *s)
+{
+	int space = (int)sizeof(s->inbuf) - s->inlen;
+	ssize_t r;
+
+	if (space <= 0 || s->eof)
+		return 0;
+
+	r = read(s->fd, (char *)s->inbuf + s->inlen, space);
+	if (r > 0)
+		s->inlen += (int)r;
+	else if (r == 0)
+		s->eof = 1;
+	else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		return -1;
+
+	if (s->state == ST_HANDSHAKE)
+		return read_handshake(s);
+
+	return 0;
+}
+
+static int write_output(struct stream_s *s)
+{
+	ssize_t w;
+
+	while (s->outpos < s->outlen) {
+		w = send(s->fd, (char *)s->outbuf + s->outpos, s->outlen - s->outpos, MSG_NOSIGNAL);
+		if (w > 0)
+			s->outpos += (int)w;
+		else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else if (w < 0 && errno == EINTR)
+			continue;
+		else
+			return -1;
+	}
+
+	if (s->outpos == s->outlen)
+		s->outpos = s->outlen = 0;
+
+	return 0;
+}
+
+// Decide what a stream waits for next. Returns -1 when it is finished.
+static int stream_update(struct stream_s *s)
+{
+	if (s->outlen > 0)
+		return set_events(s, EPOLLOUT);
+
+	if (s->state == ST_RUNNING && s->inlen >= (s->ch->parms.iq ? 4 : 2)) {
+		// hand over to a worker, the stream leaves the event loop
+		if (set_events(s, 0))
+			return -1;
+		s->busy = 1;
+		job_push(s);
+		return 0;
+	}
+
+	if (s->eof)
+		return -1;
+
+	return set_events(s, EPOLLIN);
+}
+
+static void stream_event(struct stream_s *s, uint32_t events)
+{
+	if (s->busy)
+		return;
+
+	if ((events & EPOLLOUT) && write_output(s) < 0)
+		goto close;
+	if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && read_input(s) < 0)
+		goto close;
+	if (stream_update(s) < 0)
+		goto close;
+	return;
+
+close:
+	stream_close(s);
+}
+
+static void stream_done(struct stream_s *s)
+{
+	s->busy = 0;
+	if (write_output(s) < 0 || stream_update(s) < 0)
+		stream_close(s);
+}
+
+static void accept_streams(void)
+{
+	struct stream_s *s;
+	int fd;
+
+	while ((fd = accept(Listener, NULL, NULL)) >= 0) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		if ((s = stream_alloc()) == NULL) {
+			close(fd);
+			continue;
+		}
+		s->fd = fd;
+		Connections++;
+		if (set_events(s, EPOLLIN) < 0)
+			stream_close(s);
+	}
+}
+
+//----------------------------------------------------------------------------
+// Listening socket: Unix domain path or tcp:<port> on localhost
+//----------------------------------------------------------------------------
+static int open_listener(const char *address)
+{
+	int fd;
+
+	if (!strncmp(address, "tcp:", 4)) {
+		struct sockaddr_in sin;
+		int one = 1;
+
+		if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+			return -1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		memset(&sin, 0, sizeof(sin));
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons((uint16_t)atoi(address + 4));
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+			close(fd);
+			return -1;
+		}
+	} else {
+		struct sockaddr_un sun;
+
+		if (strlen(address) >= sizeof(sun.sun_path)) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			return -1;
+		memset(&sun, 0, sizeof(sun));
+		sun.sun_family = AF_UNIX;
+		strcpy(sun.sun_path, address);
+		unlink(address);
+		if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	if (listen(fd, 64) < 0) {
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+int run_daemon(const char *address, int workers,
+	       const struct chan_parms_s *defaults, float gain)
+{
+	struct epoll_event ev, events[MAX_EVENTS];
+	struct stream_s *s, *next;
+	pthread_t tid;
+	uint64_t cnt;
+	int i, n;
+
+	Defaults = *defaults;
+	DefaultGain = gain;
+
+	if ((Listener = open_listener(address)) < 0) {
+		perror("chansim: listen");
+		return -1;
+	}
+	if ((Wakeup = eventfd(0, EFD_NONBLOCK)) < 0 || (Epoll = epoll_create1(0)) < 0) {
+		perror("chansim: epoll");
+		return -1;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &ListenTag;
+	epoll_ctl(Epoll, EPOLL_CTL_ADD, Listener, &ev);
+	ev.data.ptr = &WakeupTag;
+	epoll_ctl(Epoll, EPOLL_CTL_ADD, Wakeup, &ev);
+
+	if (workers < 1)
+		workers = 1;
+	for (i = 0; i < workers; i++) {
+		if (pthread_create(&tid, NULL, worker, NULL)) {
+			perror("chansim: pthread_create");
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	fprintf(stderr, "chansim: listening on %s with %d worker(s)\n", address, workers);
+
+	for (;;) {
+		n = epoll_wait(Epoll, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("chansim: epoll_wait");
+			return -1;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == &ListenTag) {
+				accept_streams();
+			} else if (events[i].data.ptr == &WakeupTag) {
+				if (read(Wakeup, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+					perror("chansim: eventfd read");
+				for (s = done_take(); s; s = next) {
+					next = s->next;
+					stream_done(s);
+				}
+			} else {
+				stream_event(events[i].data.ptr, events[i].events);
+			}
+		}
+	}
+
+	return 0;
+}
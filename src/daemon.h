@@ -0,0 +1,14 @@
+#ifndef _DAEMON_H
+#define _DAEMON_H
+
+#include "channel.h"
+
+/*
+ * Serve client streams on 'address', a Unix domain socket path or
+ * "tcp:<port>" for a localhost TCP port. Settings missing in a client
+ * handshake are taken from 'defaults' and 'gain'. Returns on errors only.
+ */
+extern int run_daemon(const char *address, int workers,
+		      const struct chan_parms_s *defaults, float gain);
+
+#endif
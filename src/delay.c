@@ -1,58 +1,80 @@
 
 #define _USE_MATH_DEFINES
 
-#include "chansim.h"
+#include "delay.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
-#define DELAYTAPS	256
+int delay_taps(float delay_time_in_sec, int samplerate)
+{
+	/* scale from seconds to samples */
+	int dllen = (int) floor(delay_time_in_sec * samplerate + 0.5);
 
-static float_complex DelayLine[DELAYTAPS];
+	if (dllen == 0)
+		dllen = 1;
 
-static int Ptr;
-static int DelayPtr;
+	return dllen;
+}
 
-void init_delayline(float delay_time_in_sec, int samplerate)
+/*
+ * Set the delay, keeping the samples in the line.
+ */
+int set_delayline(struct delay_s *d, float delay_time_in_sec, int samplerate)
 {
-	int dllen;
+	int dllen = delay_taps(delay_time_in_sec, samplerate);
 
-	/* clear the delay line */
-	memset(DelayLine, 0, sizeof(DelayLine));
+	if (dllen > d->maxtaps)
+		return -1;
 
-	/* scale from seconds to samples */
-	dllen = (int) floor(delay_time_in_sec * samplerate + 0.5);
+	d->taps = dllen;
 
-	if (dllen == 0)
-		dllen = 1;
+	return 0;
+}
 
-	if (dllen > DELAYTAPS - 1) {
-		dllen = DELAYTAPS - 1;
-		fprintf(stderr,
-			"Warning: path delay too long, limiting to %.1f ms\n",
-			(float) dllen / samplerate * 1000.0);
+struct delay_s *init_delayline(float delay_time_in_sec, int samplerate)
+{
+	struct delay_s *d;
+	int dllen = delay_taps(delay_time_in_sec, samplerate);
+
+	if ((d = calloc(1, sizeof(struct delay_s))) == NULL)
+		return NULL;
+
+	/* the line length scales with the delay and the sample rate */
+	if ((d->line = init_ring(dllen + DELAY_BLOCK, DELAY_BLOCK, 2)) == NULL) {
+		free(d);
+		return NULL;
 	}
+	d->maxtaps = d->line->size - DELAY_BLOCK;
+	d->taps = dllen;
 
-	/* Delayed pointer dllen taps behind the input pointer */
-	Ptr = 0;
-	DelayPtr = DELAYTAPS - dllen;
+	return d;
 }
 
-float_complex delayline(float_complex in)
+void clear_delayline(struct delay_s *d)
 {
-	float_complex out;
-
-	/* save the new sample to the delayline */
-	DelayLine[Ptr] = in;
+	clear_ring(d->line);
+	free(d);
+}
 
-	/* get the delayed sample */
-	out = DelayLine[DelayPtr];
+/*
+ * Blocks of new samples go to the line, then the same number of
+ * samples, 'taps' older, are copied out.
+ */
+void delay_block(struct delay_s *d, const float_complex *in, float_complex *out, int n)
+{
+	int c;
 
-	/* update the pointers */
-	Ptr = (Ptr + 1) % DELAYTAPS;
-	DelayPtr = (DelayPtr + 1) % DELAYTAPS;
+	for (; n > 0; n -= c, in += c, out += c) {
+		c = (n < DELAY_BLOCK) ? n : DELAY_BLOCK;
+		ring_write(d->line, (const float *)in, c);
+		memcpy(out, ring_window(d->line, c, d->taps), c * sizeof(float_complex));
+	}
+}
 
-	return out;
+void delay_zero(struct delay_s *d, int n)
+{
+	ring_zero(d->line, n);
 }
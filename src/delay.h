@@ -0,0 +1,30 @@
+#ifndef _DELAY_H
+#define _DELAY_H
+
+#include "cplx.h"
+#include "ring.h"
+
+#define DELAY_BLOCK	512	/* samples delayed at once */
+
+struct delay_s {
+	struct ring_s *line;	/* complex samples */
+	int maxtaps;		/* longest delay the line holds */
+	int taps;
+};
+
+/* delay in samples, at least one */
+extern int delay_taps(float delay_time_in_sec, int samplerate);
+
+extern struct delay_s *init_delayline(float delay_time_in_sec, int samplerate);
+extern void clear_delayline(struct delay_s *);
+
+/* change the delay, returns -1 if the line is too short for it */
+extern int set_delayline(struct delay_s *, float delay_time_in_sec, int samplerate);
+
+/* out[] is in[] delayed, may not be the same buffer */
+extern void delay_block(struct delay_s *, const float_complex *in, float_complex *out, int n);
+
+/* 'n' zero samples in, the output is not needed */
+extern void delay_zero(struct delay_s *, int n);
+
+#endif
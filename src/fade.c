@@ -2,30 +2,24 @@
 #define _USE_MATH_DEFINES
 
 #include "chansim.h"
+#include "fade.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 
-static float g, a0, a1, a2;
-
-static float IFade0[6];		// direct-path  fading filter state vars
-static float QFade0[6];
-static float IFade1[6];		// delayed-path fading filter state vars
-static float QFade1[6];
-
 //----------------------------------------------------------------------------
 // Rayleigh noise generator -- Gaussian noise.
 // Here, rxx, has Rayleigh distribution (Schartz p.446). Remember
 // its a polar coordinate thing. It is the product it and another
 // jointly-independant variable, z, that's our Gaussian value (Schwartz p365).
 //----------------------------------------------------------------------------
-static inline void Rayleigh(float *Rx, float *Iy)
+static inline void Rayleigh(struct rng_s *rng, float *Rx, float *Iy)
 {
         float rxx, z;
 
-        rxx = sqrtf(-2.0F * logf(RNG()));
-        z = 2.0F * (float)M_PI * RNG();
+        rxx = sqrtf(-2.0F * logf(RNG(rng)));
+        z = 2.0F * (float)M_PI * RNG(rng);
         *Rx = rxx * cosf(z);
         *Iy = rxx * sinf(z);
 }
@@ -38,12 +32,12 @@ static inline void Rayleigh(float *Rx, float *Iy)
 // Fade[0-2] are the current and past outputs
 // Fade[3-5] are the current and past inputs
 //----------------------------------------------------------------------------
-static inline void Gauss_Filter(float *Fade)
+static inline void Gauss_Filter(const struct fade_s *f, float *Fade)
 {
 
         // Gaussian filter:  2-pole, 2-zero IIR
-        Fade[0] = (g * (Fade[3] + 2 * Fade[4] + Fade[5]) -
-		   a1 * Fade[1] - a2 * Fade[2]) / a0;
+        Fade[0] = (f->g * (Fade[3] + 2 * Fade[4] + Fade[5]) -
+		   f->a1 * Fade[1] - f->a2 * Fade[2]) / f->a0;
 
         // adjust the history terms
         Fade[2] = Fade[1];
@@ -55,40 +49,36 @@ static inline void Gauss_Filter(float *Fade)
 //----------------------------------------------------------------------------
 //  Generate Rayleigh-distributed fade gain functions
 //----------------------------------------------------------------------------
-void FadeGains(float_complex *fade0, float_complex *fade1)
+void FadeGains(struct fade_s *f, float_complex *fade0, float_complex *fade1)
 {
         // inputs goes into third element of IIR filter state variables
-        Rayleigh(IFade0 + 3, QFade0 + 3);
-        Rayleigh(IFade1 + 3, QFade1 + 3);
+        Rayleigh(f->rng, f->IFade0 + 3, f->QFade0 + 3);
+        Rayleigh(f->rng, f->IFade1 + 3, f->QFade1 + 3);
 
         // Run through gaussian filter. This actually is a LPF, which happens
         // to have the same Gaussian output properties.
-        Gauss_Filter(IFade0);
-        Gauss_Filter(QFade0);
-        Gauss_Filter(IFade1);
-        Gauss_Filter(QFade1);
+        Gauss_Filter(f, f->IFade0);
+        Gauss_Filter(f, f->QFade0);
+        Gauss_Filter(f, f->IFade1);
+        Gauss_Filter(f, f->QFade1);
 
 	// output is from the first element of IIR state variables
 	if (fade0) {
-		*fade0 = make_float_complex(*IFade0, *QFade0);
+		*fade0 = make_float_complex(*f->IFade0, *f->QFade0);
 	}
 	if (fade1) {
-		*fade1 = make_float_complex(*IFade1, *QFade1);
+		*fade1 = make_float_complex(*f->IFade1, *f->QFade1);
 	}
 }
 
 //----------------------------------------------------------------------------
-// Initialize Gaussian filter coefficients.
-// Set up delay line tap position for second ray.
+// Set the Gaussian filter coefficients for a frequency spread.
+// Returns the spread in rad/symbol (for 2Sigma).
 //----------------------------------------------------------------------------
-void GaussInit(float frspread, int tapupdrate)
+static float GaussCoeffs(struct fade_s *f, float frspread, int tapupdrate)
 {
-        int i;
         float a, c, A, C;
 
-	if (frspread == 0.0F)
-		return;
-
 //--------------------------------------------------------------------------
 // Set up fading generator
 // The bandwidth for the filter is determined by the frequency spread,
@@ -109,25 +99,54 @@ void GaussInit(float frspread, int tapupdrate)
 	C = c / frspread;
 	C *= C;
 
-	// These are GLOBAL
-	// such that others can access it.
-
 	// Compensates for filter Power loss
-	g = sqrtf(0.5F * sqrtf(2.0F * (float)M_PI) / frspread);
-
-	a0 = A + C + 1.0F;
-	a1 = 2 * (1.0F - C);
-	a2 = C + 1.0F - A;
-
-	// Clear filter state elements.
-	for (i = 0; i < 6; i++) {
-		IFade0[i] = 0.0F;
-		QFade0[i] = 0.0F;
-		IFade1[i] = 0.0F;
-		QFade1[i] = 0.0F;
-	}
+	f->g = sqrtf(0.5F * sqrtf(2.0F * (float)M_PI) / frspread);
+
+	f->a0 = A + C + 1.0F;
+	f->a1 = 2 * (1.0F - C);
+	f->a2 = C + 1.0F - A;
+
+	return frspread;
+}
+
+//----------------------------------------------------------------------------
+// Initialize Gaussian filter coefficients.
+// Set up delay line tap position for second ray.
+//----------------------------------------------------------------------------
+struct fade_s *GaussInit(float frspread, int tapupdrate, struct rng_s *rng)
+{
+	struct fade_s *f;
+        int i;
+
+	// Filter state elements are cleared by calloc().
+	if ((f = calloc(1, sizeof(struct fade_s))) == NULL)
+		return NULL;
+
+	f->rng = rng;
+
+	if (frspread == 0.0F)
+		return f;
+
+	frspread = GaussCoeffs(f, frspread, tapupdrate);
 
 	// and prime the filter state
 	for (i = 0; i < 1.0 / frspread; i++)
-		FadeGains(NULL, NULL);
+		FadeGains(f, NULL, NULL);
+
+	return f;
+}
+
+//----------------------------------------------------------------------------
+// Change the frequency spread of a running generator. The filter state
+// is kept, so the fading gains continue without new priming.
+//----------------------------------------------------------------------------
+void GaussSetSpread(struct fade_s *f, float frspread, int tapupdrate)
+{
+	if (frspread > 0.0F)
+		GaussCoeffs(f, frspread, tapupdrate);
+}
+
+void clear_fade(struct fade_s *f)
+{
+	free(f);
 }
@@ -0,0 +1,22 @@
+#ifndef _FADE_H
+#define _FADE_H
+
+#include "cplx.h"
+
+struct rng_s;
+
+struct fade_s {
+	float g, a0, a1, a2;	// Gaussian filter coefficients
+	float IFade0[6];	// direct-path  fading filter state vars
+	float QFade0[6];
+	float IFade1[6];	// delayed-path fading filter state vars
+	float QFade1[6];
+	struct rng_s *rng;	// random numbers for the Rayleigh inputs
+};
+
+extern struct fade_s *GaussInit(float frspread, int tapupdrate, struct rng_s *rng);
+extern void GaussSetSpread(struct fade_s *, float frspread, int tapupdrate);
+extern void clear_fade(struct fade_s *);
+extern void FadeGains(struct fade_s *, float_complex *, float_complex *);
+
+#endif
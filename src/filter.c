@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #undef	DEBUG
@@ -14,6 +15,25 @@
 #include <stdio.h>
 #endif
 
+/*
+ * Polyphase IIR Hilbert transformer (O. Niemitalo): coefficients of the
+ * all-pass sections of the I path (delayed by one more sample) and of
+ * the Q path.
+ */
+static const double IIR_COEF[2][IIR_SECTIONS] = {
+	{ 0.6923878, 0.9360654322959, 0.9882295226860, 0.9987488452737 },
+	{ 0.4021921162426, 0.8561710882420, 0.9722909545651, 0.9952884791278 }
+};
+
+struct allpass_s {
+	float a[2][IIR_SECTIONS];		/* squared coefficients */
+	float z[2][IIR_SECTIONS + 1][2];	/* section inputs and the output, n-1 and n-2 */
+	float d;				/* I path output of the sample before */
+	float b[2][5];				/* high and low pass: b0 b1 b2 a1 a2 */
+	float bs[2][2];				/* their states */
+	int band;
+};
+
 /*
  * Sinc done properly.
  */
@@ -44,11 +64,29 @@ static inline float hamming(float x)
 	return 0.54F - 0.46F * cosf(2.0F * (float)M_PI * x);
 }
 
+/*
+ * The lower corner frequency needs a filter length proportional to
+ * the sample rate. Rounded up to MAC_LANES, limited to FILTER_LEN_MAX.
+ */
+int filter_len(int samplerate)
+{
+	long len = ((long)FILTER_LEN_8K * samplerate + 7999) / 8000;
+
+	len = (len + MAC_LANES - 1) / MAC_LANES * MAC_LANES;
+	if (len < 2 * MAC_LANES)
+		len = 2 * MAC_LANES;
+	if (len > FILTER_LEN_MAX)
+		len = FILTER_LEN_MAX;
+
+	return (int)len;
+}
+
 /*
  * Create a band pass Hilbert transformer / filter with 6 dB corner
  * frequencies of 'f1' and 'f2'. (0 <= f1 < f2 <= 0.5)
+ * 'len' must be a multiple of MAC_LANES.
  */
-struct filter_s *init_filter(float f1, float f2)
+struct filter_s *init_filter(float f1, float f2, int len)
 {
 	struct filter_s *f;
 	float t, h, x;
@@ -57,9 +95,18 @@ struct filter_s *init_filter(float f1, float f2)
 	if ((f = calloc(1, sizeof(struct filter_s))) == NULL)
 		return NULL;
 
-	for (i = 0; i < FilterLen; i++) {
-		t = i - (FilterLen - 1) / 2.0F;
-		h = i * (1.0F / (FilterLen - 1.0F));
+	f->len = len;
+	f->ifilter = calloc(len, sizeof(float));
+	f->qfilter = calloc(len, sizeof(float));
+	f->hist = init_ring(len + FILTER_BLOCK, len, 1);
+	if (!f->ifilter || !f->qfilter || !f->hist) {
+		clear_filter(f);
+		return NULL;
+	}
+
+	for (i = 0; i < len; i++) {
+		t = i - (len - 1) / 2.0F;
+		h = i * (1.0F / (len - 1.0F));
 
 		x = (2 * f2 * sinc((2.0F * f2) * t) -
 		     2 * f1 * sinc((2.0F * f1) * t)) * hamming(h);
@@ -81,13 +128,217 @@ struct filter_s *init_filter(float f1, float f2)
 #endif
 	}
 
-	f->ptr = FilterLen;
+	return f;
+}
+
+/*
+ * Butterworth biquad (high pass or low pass) with the corner frequency 'f'
+ * as a fraction of the sample rate. Passes the input at f <= 0 or f >= 0.5.
+ */
+static void butterworth(float *b, float f, int highpass)
+{
+	double w, c, alpha, a0;
+
+	if (f <= 0.0F || f >= 0.5F) {
+		b[0] = 1.0F;
+		b[1] = b[2] = b[3] = b[4] = 0.0F;
+		return;
+	}
+
+	w = 2.0 * M_PI * f;
+	c = cos(w);
+	alpha = sin(w) / M_SQRT2;
+	a0 = 1.0 + alpha;
+
+	b[0] = (float)((highpass ? 1.0 + c : 1.0 - c) / 2.0 / a0);
+	b[1] = (float)((highpass ? -(1.0 + c) : 1.0 - c) / a0);
+	b[2] = b[0];
+	b[3] = (float)(-2.0 * c / a0);
+	b[4] = (float)((1.0 - alpha) / a0);
+}
+
+struct filter_s *init_filter_iir(float f1, float f2, int band)
+{
+	struct filter_s *f;
+	int p, k;
+
+	if ((f = calloc(1, sizeof(struct filter_s))) == NULL)
+		return NULL;
+	if ((f->iir = calloc(1, sizeof(struct allpass_s))) == NULL) {
+		clear_filter(f);
+		return NULL;
+	}
+
+	for (p = 0; p < 2; p++)
+		for (k = 0; k < IIR_SECTIONS; k++)
+			f->iir->a[p][k] = (float)(IIR_COEF[p][k] * IIR_COEF[p][k]);
+
+	f->iir->band = band;
+	butterworth(f->iir->b[0], f1, 1);
+	butterworth(f->iir->b[1], f2, 0);
 
 	return f;
 }
 
 void clear_filter(struct filter_s *f)
 {
+	free(f->iir);
+	free(f->ifilter);
+	free(f->qfilter);
+	if (f->hist)
+		clear_ring(f->hist);
 	free(f);
 }
 
+/*
+ * Both dot products in one pass over the history. MAC_LANES partial
+ * sums break the dependency chain, so the loop vectorizes.
+ */
+static inline float_complex mac2(const float *x, const float *a, const float *b, int len)
+{
+	float si[MAC_LANES], sq[MAC_LANES];
+	float sumi = 0.0F, sumq = 0.0F;
+	int i, k;
+
+	for (k = 0; k < MAC_LANES; k++)
+		si[k] = sq[k] = 0.0F;
+
+	for (i = 0; i < len; i += MAC_LANES) {
+		for (k = 0; k < MAC_LANES; k++) {
+			si[k] += x[i + k] * a[i + k];
+			sq[k] += x[i + k] * b[i + k];
+		}
+	}
+
+	for (k = 0; k < MAC_LANES; k++) {
+		sumi += si[k];
+		sumq += sq[k];
+	}
+
+	return make_float_complex(sumi, sumq);
+}
+
+/*
+ * The IIR Hilbert transformer: an optional band-pass, then two chains of
+ * allpass sections, 90 degrees apart. Each section:
+ * y(n) = a^2 * (x(n) + y(n-2)) - x(n-2). The state is kept in a local
+ * copy while the block is processed.
+ */
+static void allpass_block(struct allpass_s *iir, const float *in, float_complex *out,
+			  int n, float gain)
+{
+	struct allpass_s s = *iir;
+	float x, v, y, t;
+	int i, p, k;
+
+	for (i = 0; i < n; i++) {
+		x = in[i];
+		if (s.band) {
+			for (k = 0; k < 2; k++) {
+				t = s.b[k][0] * x + s.bs[k][0];
+				s.bs[k][0] = s.b[k][1] * x - s.b[k][3] * t + s.bs[k][1];
+				s.bs[k][1] = s.b[k][2] * x - s.b[k][4] * t;
+				x = t;
+			}
+		}
+
+		for (p = 0; p < 2; p++) {
+			v = x;
+			for (k = 0; k < IIR_SECTIONS; k++) {
+				y = s.a[p][k] * (v + s.z[p][k + 1][1]) - s.z[p][k][1];
+				s.z[p][k][1] = s.z[p][k][0];
+				s.z[p][k][0] = v;
+				v = y;
+			}
+			s.z[p][k][1] = s.z[p][k][0];
+			s.z[p][k][0] = v;
+		}
+
+		// the Q path lags the delayed I path by 90 degrees
+		out[i] = make_float_complex(s.d * gain, -s.z[1][IIR_SECTIONS][0] * gain);
+		s.d = s.z[0][IIR_SECTIONS][0];
+	}
+
+	*iir = s;
+}
+
+/*
+ * The output of a sample is computed from the 'len' samples before it.
+ * Up to FILTER_BLOCK new samples go to the history at once, then the
+ * dot products read it in place.
+ */
+void filter_block(struct filter_s *f, const float *in, float_complex *out,
+		  int n, float gain)
+{
+	float_complex y;
+	int c, i;
+
+	if (f->iir) {
+		allpass_block(f->iir, in, out, n, gain);
+		return;
+	}
+
+	for (; n > 0; n -= c, in += c, out += c) {
+		c = (n < FILTER_BLOCK) ? n : FILTER_BLOCK;
+		ring_write(f->hist, in, c);
+
+		for (i = 0; i < c; i++) {
+			y = mac2(ring_window(f->hist, f->len, c - i), f->ifilter, f->qfilter, f->len);
+			out[i] = make_float_complex(crealf(y) * gain, cimagf(y) * gain);
+		}
+	}
+}
+
+int filter_settle(const struct filter_s *f)
+{
+	const struct allpass_s *s = f->iir;
+	int p, k;
+
+	if (!s)
+		return f->len;
+
+	// a decaying state ends up as zero with flushed denormals
+	if (s->d != 0.0F || s->bs[0][0] != 0.0F || s->bs[0][1] != 0.0F ||
+	    s->bs[1][0] != 0.0F || s->bs[1][1] != 0.0F)
+		return -1;
+	for (p = 0; p < 2; p++)
+		for (k = 0; k <= IIR_SECTIONS; k++)
+			if (s->z[p][k][0] != 0.0F || s->z[p][k][1] != 0.0F)
+				return -1;
+
+	return 0;
+}
+
+void filter_zero(struct filter_s *f, int n)
+{
+	// a settled IIR state stays zero
+	if (!f->iir)
+		ring_zero(f->hist, n);
+}
+
+void filter_copy(struct filter_s *dst, const struct filter_s *src)
+{
+	if (dst->iir && src->iir) {
+		memcpy(dst->iir->z, src->iir->z, sizeof(dst->iir->z));
+		memcpy(dst->iir->bs, src->iir->bs, sizeof(dst->iir->bs));
+		dst->iir->d = src->iir->d;
+	} else if (dst->hist && src->hist) {
+		ring_copy(dst->hist, src->hist);
+	}
+}
+
+void filter_get_state(const struct filter_s *f, float *state)
+{
+	memcpy(state, f->iir->z, sizeof(f->iir->z));
+	state += 4 * (IIR_SECTIONS + 1);
+	*state++ = f->iir->d;
+	memcpy(state, f->iir->bs, sizeof(f->iir->bs));
+}
+
+void filter_set_state(struct filter_s *f, const float *state)
+{
+	memcpy(f->iir->z, state, sizeof(f->iir->z));
+	state += 4 * (IIR_SECTIONS + 1);
+	f->iir->d = *state++;
+	memcpy(f->iir->bs, state, sizeof(f->iir->bs));
+}
@@ -1,62 +1,71 @@
 #ifndef _FILTER_H
 #define _FILTER_H
 
-#define FilterLen	64
-#define BufferLen	1024
+#define FILTER_LEN_8K	64	/* Hilbert transformer length at 8000 sps */
+#define FILTER_LEN_MAX	1024	/* longest Hilbert transformer */
+#define FILTER_BLOCK	1024	/* samples written to the history at once */
+#define MAC_LANES	8	/* partial sums of the dot products */
+#define IIR_SECTIONS	4	/* all-pass sections per path of the IIR */
+
+#define FILTER_FIR	0	/* windowed FIR pair */
+#define FILTER_IIR	1	/* polyphase IIR all-pass network */
+#define FILTER_IIR_BAND	2	/* IIR with a band pass in front */
 
-#include <string.h>
 #include "cplx.h"
+#include "ring.h"
 
 /* ---------------------------------------------------------------------- */
 
 struct filter_s {
-	float ifilter[FilterLen];
-	float qfilter[FilterLen];
-	float ibuffer[BufferLen];
-	float qbuffer[BufferLen];
-	int ptr;
+	float *ifilter;		/* len coefficients each */
+	float *qfilter;
+	struct ring_s *hist;	/* input history, I and Q see the same input */
+	int len;		/* multiple of MAC_LANES */
+	struct allpass_s *iir;	/* IIR network instead, NULL for the FIR */
 };
 
 /* ---------------------------------------------------------------------- */
 
-extern struct filter_s *init_filter(float, float);
-extern void clear_filter(struct filter_s *);
+/* length for a sample rate: same transition widths in Hz as at 8000 sps */
+extern int filter_len(int samplerate);
 
-/* ---------------------------------------------------------------------- */
+extern struct filter_s *init_filter(float f1, float f2, int len);
+extern void clear_filter(struct filter_s *);
 
-static inline float mac(const float *a, const float *b)
-{
-	float sum = 0;
-	unsigned int i;
-
-	for (i = 0; i < FilterLen; i++)
-		sum += (*a++) * (*b++);
-	return sum;
-}
-
-static inline float_complex filter(struct filter_s *f, float_complex in)
-{
-        float *iptr = f->ibuffer + f->ptr;
-        float *qptr = f->qbuffer + f->ptr;
-        float_complex out;
-
-        *iptr = crealf(in);
-        *qptr = cimagf(in);
-
-        out = make_float_complex( mac(iptr - FilterLen, f->ifilter)
-                                , mac(qptr - FilterLen, f->qfilter));
-
-        f->ptr++;
-        if (f->ptr == BufferLen) {
-                iptr = f->ibuffer + BufferLen - FilterLen;
-                qptr = f->qbuffer + BufferLen - FilterLen;
-                memcpy(f->ibuffer, iptr, FilterLen * sizeof(float));
-                memcpy(f->qbuffer, qptr, FilterLen * sizeof(float));
-                f->ptr = FilterLen;
-        }
-
-        return out;
-}
+/*
+ * IIR alternative: two chains of first-order all-pass sections in z^-2,
+ * 90 degrees apart within +-0.7 degrees from 0.001 to 0.499 times the
+ * sample rate. 8 multiplies per sample and a few samples of delay in
+ * the middle of the band, but the delay grows towards the band edges
+ * (not linear phase). With 'band' set, biquads at 'f1' (high pass) and
+ * 'f2' (low pass) limit the input like the FIR does.
+ */
+extern struct filter_s *init_filter_iir(float f1, float f2, int band);
+
+/* analytic signal of the real in[], scaled by 'gain' */
+extern void filter_block(struct filter_s *, const float *in, float_complex *out,
+			 int n, float gain);
+
+/*
+ * Zero input samples after which the output is zero: 'len' for the FIR,
+ * 0 for an IIR that has decayed to zero, -1 for one that has not yet.
+ */
+extern int filter_settle(const struct filter_s *);
+
+/* history of 'n' zero samples, once the filter has settled */
+extern void filter_zero(struct filter_s *, int n);
+
+/* take over the state of 'src' if it is of the same kind */
+extern void filter_copy(struct filter_s *dst, const struct filter_s *src);
+
+/*
+ * The IIR network's state as FILTER_IIR_STATE floats, for snapshots.
+ * The FIR's state is its history ring.
+ */
+#define FILTER_IIR_STATE	(4 * (IIR_SECTIONS + 1) + 1 + 4)
+
+extern void filter_get_state(const struct filter_s *, float *state);
+extern void filter_set_state(struct filter_s *, const float *state);
 
 /* ---------------------------------------------------------------------- */
 
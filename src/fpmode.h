@@ -0,0 +1,64 @@
+#ifndef _FPMODE_H
+#define _FPMODE_H
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Denormals (flush to zero, denormal inputs taken as zero) while
+ * processing. Signal tails and silent gaps would otherwise end up in
+ * subnormal floats, which are very slow on x86. The caller's setting
+ * is restored, the floating point mode is per thread.
+ */
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HAVE_MXCSR
+#endif
+
+#if defined(HAVE_MXCSR)
+typedef unsigned int fpmode_t;
+
+static inline fpmode_t denormals_off(void)
+{
+	fpmode_t mode = _mm_getcsr();
+
+	_mm_setcsr(mode | 0x8040);	/* FTZ | DAZ */
+	return mode;
+}
+
+static inline void denormals_restore(fpmode_t mode)
+{
+	_mm_setcsr(mode);
+}
+#elif defined(__aarch64__) && defined(__GNUC__)
+typedef unsigned long fpmode_t;
+
+static inline fpmode_t denormals_off(void)
+{
+	fpmode_t mode;
+
+	__asm__ __volatile__("mrs %0, fpcr" : "=r"(mode));
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(mode | (1UL << 24)));	/* FZ */
+	return mode;
+}
+
+static inline void denormals_restore(fpmode_t mode)
+{
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+}
+#else
+typedef int fpmode_t;
+
+static inline fpmode_t denormals_off(void)
+{
+	return 0;
+}
+
+static inline void denormals_restore(fpmode_t mode)
+{
+	(void)mode;
+}
+#endif
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _FPMODE_H */
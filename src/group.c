@@ -0,0 +1,595 @@
+//----------------------------------------------------------------------------
+// Channel groups, see group.h.
+//
+// The kernel of channel.c, with each step run across the lanes: a loop
+// over the samples (or the filter taps) around a loop over GROUP_LANES
+// lanes, which the compiler vectorizes. The random number generators
+// draw in lockstep, the lanes take their numbers in the kernel's order:
+// the fading inputs at an update, then the noise of the segment, I
+// before Q. The shifters start with the same phase in every lane, so
+// their phasors are computed once, and the fading updates are due at
+// the same samples.
+//
+// The arithmetic is that of the kernel, operation by operation, down to
+// the partial sums of the Hilbert transformer. So a lane's output is
+// sample identical to that of its own channel. logf(), cosf() and
+// sinf() of the noise and fading inputs stay library calls, for the
+// same reason. tests/group.c compares the two for every channel type,
+// noise type and IQ setting: a change to the kernel has to be made here
+// too.
+//----------------------------------------------------------------------------
+
+#define _USE_MATH_DEFINES
+
+#include "group.h"
+#include "chansim.h"
+#include "filter.h"
+#include "noise.h"
+#include "fade.h"
+#include "delay.h"
+#include "rms.h"
+#include "nco.h"
+#include "fpmode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define L	GROUP_LANES
+
+struct chan_group_s *init_group(const struct chan_parms_s *p)
+{
+	struct chan_group_s *g;
+	struct chan_parms_s q;
+	struct channel_s *c;
+	int iq = (p->iq != 0);
+	int k, l;
+
+	if (!iq && p->hilbert != FILTER_FIR)
+		return NULL;
+	if ((g = calloc(1, sizeof(struct chan_group_s))) == NULL)
+		return NULL;
+	g->parms = *p;
+	if ((g->ch = init_channel_shared(p)) == NULL) {
+		free(g);
+		return NULL;
+	}
+
+	// The channel of each lane, set up as usual, hands over its random
+	// numbers and its primed fading filters
+	for (l = 0; l < L; l++) {
+		q = *p;
+		q.seed = p->seed + l;
+		if ((c = l ? init_channel_shared(&q) : g->ch) == NULL) {
+			clear_group(g);
+			return NULL;
+		}
+		for (k = 0; k < 31; k++) {
+			g->rng[0][k][l] = c->rng.state[k];
+			g->rng[1][k][l] = c->rngq.state[k];
+		}
+		if (c->fade) {
+			for (k = 0; k < 6; k++) {
+				g->fade[0][k][l] = c->fade->IFade0[k];
+				g->fade[1][k][l] = c->fade->QFade0[k];
+				g->fade[2][k][l] = c->fade->IFade1[k];
+				g->fade[3][k][l] = c->fade->QFade1[k];
+			}
+		}
+		g->fade0[0][l] = crealf(c->fade0);
+		g->fade0[1][l] = cimagf(c->fade0);
+		g->fade1[0][l] = crealf(c->fade1);
+		g->fade1[1][l] = cimagf(c->fade1);
+		if (l)
+			clear_channel(c);
+	}
+	g->f[0] = g->ch->rng.f;
+	g->r[0] = g->ch->rng.r;
+	g->f[1] = g->ch->rngq.f;
+	g->r[1] = g->ch->rngq.r;
+
+	// The histories, one element per sample holds all lanes
+	if (g->ch->filter) {
+		g->flen = g->ch->filter->len;
+		if ((g->hist = init_ring(g->flen + CHAN_BLOCK, g->flen, L)) == NULL) {
+			clear_group(g);
+			return NULL;
+		}
+	}
+	if (g->ch->delay) {
+		g->taps = g->ch->delay->taps;
+		for (k = 0; k < 2; k++) {
+			if ((g->line[k] = init_ring(g->taps + CHAN_BLOCK, CHAN_BLOCK, L)) == NULL) {
+				clear_group(g);
+				return NULL;
+			}
+		}
+	}
+	if (g->ch->rms) {
+		g->rlen = g->ch->rms->len;
+		if ((g->win = init_ring(g->rlen + CHAN_BLOCK, g->rlen, (iq + 1) * L)) == NULL) {
+			clear_group(g);
+			return NULL;
+		}
+	}
+
+	return g;
+}
+
+void clear_group(struct chan_group_s *g)
+{
+	if (g->ch)
+		clear_channel(g->ch);
+	if (g->hist)
+		clear_ring(g->hist);
+	if (g->line[0])
+		clear_ring(g->line[0]);
+	if (g->line[1])
+		clear_ring(g->line[1]);
+	if (g->win)
+		clear_ring(g->win);
+	free(g);
+}
+
+//----------------------------------------------------------------------------
+// 'rows' random numbers per lane, as RNG() of each lane's generator 'q'
+// (0 = rng, 1 = rngq).
+//----------------------------------------------------------------------------
+static void rng_lanes(struct chan_group_s *g, int q, float *u, int rows)
+{
+	uint32_t *a;
+	const uint32_t *b;
+	int k, l;
+
+	for (k = 0; k < rows; k++, u += L) {
+		a = g->rng[q][g->f[q]];
+		b = g->rng[q][g->r[q]];
+		for (l = 0; l < L; l++) {
+			a[l] += b[l];
+			u[l] = (float)(int32_t)(a[l] >> 1) / RNG_MAX;
+		}
+		if (++g->f[q] >= 31)
+			g->f[q] = 0;
+		if (++g->r[q] >= 31)
+			g->r[q] = 0;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Hilbert transformer, as filter_block() with mac2(): MAC_LANES partial
+// sums, each over every MAC_LANES-th tap, added up in order.
+//----------------------------------------------------------------------------
+static void hilbert_lanes(struct chan_group_s *g, struct group_work_s *w, const float *in, int n)
+{
+	const float *a = g->ch->filter->ifilter;
+	const float *b = g->ch->filter->qfilter;
+	const float gain = 1.0F / (float)M_SQRT2;
+	const int len = g->flen;
+	float si[L], sq[L], yi[L], yq[L];
+	const float *xi, *xj;
+	int i, j, k, l;
+
+	ring_write(g->hist, in, n);
+
+	for (i = 0; i < n; i++) {
+		// the 'len' samples before sample i
+		xi = ring_window(g->hist, len, n - i);
+		for (l = 0; l < L; l++)
+			yi[l] = yq[l] = 0.0F;
+		for (k = 0; k < MAC_LANES; k++) {
+			for (l = 0; l < L; l++)
+				si[l] = sq[l] = 0.0F;
+			for (j = k; j < len; j += MAC_LANES) {
+				xj = xi + j * L;
+				for (l = 0; l < L; l++) {
+					si[l] += xj[l] * a[j];
+					sq[l] += xj[l] * b[j];
+				}
+			}
+			for (l = 0; l < L; l++) {
+				yi[l] += si[l];
+				yq[l] += sq[l];
+			}
+		}
+		for (l = 0; l < L; l++) {
+			w->sig[0][i * L + l] = yi[l] * gain;
+			w->sig[1][i * L + l] = yq[l] * gain;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Frequency shift: the phasors of nco_mix(), applied to every lane.
+//----------------------------------------------------------------------------
+static void mix_lanes(struct nco_s *nco, struct group_work_s *w, float *re, float *im, int n)
+{
+	float x, y, pr, pi;
+	int i, l;
+
+	for (i = 0; i < n; i++)
+		w->phasor[i] = make_float_complex(1.0F, 0.0F);
+	nco_mix(nco, w->phasor, n);
+
+	for (i = 0; i < n; i++, re += L, im += L) {
+		pr = crealf(w->phasor[i]);
+		pi = cimagf(w->phasor[i]);
+		for (l = 0; l < L; l++) {
+			x = re[l];
+			y = im[l];
+			re[l] = x * pr - y * pi;
+			im[l] = x * pi + y * pr;
+		}
+	}
+}
+
+static void delay_lanes(struct chan_group_s *g, struct group_work_s *w, int n)
+{
+	int k;
+
+	for (k = 0; k < 2; k++) {
+		ring_write(g->line[k], w->sig[k], n);
+		memcpy(w->dsig[k], ring_window(g->line[k], n, g->taps), n * L * sizeof(float));
+	}
+}
+
+//----------------------------------------------------------------------------
+// Input RMS, as rms_block() or rms_block_iq(): over the window ending
+// with the sample at which an update is due.
+//----------------------------------------------------------------------------
+static void rms_lanes(struct chan_group_s *g, float *rmsval, const float *in, int n, int iq)
+{
+	const int len = g->rlen;
+	const int width = (iq + 1) * L;
+	float sum[L], pwr[L], avg, var;
+	const float *x, *bi;
+	int i, j, l;
+
+	ring_write(g->win, in, n);
+
+	for (i = 0; i < n; i++, rmsval += L) {
+		if (g->counter++ == g->ch->rms->interval) {
+			for (l = 0; l < L; l++)
+				sum[l] = pwr[l] = 0.0F;
+			// the window ending with sample i
+			x = ring_window(g->win, len, n - 1 - i);
+			for (j = 0; j < len; j++) {
+				bi = x + j * width;
+				if (iq) {
+					for (l = 0; l < L; l++) {
+						pwr[l] += bi[2 * l] * bi[2 * l];
+						pwr[l] += bi[2 * l + 1] * bi[2 * l + 1];
+					}
+				} else {
+					for (l = 0; l < L; l++) {
+						sum[l] += bi[l];
+						pwr[l] += bi[l] * bi[l];
+					}
+				}
+			}
+			for (l = 0; l < L; l++) {
+				if (iq) {
+					g->rms[l] = sqrtf(pwr[l] / len);
+				} else {
+					avg = sum[l] / len;
+					var = pwr[l] / len - avg * avg;
+					g->rms[l] = (var > 0.0F) ? sqrtf(var) : 0.0F;
+				}
+			}
+			g->counter = 0;
+		}
+		memcpy(rmsval, g->rms, sizeof(g->rms));
+	}
+}
+
+//----------------------------------------------------------------------------
+// Fading gains, as FadeGains(): Rayleigh inputs of both paths, then the
+// Gaussian filters.
+//----------------------------------------------------------------------------
+static void fade_lanes(struct chan_group_s *g, struct group_work_s *w)
+{
+	const struct fade_s *f = g->ch->fade;
+	const float *u = w->u;
+	float rxx, z, *F;
+	int p, k, l;
+
+	rng_lanes(g, 0, w->u, 4);
+	for (p = 0; p < 2; p++, u += 2 * L) {
+		for (l = 0; l < L; l++) {
+			rxx = sqrtf(-2.0F * logf(u[l]));
+			z = 2.0F * (float)M_PI * u[L + l];
+			g->fade[2 * p][3][l] = rxx * cosf(z);
+			g->fade[2 * p + 1][3][l] = rxx * sinf(z);
+		}
+	}
+
+	for (k = 0; k < 4; k++) {
+		F = g->fade[k][0];
+		for (l = 0; l < L; l++) {
+			F[l] = (f->g * (F[3 * L + l] + 2 * F[4 * L + l] + F[5 * L + l]) -
+				f->a1 * F[L + l] - f->a2 * F[2 * L + l]) / f->a0;
+			F[2 * L + l] = F[L + l];
+			F[L + l] = F[l];
+			F[5 * L + l] = F[4 * L + l];
+			F[4 * L + l] = F[3 * L + l];
+		}
+	}
+
+	for (l = 0; l < L; l++) {
+		g->fade0[0][l] = g->fade[0][0][l];
+		g->fade0[1][l] = g->fade[1][0][l];
+		g->fade1[0][l] = g->fade[2][0][l];
+		g->fade1[1][l] = g->fade[3][0][l];
+	}
+}
+
+//----------------------------------------------------------------------------
+// Band limited noise, as BandLtdNoiseBlock(): 'n' samples of the noise
+// generator 'q' (0 = I, 1 = Q).
+//----------------------------------------------------------------------------
+static void noise_lanes(struct chan_group_s *g, struct group_work_s *w, int q,
+			float *out, int n)
+{
+	const struct noise_s *ns = q ? g->ch->noiseq : g->ch->noise;
+	const float *u = w->u;
+	float xv[3][L], yv[3][L];
+	float z;
+	int i, l;
+
+	rng_lanes(g, q, w->u, (ns->noisetype == 0) ? 2 * n : n);
+
+	// the unfiltered noise, as noise_shape_one()
+	switch (ns->noisetype) {
+	default:
+	case 0:
+		for (i = 0; i < n; i++, u += 2 * L) {
+			for (l = 0; l < L; l++) {
+				z = sqrtf(-2.0F * logf(u[l]));
+				z *= cosf(2.0F * (float)M_PI * u[L + l]);
+				out[i * L + l] = z;
+			}
+		}
+		break;
+	case 1:
+		for (i = 0; i < n * L; i++) {
+			z = u[i];
+			if (z < 0.5F)
+				z = logf(2.0F * z) / (float)M_SQRT2;
+			else
+				z = -logf(2.0F * (1.0F - z)) / (float)M_SQRT2;
+			out[i] = z;
+		}
+		break;
+	case 2:
+		for (i = 0; i < n * L; i++) {
+			z = (float)(-M_SQRT2) * logf(u[i]);
+			out[i] = (fabsf(z) <= 8.0F) ? 0.0F : z;
+		}
+		break;
+	}
+
+	// the Butterworth filters of noisefilter()
+	memcpy(xv, g->nxv[q], sizeof(xv));
+	memcpy(yv, g->nyv[q], sizeof(yv));
+	for (i = 0; i < n; i++, out += L) {
+		for (l = 0; l < L; l++) {
+			xv[0][l] = xv[1][l];
+			xv[1][l] = xv[2][l];
+			xv[2][l] = out[l] / ns->bn0;
+			yv[0][l] = yv[1][l];
+			yv[1][l] = yv[2][l];
+			yv[2][l] = ns->an0 * xv[2][l] +
+				   ns->an1 * xv[1][l] +
+				   ns->an2 * xv[0][l] -
+				   ns->bn1 * yv[1][l] -
+				   ns->bn2 * yv[0][l];
+			out[l] = yv[2][l] * ns->BGG;
+		}
+	}
+	memcpy(g->nxv[q], xv, sizeof(xv));
+	memcpy(g->nyv[q], yv, sizeof(yv));
+}
+
+//----------------------------------------------------------------------------
+// One block of up to CHAN_BLOCK samples, the steps of simprocess().
+//----------------------------------------------------------------------------
+static void group_block(struct chan_group_s *g, struct group_work_s *w,
+			const float *in, float *out, int size)
+{
+	struct channel_s *ch = g->ch;
+	const int iq = (g->parms.iq != 0);
+	const int multipath = (g->line[0] != NULL);
+	const int fading = (ch->fade != NULL);
+	const int autorms = (g->win != NULL);
+	const float amplitude = g->parms.amplitude;
+	const float SigLvl = ch->SigLvl;
+	const float *sr = w->sig[0], *si = w->sig[1];
+	const float *dr = w->dsig[0], *di = w->dsig[1];
+	const float *nbuf = w->nbuf[0], *nbufq = w->nbuf[1];
+	float f0r, f0i, f1r, f1i, y, yq, ampl;
+	int i, k, l, n;
+
+	// Analytic signal, frequency shifts and the delayed path
+	if (iq) {
+		for (i = 0; i < size * L; i++) {
+			w->sig[0][i] = in[2 * i];
+			w->sig[1][i] = in[2 * i + 1];
+		}
+	} else {
+		hilbert_lanes(g, w, in, size);
+	}
+	if (ch->offset)
+		mix_lanes(ch->offset, w, w->sig[0], w->sig[1], size);
+	if (multipath) {
+		delay_lanes(g, w, size);
+		if (ch->delayed)
+			mix_lanes(ch->delayed, w, w->dsig[0], w->dsig[1], size);
+	}
+	if (ch->direct)
+		mix_lanes(ch->direct, w, w->sig[0], w->sig[1], size);
+
+	if (autorms)
+		rms_lanes(g, w->rmsval, in, size, iq);
+
+	// Segments of constant fading gains
+	for (i = 0; i < size; i += n) {
+		n = size - i;
+		if (fading) {
+			if (ch->pointsleft <= 0) {
+				fade_lanes(g, w);
+				ch->pointsleft = (ch->parms.samplerate + ch->updrem) / ch->TapUpdRate;
+				ch->updrem = (ch->parms.samplerate + ch->updrem) % ch->TapUpdRate;
+			}
+			if (n > ch->pointsleft)
+				n = ch->pointsleft;
+			ch->pointsleft -= n;
+		}
+
+		noise_lanes(g, w, 0, w->nbuf[0] + i * L, n);
+		if (iq)
+			noise_lanes(g, w, 1, w->nbuf[1] + i * L, n);
+
+		for (k = i * L; k < (i + n) * L; k += L) {
+			for (l = 0; l < L; l++) {
+				f0r = g->fade0[0][l];
+				f0i = g->fade0[1][l];
+				f1r = g->fade1[0][l];
+				f1i = g->fade1[1][l];
+				ampl = (autorms ? w->rmsval[k + l] : amplitude) / SigLvl;
+
+				if (iq) {
+					if (multipath) {
+						y = ((sr[k + l] * f0r - si[k + l] * f0i)
+						  + (dr[k + l] * f1r - di[k + l] * f1i)) * (float)M_SQRT1_2;
+						yq = ((sr[k + l] * f0i + si[k + l] * f0r)
+						   + (dr[k + l] * f1i + di[k + l] * f1r)) * (float)M_SQRT1_2;
+					} else {
+						y = sr[k + l] * f0r - si[k + l] * f0i;
+						yq = sr[k + l] * f0i + si[k + l] * f0r;
+					}
+					ampl *= (float)M_SQRT1_2;
+					out[2 * (k + l)] = y + nbuf[k + l] * ampl;
+					out[2 * (k + l) + 1] = yq + nbufq[k + l] * ampl;
+					continue;
+				}
+
+				if (multipath)
+					y = (sr[k + l] * f0r - si[k + l] * f0i)
+					  + (dr[k + l] * f1r - di[k + l] * f1i);
+				else
+					y = (sr[k + l] * f0r - si[k + l] * f0i) * (float)M_SQRT2;
+				out[k + l] = y + nbuf[k + l] * ampl;
+			}
+		}
+	}
+
+	ch->samples += size;
+}
+
+void group_process(struct chan_group_s *g, struct group_work_s *w,
+		   const float *in, float *out, int len)
+{
+	fpmode_t mode = denormals_off();
+	int step = (g->parms.iq ? 2 : 1) * L;
+	int n;
+
+	while (len > 0) {
+		n = (len < CHAN_BLOCK) ? len : CHAN_BLOCK;
+		group_block(g, w, in, out, n);
+		in += n * step;
+		out += n * step;
+		len -= n;
+	}
+
+	denormals_restore(mode);
+}
+
+//----------------------------------------------------------------------------
+// Group mode. Channel c is lane c % GROUP_LANES of group c / GROUP_LANES;
+// the lanes of the last group past the channels process silence.
+//----------------------------------------------------------------------------
+int run_group(int channels, const struct chan_parms_s *defaults, float gain)
+{
+	const int w = defaults->iq ? 2 : 1;
+	const int groups = (channels + L - 1) / L;
+	struct chan_group_s **grp;
+	struct group_work_s *work;
+	struct chan_parms_s p;
+	int16_t *pcm;
+	float *buf, x;
+	int i, k, l, c, n, ch, clipped;
+
+	grp = calloc(groups, sizeof(struct chan_group_s *));
+	pcm = malloc((size_t)CHAN_BLOCK * channels * w * sizeof(int16_t));
+	buf = malloc(CHAN_BLOCK * L * w * sizeof(float));
+	work = malloc(sizeof(struct group_work_s));
+	if (!grp || !pcm || !buf || !work) {
+		fprintf(stderr, "chansim: out of memory\n");
+		return -1;
+	}
+
+	for (k = 0; k < groups; k++) {
+		p = *defaults;
+		p.seed = defaults->seed + k * L;
+		p.amplitude *= gain;
+		if ((grp[k] = init_group(&p)) == NULL) {
+			fprintf(stderr, "chansim: channel initialization failed\n");
+			return -1;
+		}
+	}
+
+	fprintf(stderr, "Groups: %d channels in %d group(s) of %d, seeds %u to %u\n",
+		channels, groups, L, defaults->seed, defaults->seed + channels - 1);
+
+	do {
+		n = (int)fread(pcm, channels * w * sizeof(int16_t), CHAN_BLOCK, stdin);
+		clipped = 0;
+
+		for (k = 0; k < groups; k++) {
+			for (i = 0; i < n; i++) {
+				for (l = 0; l < L; l++) {
+					ch = k * L + l;
+					for (c = 0; c < w; c++)
+						buf[(i * L + l) * w + c] = (ch < channels) ?
+							pcm[(i * channels + ch) * w + c] * gain / 32768.0F : 0.0F;
+				}
+			}
+
+			group_process(grp[k], work, buf, buf, n);
+
+			for (i = 0; i < n; i++) {
+				for (l = 0; l < L && k * L + l < channels; l++) {
+					ch = k * L + l;
+					for (c = 0; c < w; c++) {
+						x = buf[(i * L + l) * w + c];
+						if (x > 0.999F || x < -0.999F) {
+							x = (x > 0.0F) ? 0.999F : -0.999F;
+							clipped++;
+						}
+						pcm[(i * channels + ch) * w + c] = (int16_t)(x * 32768.0F);
+					}
+				}
+			}
+		}
+		if (clipped)
+			fprintf(stderr, "chansim: clipping! (%d samples)\n", clipped);
+
+		if (n > 0 && fwrite(pcm, channels * w * sizeof(int16_t), n, stdout) != (size_t)n) {
+			fprintf(stderr, "chansim: write error\n");
+			return -1;
+		}
+	} while (n == CHAN_BLOCK);
+
+	if (ferror(stdin))
+		perror("chansim: stdin");
+	fflush(stdout);
+	for (k = 0; k < groups; k++)
+		clear_group(grp[k]);
+	free(grp);
+	free(pcm);
+	free(buf);
+	free(work);
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef _GROUP_H
+#define _GROUP_H
+
+#include "channel.h"
+#include "ring.h"
+
+#define GROUP_LANES	8	/* channels per group, one per vector lane */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * A group of GROUP_LANES channels with the same settings but their own
+ * seeds, lane l seeded with parms.seed + l. The lanes run in lockstep:
+ * every state is an array over the lanes, so the sample loops, even
+ * those of the recursive noise and fading filters, run across the lanes
+ * and vectorize. Each lane's output is the same as that of a channel
+ * of its own with the lane's seed.
+ *
+ * Arrays of [..][GROUP_LANES] are the lanes' states. The histories are
+ * rings (ring.h) with the lanes of a sample as one element, read in
+ * place like those of the channel.
+ */
+struct chan_group_s {
+	struct chan_parms_s parms;	/* of lane 0 */
+	struct channel_s *ch;		/* lane 0: coefficients, shifters, fading updates */
+
+	uint32_t rng[2][31][GROUP_LANES];	/* random number generators, see rng_s, */
+	int f[2], r[2];			/* and those of the quadrature noise */
+	float nxv[2][3][GROUP_LANES];	/* noise filters, I and Q */
+	float nyv[2][3][GROUP_LANES];
+	float fade[4][6][GROUP_LANES];	/* I and Q fading filters of both paths */
+	float fade0[2][GROUP_LANES];	/* current fading gains, real and imaginary */
+	float fade1[2][GROUP_LANES];
+
+	struct ring_s *hist;		/* Hilbert transformer input, NULL in IQ mode */
+	struct ring_s *line[2];		/* delay line, I and Q, NULL for flat channels */
+	struct ring_s *win;		/* RMS window (I/Q pairs in IQ mode), NULL if amplitude given */
+	float rms[GROUP_LANES];
+	int counter;
+	int flen, taps, rlen;		/* history lengths */
+};
+
+/*
+ * Scratch buffers, [sample][GROUP_LANES]. Like chan_work_s, groups
+ * processed by the same thread may share one.
+ */
+struct group_work_s {
+	float sig[2][CHAN_BLOCK * GROUP_LANES];
+	float dsig[2][CHAN_BLOCK * GROUP_LANES];
+	float nbuf[2][CHAN_BLOCK * GROUP_LANES];
+	float rmsval[CHAN_BLOCK * GROUP_LANES];
+	float u[2 * CHAN_BLOCK * GROUP_LANES];	/* uniform random numbers */
+	float_complex phasor[CHAN_BLOCK];
+};
+
+/* ---------------------------------------------------------------------- */
+
+/* NULL on errors, and for IIR Hilbert transformers (FIR only) */
+extern struct chan_group_s *init_group(const struct chan_parms_s *);
+extern void clear_group(struct chan_group_s *);
+
+/*
+ * Process 'len' samples of each lane. 'in' and 'out' hold the lanes
+ * interleaved, [sample][GROUP_LANES], or [sample][GROUP_LANES][2] with
+ * I/Q pairs in IQ mode. 'out' may be the same as 'in'.
+ */
+extern void group_process(struct chan_group_s *, struct group_work_s *,
+			  const float *in, float *out, int len);
+
+/*
+ * Group mode: stdin holds 'channels' interleaved 16 bit channels (I/Q
+ * pairs in IQ mode), each simulated with 'defaults' and the seed plus
+ * its index, in groups. The outputs go to stdout interleaved the same
+ * way. 'gain' scales the inputs, as -g. Returns nonzero on errors.
+ */
+extern int run_group(int channels, const struct chan_parms_s *defaults, float gain);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _GROUP_H */
@@ -85,20 +85,100 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include <math.h>
 
-#ifdef USE_SOUND
+#ifndef WIN32
 #include <unistd.h>
+#endif
+#ifdef USE_SOUND
 #include <sys/ioctl.h>
 #include <sys/soundcard.h>
 #endif
 #include <fcntl.h>
 #include <time.h>
+#include <errno.h>
+#include <signal.h>
 
 #include "chansim.h"
+#include "channel.h"
+#include "nco.h"
 #include "filter.h"
-#include "rms.h"
-#include "noise.h"
+#ifdef USE_FIXED_POINT
+#include "channel_fx.h"
+#endif
+#ifdef USE_DAEMON
+#include "daemon.h"
+#endif
+#ifdef USE_WIDEBAND
+#include "wideband.h"
+#endif
+#ifdef USE_TEE
+#include "tee.h"
+#endif
+#ifdef USE_MIX
+#include "mix.h"
+#endif
+#ifdef USE_CHUNKS
+#include "chunk.h"
+#endif
+#if defined(USE_SHM) && !defined(USE_FIXED_POINT)
+#include "shmring.h"
+#else
+#undef USE_SHM
+#endif
+#if defined(USE_TRACE) && !defined(USE_FIXED_POINT)
+#include "trace.h"
+#else
+#undef USE_TRACE
+#endif
+#if defined(USE_PIPELINE) && !defined(USE_FIXED_POINT)
+#include "pipeline.h"
+#else
+#undef USE_PIPELINE
+#endif
+#if defined(USE_MONITOR) && !defined(USE_FIXED_POINT)
+#include "monitor.h"
+#else
+#undef USE_MONITOR
+#endif
+
+// Live reconfiguration needs a float channel and POSIX FIFOs
+#if !defined(WIN32) && !defined(USE_FIXED_POINT)
+#define USE_CONTROL
+#include "control.h"
+#endif
+
+// Snapshots of the float channel
+#ifndef USE_FIXED_POINT
+#define USE_SNAPSHOT
+#include "snapshot.h"
+#endif
+
+// Interference of the float channel
+#ifndef USE_FIXED_POINT
+#define USE_QRM
+#include "qrm.h"
+#endif
+
+// Scenario timelines of the float channel
+#ifndef USE_FIXED_POINT
+#define USE_SCENARIO
+#include "scenario.h"
+#endif
+
+// Groups of float channels processed in vector lanes
+#ifndef USE_FIXED_POINT
+#define USE_GROUP
+#include "group.h"
+#endif
+
+// Sample clock offset and drift of the float channel's output
+#ifndef USE_FIXED_POINT
+#define USE_SKEW
+#include "skew.h"
+#endif
 
 
 #ifdef WIN32
@@ -127,49 +207,124 @@ void usleep(unsigned int usec)
 // Audio I/O definitions
 //----------------------------------------------------------------------------
 #define BUF_SIZE	512		// "chunk" size
+#define MAX_SNRS	32		// outputs at different SNRs
+
+#ifdef USE_SKEW
+#if BUF_SIZE > SKEW_BLOCK
+#error "skew_process() takes SKEW_BLOCK frames at most, BUF_SIZE is larger"
+#endif
+#define OUT_SIZE	SKEW_OUT(BUF_SIZE)	// output samples per block at most
+#else
+#define OUT_SIZE	BUF_SIZE
+#endif
 
 #ifdef USE_SOUND
 #define DEVICE		"/dev/dsp"
 #endif
-int16_t audio_buf_in[BUF_SIZE];
-int16_t audio_buf_out[BUF_SIZE];
-int size_in = 0;
+int16_t audio_buf_in[2 * BUF_SIZE];	// I/Q pairs in IQ mode
+int16_t audio_buf_out[2 * OUT_SIZE * MAX_SNRS];	// interleaved outputs
+int size_in = 0;			// samples, or I/Q pairs in IQ mode
 int size_out = 0;
+int IQMode = 0;				// complex baseband, two values per sample
+int Hilbert = FILTER_FIR;		// kind of Hilbert transformer
+float Snrs[MAX_SNRS];			// one output per SNR
+int NumSnrs = 1;
 
 //----------------------------------------------------------------------------
 // Test NCO work definitions
 //----------------------------------------------------------------------------
 float NCOFreq =		1800.0F;	// default NCO frequency
 #define NCO_GAIN	2500.0F		// sets default NCO gain to not overdrive
-float phase_accum =	0.0F;
-float delta;
 
 //----------------------------------------------------------------------------
 // Simulator definitions and memory assignments
 //----------------------------------------------------------------------------
-#define DIRECT		1.0F	// These describe how to combine
-#define DELAYED		1.0F	// direct and delayed paths
-
 int SampleRate =	8000;	// 8000 samples per second
 float ChannelBW	=	3000.0F;	// 3 kHz channel (used in noise shaping)
 float FreqOffset =	0.0F;	// Default frequency offset
+float FreqDrift =	0.0F;	// Linear drift of the offset in Hz/s
+float DopplerDirect =	0.0F;	// Doppler shift of the direct path
+float DopplerDelayed =	0.0F;	// Doppler shift of the delayed path
 float Amplitude = 	0.0F;	// Signal amplitude (RMS). Zero means
 				// compute at runtime
 float InputGain =	1.0F;	// The input signal is scaled with this
-float DelTime;			// Time difference between two paths
-float SigLvl;			// Signal level for given SNR
-float FrSpread;			// Frequency (doppler) spread
-int TapUpdRate;			// Update rate for the fading gain params
+float Duration =	0.0F;	// Seconds of output, 0 = until the input ends
+int Pace =		0;	// Write the output in real time
+#ifdef USE_CONTROL
+const char *ControlPath = NULL;	// FIFO for live reconfiguration
+struct control_s *Control;
+struct chan_settings_s Settings;	// current settings of Channel
+#endif
+#ifdef USE_DAEMON
+const char *ListenAddr = NULL;	// Serve client streams on this socket
+#endif
+#ifdef USE_WIDEBAND
+int Subchannels =	0;	// Wideband mode with this many sub-channels
+const char *SubchannelMap = NULL;	// Settings of single sub-channels
+#endif
+#ifdef USE_TEE
+const char *TeePath = NULL;	// Outputs and their settings in tee mode
+#endif
+#ifdef USE_MIX
+const char *MixPath = NULL;	// Transmitters and their settings in mix mode
+#endif
+#ifdef USE_CHUNKS
+float ChunkSeconds =	0.0F;	// Chunk mode with chunks this long
+#endif
+#ifdef USE_GROUP
+int GroupChannels =	0;	// Group mode with this many interleaved channels
+#endif
+#ifdef USE_SKEW
+double SkewPpm =	0.0;	// Output sample clock offset in ppm
+double SkewDrift =	0.0;	// and its drift in ppm per hour
+struct skew_s *Skew;
+#endif
+#ifdef USE_TRACE
+const char *TracePath = NULL;	// Channel state export
+struct trace_s *Trace;
+#endif
+#ifdef USE_PIPELINE
+int Pipelined =		0;	// Noise and fading on worker threads
+struct pipeline_s *Pipeline;
+#endif
+#ifdef USE_MONITOR
+const char *MonitorPath = NULL;	// Spectrum and fading monitor snapshots
+struct monitor_s *Monitor;
+#endif
+#ifdef USE_SNAPSHOT
+const char *SnapshotPath = NULL;	// Save the channel state here
+const char *ResumePath = NULL;	// Start from this snapshot
+volatile sig_atomic_t Stop = 0;	// SIGINT or SIGTERM: save and end
+#endif
+#ifdef USE_QRM
+const char *QrmPath = NULL;	// Interferers, one per line
+struct qrm_s *Qrm;
+#endif
+#ifdef USE_SCENARIO
+const char *ScenarioPath = NULL;	// Timeline of channel settings
+struct scenario_s *Scenario;
+#endif
+#ifdef USE_SHM
+const char *ShmName = NULL;	// Shared-memory ring instead of stdout
+struct shm_ring_s *Shm;
+#endif
+#if defined(USE_DAEMON) || defined(USE_WIDEBAND) || defined(USE_TEE) || defined(USE_MIX) || defined(USE_CHUNKS)
+int Workers =		2;	// Processing threads of the daemon, wideband, tee, mix or chunk mode
+#endif
 
-struct filter_s *Filter;	// Struct for the Hilbert transformer
-struct rms_s *RootMeanSqr;	// Struct for RMS calculations
-struct noise_s *Noise;		// Struct for Noise generation
+#ifdef USE_FIXED_POINT
+struct channel_fx_s *Channel;	// The simulated HF channel, fixed-point
+struct nco_fx_s TestNCO;	// Internal test signal oscillator
+#else
+struct channel_s *Channel;	// The simulated HF channel
+struct nco_s *TestNCO;		// Internal test signal oscillator
+#endif
 
 //------------------------------------------------------------------
 // Usage stuff
 //------------------------------------------------------------------
 static const char *UsageString = 
-"Usage: chansim [-a <ampl>] [-b <bw>] [-f <nco>] [-g <gain>] [-i <IO type>] [-n <noise type>] [-o <offset>] [-r <seed>] [-s <samplerate>] <SNR> <format>\n"
+"Usage: chansim [-a <ampl>] [-b <bw>] [-B <subchannels>] [-C <fifo>] [-d <drift>] [-e <file>] [-f <nco>] [-g <gain>] [-H <hilbert>] [-i <IO type>] [-I <file>] [-j] [-k <seconds>] [-K <channels>] [-l <socket>] [-L <file>] [-m <mapfile>] [-M <file>] [-n <noise type>] [-o <offset>] [-O <name>] [-p <doppler>] [-P <doppler>] [-q] [-r <seed>] [-s <samplerate>] [-S <file>] [-t <seconds>] [-T <teefile>] [-u <ppm>] [-U <ppm/h>] [-w <workers>] [-x] [-X <mixfile>] [-Z <scenario>] <SNR> <format>\n"
 "Type 'chansim -h' for more information.\n";
 
 static const char *HelpString =
@@ -181,6 +336,9 @@ static const char *HelpString =
 "\n"
 "Arguments:\n"
 "    <SNR dB>          Signal to noise ratio (option -R on Windows).\n"
+"                      A list <a>,<b>,... or <from>:<step>:<to> gives\n"
+"                      one output per SNR in one pass, interleaved like\n"
+"                      the channels of multichannel PCM (max 32).\n"
 "    <format>          HF channel type. (Path delay / Doppler spread)\n"
 "                         (option -c on Windows)\n"
 "                      0 - Noise only           (  ---  /   --- )\n"
@@ -191,32 +349,154 @@ static const char *HelpString =
 "                      5 - CCIR poor            (2.0 ms /   1 Hz)\n"
 "                      6 - CCIR flutter fading  (0.5 ms /  10 Hz)\n"
 "                      7 - Extreme              (2.0 ms /   5 Hz)\n"
-"\n"
+"\n";
+
+// separate, C99 limits the length of a string literal
+static const char *HelpOptions =
 "Options:\n"
 "    -a <ampl>         Set the RMS amplitude of the incoming signal.\n"
 "                      Allowed range 0...1. Default is to calculate\n"
 "                      it at runtime.\n"
 "    -b <bw>           Noise bandwidth. Default 3000 Hz.\n"
+"    -B <subchannels>  Wideband mode (Linux only): the pipe carries I/Q\n"
+"                      pairs, split into this many sub-channels (a power\n"
+"                      of 2), <samplerate>/<subchannels> Hz apart. Each\n"
+"                      runs through its own channel, see -m, then the\n"
+"                      band is put together again. With -C, control\n"
+"                      lines take a sub-channel like the lines of -m.\n"
+"    -C <fifo>         Control FIFO (created if missing, not on Windows\n"
+"                      and not in chansim-fx). Lines of key=value\n"
+"                      settings change the running channel without\n"
+"                      interrupting the stream: snr, chan, noise, bw,\n"
+"                      ampl, gain, offset, drift, doppler0, doppler1,\n"
+"                      hilbert.\n"
+"                      ramp=<seconds> ramps SNR changes. Example:\n"
+"                      echo \"snr=6 chan=4 ramp=0.5\" > fifo\n"
+"    -d <drift>        Linear drift of the frequency offset in Hz/s.\n"
+"                      Default 0 Hz/s.\n"
+"    -e <file>         Export the channel state (fading gains, path\n"
+"                      delay and the noise of every sample) to a file\n"
+"                      or FIFO, see trace.h (Linux only, not in\n"
+"                      chansim-fx).\n"
 "    -f <nco>          Test NCO frequency. Only valid with I/O = 0.\n"
 "                      Default 1800 Hz.\n"
 "    -g <gain>         Input gain. Input signal is scaled with\n"
 "                      this factor. Default is 1.\n"
+"    -H <hilbert>      Hilbert transformer of the real input.\n"
+"                      0 - FIR pair, linear phase (64 taps at 8 kHz)\n"
+"                      1 - IIR all-pass network: 8 multiplies per\n"
+"                          sample, less delay, +-0.7 degrees\n"
+"                      2 - IIR with a band pass in front\n"
+"                      Default is the FIR. Not in chansim-fx.\n"
 "    -i <IO type>      I/O type.\n"
 "                      0 - Internal test NCO\n"
 "                      1 - Soundcard I/O (not on Windows)\n"
 "                      2 - Pipe I/O (stdin/stdout)\n"
 "                      Default is pipe I/O.\n"
+"    -I <file>         Interference: one interferer per line, a type and\n"
+"                      key=value settings, level in dB relative to the\n"
+"                      signal, e.g. \"cw freq=1200 level=-6 wpm=25\".\n"
+"                      Types carrier, sweep (to, rate), cw (wpm), psk\n"
+"                      and fsk (baud, shift); keys freq, level, drift,\n"
+"                      fade (spread). Not in chansim-fx.\n"
+"    -j                Generate the noise and fading on worker threads\n"
+"                      ahead of the processing (Linux only, not with\n"
+"                      -C and not in chansim-fx). The output is the\n"
+"                      same as without -j, also in IQ mode.\n"
+"    -k <seconds>      Chunk mode (Linux only): the file on stdin is cut\n"
+"                      into chunks this long, processed in parallel by\n"
+"                      -w threads. Noise and fading are drawn per span\n"
+"                      of the file, the output is the same for any -w.\n"
+"    -K <channels>     Group mode: the pipe carries this many channels,\n"
+"                      interleaved like multichannel PCM (I/Q pairs\n"
+"                      with -q). Each runs through a channel of its own,\n"
+"                      seeded with -r plus its index, and the outputs\n"
+"                      are interleaved the same way. The channels are\n"
+"                      processed in groups of 8 in vector lanes, each\n"
+"                      the same as a run of its own. FIR Hilbert\n"
+"                      transformer only, not in chansim-fx.\n";
+
+static const char *HelpOptions2 =
+"    -l <socket>       Daemon mode (Linux only): serve many streams on\n"
+"                      a Unix domain socket path or on tcp:<port> at\n"
+"                      localhost. Each client sends one handshake line\n"
+"                      of key=value settings (snr, chan, noise, seed,\n"
+"                      rate, bw, ampl, gain, offset, drift, doppler0,\n"
+"                      doppler1, iq, hilbert), gets OK or ERR back and\n"
+"                      then streams 16 bit PCM (I/Q pairs with iq=1).\n"
+"                      Missing settings are taken from the command\n"
+"                      line, <SNR> and <format> are optional.\n"
+"    -L <file>         Resume from a snapshot (see -S): the channel\n"
+"                      goes on where it was saved, with the settings\n"
+"                      of the command line. Pipe input is skipped up\n"
+"                      to that point, -t counts from the first run.\n"
+"                      Another -r than before draws new noise and\n"
+"                      fading from there on.\n"
+"    -m <mapfile>      Settings of single sub-channels in wideband mode,\n"
+"                      one line each: <k> or <from>:<to>, then key=value\n"
+"                      settings like in the daemon handshake.\n"
+"    -M <file>         Monitor: every second, write the spectra, power,\n"
+"                      achieved SNR, amplitude histogram, fading CDF\n"
+"                      and Doppler spread to <file>, as JSON or in the\n"
+"                      Prometheus text format if it ends in .prom\n"
+"                      (Linux only, not in chansim-fx).\n"
 "    -n <noise type>   Noise type.\n"
 "                      0 - Gaussian noise\n"
 "                      1 - LaPlacian noise\n"
 "                      2 - Impulse noise\n"
 "                      Default is Gaussian noise.\n"
 "    -o <offset>       Frequency offset. Default 0 Hz.\n"
+"    -O <name>         Publish the output in the shared-memory ring\n"
+"                      /<name> instead of stdout, for any number of\n"
+"                      local readers, see shmring.h and chansim-shmcat\n"
+"                      (Linux only, not in chansim-fx).\n"
+"    -p <doppler>      Doppler shift of the direct path. Default 0 Hz.\n"
+"    -P <doppler>      Doppler shift of the delayed path. Default 0 Hz.\n"
+"    -q                IQ mode for SDR use: the pipe carries complex\n"
+"                      baseband as interleaved 16 bit I/Q pairs, the\n"
+"                      noise bandwidth is -bw/2...+bw/2. The internal\n"
+"                      test NCO is a complex tone. Not in chansim-fx.\n"
+"\n";
+
+static const char *HelpOptions3 =
 "    -r <seed>         Seed for the random number generator.\n"
 "                      Default is a combination of current time\n"
 "                      and process id.\n"
 "    -s <samplerate>   Soundcard samplerate. Also used to scale\n"
 "                      various filters and timings. Default 8000 sps.\n"
+"                      SDR rates like 192000 or 2400000 (with -q) work.\n"
+"    -S <file>         Save the complete channel state to <file> every\n"
+"                      10 minutes of output, on SIGINT or SIGTERM and\n"
+"                      at the end, see -L (not with -j, not in\n"
+"                      chansim-fx).\n"
+"    -t <seconds>      Render this much output as fast as possible and\n"
+"                      stop, reporting progress and the real time\n"
+"                      factor. Input is the NCO or the pipe.\n"
+"    -T <teefile>      Tee mode (Linux only): the pipe input goes through\n"
+"                      several channels, read and Hilbert transformed\n"
+"                      once. One line per output: the file name (- for\n"
+"                      stdout), then key=value settings like in the\n"
+"                      daemon handshake, e.g. \"poor.raw chan=5 snr=10\".\n"
+"                      The seed is -r plus the line's index.\n"
+"    -u <ppm>          Sample clock offset: the output is resampled to a\n"
+"                      clock this many ppm fast (negative: slow), up to\n"
+"                      +-10000. Not in chansim-fx.\n"
+"    -U <ppm/h>        Drift of the sample clock offset per hour.\n"
+"    -w <workers>      Processing threads in daemon, wideband, tee, mix\n"
+"                      and chunk mode. Default 2.\n"
+"    -x                Write the output at the sample rate in real time.\n"
+"                      Default for the NCO without a soundcard, unless\n"
+"                      -t is given.\n"
+"    -X <mixfile>      Mix mode (Linux only): several transmitters, each\n"
+"                      through its own channel, summed to stdout. One\n"
+"                      line per transmitter: the input file (- for\n"
+"                      stdin), then key=value settings, level=<dB> and\n"
+"                      ref=1 for the one whose SNR sets the noise floor,\n"
+"                      e.g. \"far.raw chan=5 level=-20 offset=300\".\n"
+"    -Z <scenario>     Change the channel on a timeline: one line per\n"
+"                      change, the time in seconds, then key=value\n"
+"                      settings like on the control FIFO, e.g.\n"
+"                      \"60 snr=0 offset=20 ramp=30\" (not in chansim-fx).\n"
 "\n";
 
 static const char *HF_Channel_type[] =
@@ -250,146 +530,45 @@ static inline float atoff(const char *s)
 	return (float)atof(s);
 }
 
-//------------------------------------------------------------------
-// Simulated HF channel.
-//------------------------------------------------------------------
-// 1) Form analytic signal, data saved into tapped delay line.
-// 2) Compute fading gain factors (done at an update rate equal
-//    to the symbol rate.)
-// 3) Complex multiply fading gain factors with path components.
-// 4) Add Gaussian noise component magnitude for the specified SNR.
-// 5) Extract real part.
-//------------------------------------------------------------------
-static float simprocess(float input_signal)
+//
+// "<snr>", "<snr>,<snr>,..." or "<from>:<step>:<to>" in dB.
+// Returns the number of SNRs, 0 on errors.
+//
+static int parse_snrs(const char *s, float *snr)
 {
-	static float_complex fade0, fade1;
-	static float nco = 0.0;
-	static int pointsleft = 0;
-	float rmsval;
-	float inoise;
-	float_complex sig, dsig, z;
-
-	// Create analytic input signal
-	sig = make_float_complex(input_signal / (float)M_SQRT2, input_signal / (float)M_SQRT2);
-	sig = filter(Filter, sig);
-
-	// Shift the frequency if requested
-	if (FreqOffset != 0.0) {
-		z = make_float_complex(cosf(nco), sinf(nco));
-		sig = cplx_mulf(sig, z);
-
-		nco += 2.0F * (float)M_PI * FreqOffset / SampleRate;
-
-		if (nco > (float)M_PI)
-			nco -= 2.0F * (float)M_PI;
-		if (nco < (float)(-M_PI))
-			nco += 2.0F * (float)M_PI;
-	}
-
-	// Fading gain is activated at the "symbol" (update) rate.
-	// Update direct and delayed path fading gain coefficients if needed,
-	// for noise-only simulation, leave fading gain coefficients constant.
-	if (--pointsleft <= 0) {
-		if (FrSpread > 0.0F) {
-			FadeGains(&fade0, &fade1);
-		} else {
-			fade0 = make_float_complex(1.0F / (float)M_SQRT2, 1.0F / (float)M_SQRT2);
-			fade1 = make_float_complex(1.0F / (float)M_SQRT2, 1.0F / (float)M_SQRT2);
+	float from, step, to;
+	char *end;
+	int n = 0;
+
+	from = strtof(s, &end);
+	if (end == s)
+		return 0;
+
+	if (*end == ':') {
+		step = strtof(s = end + 1, &end);
+		if (end == s || *end != ':')
+			return 0;
+		to = strtof(s = end + 1, &end);
+		if (end == s || *end || step <= 0.0F || to < from)
+			return 0;
+		for (n = 0; from + n * step <= to + 1e-3F * step; n++) {
+			if (n == MAX_SNRS)
+				return 0;
+			snr[n] = from + n * step;
 		}
-		pointsleft = SampleRate / TapUpdRate;
+		return n;
 	}
 
-	//------------------------------------------------------------------
-	// Holding the fading gain constant for a symbol time,
-	// Use I and Q data for two paths, complex multiply with fading gain
-	// to generate effective outputs for each symbol sample point.
-	//------------------------------------------------------------------
-	if (DelTime > 0.0) {
-		// Multipath
-
-		// Delayed (second) path
-		dsig = delayline(sig);
-		dsig = cplx_mulf(dsig, fade1);
-
-		// First path
-		sig = cplx_mulf(sig, fade0);
-	} else {
-		// Flat fading
-
-		// First path
-		sig = cplx_mulf(sig, fade0);
-		cplx_scale(sig, (float)M_SQRT2);
-
-		// Delayed path
-		dsig = make_float_complex(0.0F, 0.0F);
+	snr[n++] = from;
+	while (*end == ',') {
+		if (n == MAX_SNRS)
+			return 0;
+		snr[n++] = strtof(s = end + 1, &end);
+		if (end == s)
+			return 0;
 	}
 
-	// Compute input signal's RMS
-	// This is needed to scale noise magnitude.
-	if (Amplitude == 0.0F)
-		rmsval = rms(RootMeanSqr, input_signal);
-	else
-		rmsval = Amplitude;
-
-	// Noise generator generates in-phase and quadrature
-	// noise components that are jointly normal, with each
-	// component having RMS amplitude of unity and RMS noise power
-	// is unity.
-	// Note: noise gets compensated for bandwidth-limiting filter loss.
-	// We also have to convert the input RMS to voltage levels.
-	inoise = BandLtdNoise(Noise) * rmsval / SigLvl;
-
-	// compute output, we don't use imaginary part here
-	return DIRECT * crealf(sig) + DELAYED * crealf(dsig) + inoise;
-	// return DIRECT * sig.re + DELAYED * dsig.re;
-	// return inoise;
-}
-
-//----------------------------------------------------------------------------
-// Initialize simulation paramaters.
-// Initializes Gaussian filter coefficients.
-//----------------------------------------------------------------------------
-static void SetParms(float snr, int simform)
-{
-	// convert from dB to voltage ratio
-	SigLvl = powf(10.0F, snr / 20.0F);
-
-	switch (simform) {
-	default:
-	case 0:				// NOISE ONLY
-		DelTime = 0.0F;
-		FrSpread = 0.0F;
-		break;
-	case 1:				// FLAT 1
-		DelTime = 0.0F;		// 0.0 ms delay
-		FrSpread = 0.2F;		// 0.2 Hz spread
-		break;
-	case 2:				// FLAT 2
-		DelTime = 0.0F;		// 0.0 ms delay
-		FrSpread = 1.0F;		// 1.0 Hz spread
-		break;
-	case 3:				// CCIR GOOD
-		DelTime = 0.5e-3F;	// 0.5 ms delay
-		FrSpread = 0.1F;		// 0.1 Hz spread
-		break;
-	case 4:				// CCIR MODERATE
-		DelTime = 1.0e-3F;	// 1.0 ms delay
-		FrSpread = 0.5F;		// 0.5 Hz spread
-		break;
-	case 5:				// CCIR POOR
-		DelTime = 2.0e-3F;	// 2.0 ms delay
-		FrSpread = 1.0F;		// 1.0 Hz spread
-		break;
-	case 6:				// CCIR FLUTTER FADING
-		DelTime = 0.5e-3F;	// 0.5 ms delay
-		FrSpread = 10.0F;	// 10.0 Hz spread
-		break;
-	case 7:				// EXTREME
-		DelTime = 2.0e-3F;	// 2.0 ms delay
-		FrSpread = 5.0F;		// 5.0 Hz spread
-		break;
-	}
-	TapUpdRate = (int)(50.0F * FrSpread + 1.0F);
+	return *end ? 0 : n;
 }
 
 #ifdef USE_SOUND
@@ -439,22 +618,136 @@ static int init_audio(int srate, int chan, int format)
 
 #endif
 
+#ifdef USE_FIXED_POINT
+
 //
 // Generate output from whatever input was selected...
+// Fixed-point version: 16-bit PCM all the way through.
 //
 static int gensig(int16_t *buf_ptr, int size, int iotype)
 {
+	static int16_t sigbuf[BUF_SIZE];
+	int32_t gain = (int32_t)(InputGain * 4096.0F + 0.5F);	// Q12
+	int32_t temp;
 	int i;
-	float ftemp;
-	int16_t temp;
+
+	if (iotype == 0)
+		nco_fx_real(&TestNCO, sigbuf, size);
 
 	for (i = 0; i < size; i++) {
 		switch (iotype) {
 		case 0:				// NCO
-			temp = (int16_t)( NCO_GAIN * cosf(phase_accum) );
-			phase_accum += delta;
-			if (phase_accum > 2.0F * (float)M_PI)
-				phase_accum -= 2.0F * (float)M_PI;
+			temp = ((int32_t)NCO_GAIN * sigbuf[i]) >> 15;
+			break;
+		case 1:				// Sound IO
+		case 2:				// File IO
+			temp = audio_buf_in[i];
+			break;
+		default:			// Won't happen...
+			temp = 0;
+			break;
+		}
+
+		temp = (temp * gain) >> 12;
+		if (temp > 32767)
+			temp = 32767;
+		if (temp < -32768)
+			temp = -32768;
+		sigbuf[i] = (int16_t)temp;
+	}
+
+	// Push signal though HF channel, saturates the output
+	channel_fx_process(Channel, sigbuf, buf_ptr, size);
+	if (Channel->clipped)
+		fprintf(stderr, "chansim: clipping! (%d samples)\n", Channel->clipped);
+
+	return size;
+}
+
+#else
+
+//
+// Output signal is 16-bit PCM, saturate instead of wraparound.
+//
+static inline int16_t to_pcm(float ftemp)
+{
+	if (ftemp > 0.999F) {
+		ftemp = 0.999F;
+		fprintf(stderr, "chansim: positive clipping!\n");
+	}
+	if (ftemp < -0.999F) {
+		ftemp = -0.999F;
+		fprintf(stderr, "chansim: negative clipping!\n");
+	}
+
+	return (int16_t) (ftemp * 32768.0F);
+}
+
+#ifdef USE_SKEW
+//
+// Resample 'size' frames of 'width' values to the output's clock,
+// returns the number of frames.
+//
+static int skew_pcm(int16_t *buf_ptr, const float *frames, int size, int width)
+{
+	static float skewed[2 * OUT_SIZE * MAX_SNRS];
+	int i, n;
+
+	n = skew_process(Skew, frames, size, skewed);
+	for (i = 0; i < n * width; i++)
+		buf_ptr[i] = to_pcm(skewed[i]);
+
+	return n;
+}
+#endif
+
+#ifdef USE_SCENARIO
+//
+// Process a block, cut where the scenario changes the channel.
+//
+static void process_scenario(float_complex *zbuf, int size)
+{
+	float *sigbuf = (float *)zbuf;
+	long long due;
+	int n;
+
+	for (; size > 0; size -= n, zbuf += n, sigbuf += n) {
+		due = scenario_step(Scenario, Channel);
+		n = (due > 0 && due < size) ? (int)due : size;
+		if (IQMode)
+			channel_process_iq(Channel, zbuf, zbuf, n);
+		else
+			channel_process(Channel, sigbuf, sigbuf, n);
+	}
+}
+#endif
+
+//
+// Generate output from whatever input was selected...
+//
+static int gensig(int16_t *buf_ptr, int size, int iotype)
+{
+	static float_complex zbuf[BUF_SIZE];
+	float *sigbuf = (float *)zbuf;		// real samples or I/Q pairs
+	int nval = IQMode ? 2 * size : size;
+	int i;
+	int16_t temp;
+
+	if (iotype == 0) {
+		if (IQMode) {
+			// complex tone
+			for (i = 0; i < size; i++)
+				zbuf[i] = make_float_complex(1.0F, 0.0F);
+			nco_mix(TestNCO, zbuf, size);
+		} else {
+			nco_real(TestNCO, sigbuf, size);
+		}
+	}
+
+	for (i = 0; i < nval; i++) {
+		switch (iotype) {
+		case 0:				// NCO
+			temp = (int16_t)( NCO_GAIN * sigbuf[i] );
 			break;
 		case 1:				// Sound IO
 		case 2:				// File IO
@@ -465,39 +758,383 @@ static int gensig(int16_t *buf_ptr, int size, int iotype)
 			break;
 		}
 
-		// Push signal though HF channel
-		ftemp = temp * InputGain / 32768.0F;
-		ftemp = simprocess(ftemp);
+		sigbuf[i] = temp * InputGain / 32768.0F;
+	}
+
+	// Several SNRs: one pass, the outputs are interleaved
+	if (NumSnrs > 1) {
+		static float multi[MAX_SNRS - 1][2 * BUF_SIZE];
+		float *outs[MAX_SNRS];
+		int w = IQMode ? 2 : 1;
+		int j, c;
+
+		outs[0] = sigbuf;
+		for (j = 1; j < NumSnrs; j++)
+			outs[j] = multi[j - 1];
+		channel_process_snrs(Channel, sigbuf, outs, Snrs, NumSnrs, size);
+
+#ifdef USE_SKEW
+		if (Skew) {
+			static float frames[2 * BUF_SIZE * MAX_SNRS];
+
+			for (i = 0; i < size; i++)
+				for (j = 0; j < NumSnrs; j++)
+					for (c = 0; c < w; c++)
+						frames[(i * NumSnrs + j) * w + c] = outs[j][i * w + c];
+			return skew_pcm(buf_ptr, frames, size, NumSnrs * w);
+		}
+#endif
+		for (i = 0; i < size; i++)
+			for (j = 0; j < NumSnrs; j++)
+				for (c = 0; c < w; c++)
+					buf_ptr[(i * NumSnrs + j) * w + c] = to_pcm(outs[j][i * w + c]);
+
+		return size;
+	}
+
+	// Push signal though HF channel
+#ifdef USE_MONITOR
+	if (Monitor)
+		monitor_input(Monitor, sigbuf, size);
+#endif
+#ifdef USE_SCENARIO
+	if (Scenario)
+		process_scenario(zbuf, size);
+	else
+#endif
+	if (IQMode)
+		channel_process_iq(Channel, zbuf, zbuf, size);
+	else
+		channel_process(Channel, sigbuf, sigbuf, size);
+#ifdef USE_MONITOR
+	if (Monitor)
+		monitor_output(Monitor, sigbuf, size);
+#endif
+#ifdef USE_SKEW
+	if (Skew)
+		return skew_pcm(buf_ptr, sigbuf, size, IQMode ? 2 : 1);
+#endif
+
+	for (i = 0; i < nval; i++)
+		buf_ptr[i] = to_pcm(sigbuf[i]);
+
+	return size;
+}
+
+#endif
+
+#if defined(USE_TRACE) && defined(USE_MONITOR)
+// The state export and the monitor share the channel's probe.
+static void probe_both(void *arg, const struct chan_state_s *st)
+{
+	(void)arg;
+	trace_probe(Trace, st);
+	monitor_probe(Monitor, st);
+}
+#endif
+
+//----------------------------------------------------------------------------
+// Real time pacing and render progress. The deadline of a block is
+// computed from the number of samples written since the start, so
+// there is no drift however long the stream runs.
+//----------------------------------------------------------------------------
+#ifdef WIN32
+static void clock_now(struct timespec *t)
+{
+	timespec_get(t, TIME_UTC);
+}
+#else
+static void clock_now(struct timespec *t)
+{
+	clock_gettime(CLOCK_MONOTONIC, t);
+}
+#endif
+
+static double seconds_since(const struct timespec *t0)
+{
+	struct timespec t;
+
+	clock_now(&t);
+	return (double)(t.tv_sec - t0->tv_sec) + (t.tv_nsec - t0->tv_nsec) * 1e-9;
+}
+
+// Wait until 'samples' samples after 't0'.
+static void pace(const struct timespec *t0, long long samples)
+{
+	struct timespec t;
+	long long ns;
+
+	ns = (samples % SampleRate) * 1000000000LL / SampleRate;
+	t.tv_sec = t0->tv_sec + (time_t)(samples / SampleRate) + (time_t)((t0->tv_nsec + ns) / 1000000000LL);
+	t.tv_nsec = (long)((t0->tv_nsec + ns) % 1000000000LL);
+
+#ifdef WIN32
+	{
+		struct timespec now;
+		double wait;
+
+		clock_now(&now);
+		wait = (double)(t.tv_sec - now.tv_sec) + (t.tv_nsec - now.tv_nsec) * 1e-9;
+		if (wait > 0.0)
+			usleep((unsigned int)(wait * 1e6));
+	}
+#else
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR)
+		;
+#endif
+}
+
+// Once a second and at the end ('last' set) while rendering.
+static void progress(const struct timespec *t0, long long samples, long long total, int last)
+{
+	static double shown = 0.0;
+	double wall = seconds_since(t0);
+	double done = (double)samples / SampleRate;
+
+	if (!last && wall < shown + 1.0)
+		return;
+	shown = wall;
+
+	if (last) {
+		fprintf(stderr, "\rchansim: %.1f s rendered in %.1f s, %.1fx real time        \n",
+			done, wall, wall > 0.0 ? done / wall : 0.0);
+	} else {
+		fprintf(stderr, "\rchansim: %.1f s of %.1f s (%d%%), %.1fx real time ",
+			done, (double)total / SampleRate, (int)(100 * samples / total),
+			wall > 0.0 ? done / wall : 0.0);
+	}
+}
 
-		// Saturate instead of wraparound
-		if (ftemp > 0.999F) {
-			ftemp = 0.999F;
-			fprintf(stderr, "chansim: positive clipping!\n");
+#ifdef USE_CONTROL
+
+//
+// Apply the command lines waiting in the control FIFO.
+// Called between two blocks, so a change takes effect at a block boundary.
+//
+static void apply_control(void)
+{
+	struct chan_settings_s set;
+	struct chan_parms_s p;
+	const char *err;
+	char *line;
+
+	while ((line = control_line(Control)) != NULL) {
+		set = Settings;
+		set.seeded = 0;
+		err = parse_settings(&set, line);
+		if (!err && set.seeded)
+			err = "the seed cannot be changed";
+		if (!err && set.parms.samplerate != Settings.parms.samplerate)
+			err = "the sample rate cannot be changed";
+		if (!err) {
+			p = set.parms;
+			p.amplitude *= set.gain;
+			if (channel_reconfigure(Channel, &p, set.ramp) < 0)
+				err = "reconfiguration failed";
 		}
-		if (ftemp < -0.999F) {
-			ftemp = -0.999F;
-			fprintf(stderr, "chansim: negative clipping!\n");
+		if (err) {
+			fprintf(stderr, "chansim: control: %s\n", err);
+			continue;
 		}
 
-		// output signal is 16-bit PCM
-		buf_ptr[i] = (int16_t) (ftemp * 32768.0F);
+		Settings = set;
+		InputGain = set.gain;
+		fprintf(stderr, "chansim: control: %s, S/N ratio = %.1f dB (%s)\n",
+			HF_Channel_type[p.simform], p.snr, HF_Noise[p.noisetype]);
+	}
+}
+
+#endif
+
+#ifdef USE_SNAPSHOT
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	Stop = 1;
+}
+
+static void snapshot(void)
+{
+	if (save_snapshot(SnapshotPath, Channel, TestNCO) < 0)
+		perror("chansim: snapshot");
+}
+
+//
+// The channel of the snapshot, going on with the settings of the
+// command line. A seed given with -r other than the saved one restarts
+// the random numbers.
+//
+static struct channel_s *resume(const struct chan_parms_s *p, int seeded)
+{
+	struct channel_s *ch;
+	struct chan_parms_s cur;
+
+	if ((ch = load_snapshot(ResumePath, TestNCO)) == NULL) {
+		fprintf(stderr, "chansim: %s: not a snapshot of this chansim\n", ResumePath);
+		exit(1);
+	}
+
+	// a reconfiguration to the same settings is not a no-op (the
+	// fading update is cut short), so only on a change
+	cur = *p;
+	cur.seed = ch->parms.seed;
+	if (memcmp(&cur, &ch->parms, sizeof(cur)) && channel_reconfigure(ch, &cur, 0.0F) < 0) {
+		fprintf(stderr, "chansim: the sample rate and IQ mode of a snapshot cannot be changed\n");
+		exit(1);
+	}
+
+	if (seeded && p->seed != ch->parms.seed) {
+		channel_seed(ch, p->seed);
+		ch->parms.seed = p->seed;
 	}
 
-	return i;
+	fprintf(stderr, "\tResumed at %.1f s\n", (double)ch->samples / p->samplerate);
+
+	return ch;
+}
+
+//
+// Skip the input already processed before the snapshot: 'n' 16 bit values.
+//
+static void skip_input(long long n)
+{
+	size_t c;
+
+	if (n <= LONG_MAX / (long long)sizeof(int16_t) &&
+	    fseek(stdin, (long)(n * sizeof(int16_t)), SEEK_CUR) == 0)
+		return;
+
+	// a pipe is read
+	for (; n > 0; n -= (long long)c) {
+		c = (n < 2 * BUF_SIZE) ? (size_t)n : 2 * BUF_SIZE;
+		if (fread(audio_buf_in, sizeof(int16_t), c, stdin) != c) {
+			fprintf(stderr, "chansim: the input ends before the snapshot\n");
+			exit(1);
+		}
+	}
+}
+
+#endif
+
+#if defined(USE_QRM) || defined(USE_SHM) || defined(USE_SKEW)
+
+//
+// Nonzero in daemon, wideband, tee or mix mode, which set up their channels
+// and outputs themselves.
+//
+static int multi_mode(void)
+{
+#ifdef USE_DAEMON
+	if (ListenAddr)
+		return 1;
+#endif
+#ifdef USE_WIDEBAND
+	if (Subchannels)
+		return 1;
+#endif
+#ifdef USE_TEE
+	if (TeePath)
+		return 1;
+#endif
+#ifdef USE_MIX
+	if (MixPath)
+		return 1;
+#endif
+	return 0;
 }
 
+#endif
+
+#if defined(USE_CHUNKS) || defined(USE_GROUP)
+
+//
+// An option chunk and group mode do not take, or NULL. Their channels
+// are set up in chunk.c and group.c, with noise and fading of their own.
+//
+static const char *chunk_conflict(void)
+{
+#ifdef USE_DAEMON
+	if (ListenAddr)
+		return "-l";
+#endif
+#ifdef USE_WIDEBAND
+	if (Subchannels)
+		return "-B";
+#endif
+#ifdef USE_TEE
+	if (TeePath)
+		return "-T";
+#endif
+#ifdef USE_MIX
+	if (MixPath)
+		return "-X";
+#endif
+#ifdef USE_CONTROL
+	if (ControlPath)
+		return "-C";
+#endif
+#ifdef USE_TRACE
+	if (TracePath)
+		return "-e";
+#endif
+#ifdef USE_MONITOR
+	if (MonitorPath)
+		return "-M";
+#endif
+#ifdef USE_PIPELINE
+	if (Pipelined)
+		return "-j";
+#endif
+#ifdef USE_SNAPSHOT
+	if (SnapshotPath || ResumePath)
+		return "snapshots";
+#endif
+#ifdef USE_QRM
+	if (QrmPath)
+		return "-I";
+#endif
+#ifdef USE_SCENARIO
+	if (ScenarioPath)
+		return "-Z";
+#endif
+#ifdef USE_SHM
+	if (ShmName)
+		return "-O";
+#endif
+#ifdef USE_SKEW
+	if (SkewPpm != 0.0 || SkewDrift != 0.0)
+		return "-u";
+#endif
+	return NULL;
+}
+
+#endif
+
 //===================================================================//
 int main(int argc, char *argv[])
 {
 	int audio_fd = -1;
 	int i;
 	int errflag = 0;
+#if defined(USE_CHUNKS) || defined(USE_GROUP)
+	const char *opt;
+#endif
 	int Chan_type = 0;
 	int IO_type = 2;	/* default is STDIO */
 	int Noise_type = 0;	/* default is gaussian */
 	float SNR_parm = 30.0F;
+	struct chan_parms_s parms;
 	unsigned int seed;
-	uint32_t usleep_duration = 0U;
+#ifdef USE_SNAPSHOT
+	int seeded = 0;		/* -r given */
+#endif
+	long long total = 0;	/* samples to write, 0 = no limit */
+	long long written = 0;
+#ifdef USE_SNAPSHOT
+	long long next_snapshot = 0;
+#endif
+	struct timespec start;
 
 	seed = (unsigned)( time(NULL) + GETPID() );
 
@@ -512,7 +1149,7 @@ int main(int argc, char *argv[])
 		if (i && optarg)
 			++argidx;
 #else
-	while ((i = getopt(argc, argv, "a:b:f:g:hi:n:o:r:s:")) != EOF) {
+	while ((i = getopt(argc, argv, "a:b:B:C:d:e:f:g:hH:i:I:jk:K:l:L:m:M:n:o:O:p:P:qr:s:S:t:T:u:U:w:xX:Z:")) != EOF) {
 #endif
 		switch (i) {
 		case 'a':
@@ -521,6 +1158,28 @@ int main(int argc, char *argv[])
 		case 'b':
 			ChannelBW = atoff(optarg);
 			break;
+#ifdef USE_WIDEBAND
+		case 'B':
+			Subchannels = atoi(optarg);
+			IQMode = 1;
+			break;
+		case 'm':
+			SubchannelMap = optarg;
+			break;
+#endif
+#ifdef USE_CONTROL
+		case 'C':
+			ControlPath = optarg;
+			break;
+#endif
+		case 'd':
+			FreqDrift = atoff(optarg);
+			break;
+#ifdef USE_TRACE
+		case 'e':
+			TracePath = optarg;
+			break;
+#endif
 		case 'f':
 			NCOFreq = atoff(optarg);
 			break;
@@ -534,6 +1193,50 @@ int main(int argc, char *argv[])
 				exit(1);
 			}
 			break;
+#ifdef USE_QRM
+		case 'I':
+			QrmPath = optarg;
+			break;
+#endif
+#ifdef USE_MONITOR
+		case 'M':
+			MonitorPath = optarg;
+			break;
+#endif
+#ifdef USE_SNAPSHOT
+		case 'L':
+			ResumePath = optarg;
+			break;
+		case 'S':
+			SnapshotPath = optarg;
+			break;
+#endif
+#ifdef USE_PIPELINE
+		case 'j':
+			Pipelined = 1;
+			break;
+#endif
+#ifdef USE_CHUNKS
+		case 'k':
+			ChunkSeconds = atoff(optarg);
+			break;
+#endif
+#ifdef USE_GROUP
+		case 'K':
+			if ((GroupChannels = atoi(optarg)) < 1)
+				errflag++;
+			break;
+#endif
+#ifdef USE_DAEMON
+		case 'l':
+			ListenAddr = optarg;
+			break;
+#endif
+#if defined(USE_DAEMON) || defined(USE_WIDEBAND) || defined(USE_TEE) || defined(USE_MIX) || defined(USE_CHUNKS)
+		case 'w':
+			Workers = atoi(optarg);
+			break;
+#endif
 		case 'n':
 			Noise_type = atoi(optarg);
 			if (Noise_type < 0 || Noise_type > 2) {
@@ -544,20 +1247,77 @@ int main(int argc, char *argv[])
 		case 'o':
 			FreqOffset = atoff(optarg);
 			break;
+#ifdef USE_SHM
+		case 'O':
+			ShmName = optarg;
+			break;
+#endif
+		case 'p':
+			DopplerDirect = atoff(optarg);
+			break;
+		case 'P':
+			DopplerDelayed = atoff(optarg);
+			break;
+#ifndef USE_FIXED_POINT
+		case 'q':
+			IQMode = 1;
+			break;
+		case 'H':
+			Hilbert = atoi(optarg);
+			if (Hilbert < FILTER_FIR || Hilbert > FILTER_IIR_BAND) {
+				fprintf(stderr, "chansim: invalid Hilbert transformer: %d\n", Hilbert);
+				exit(1);
+			}
+			break;
+#endif
 		case 'r':
 			seed = strtoul(optarg, NULL, 0);
+#ifdef USE_SNAPSHOT
+			seeded = 1;
+#endif
 			break;
 		case 's':
 			SampleRate = atoi(optarg);
 			break;
+		case 't':
+			Duration = atoff(optarg);
+			break;
+#ifdef USE_TEE
+		case 'T':
+			TeePath = optarg;
+			break;
+#endif
+#ifdef USE_SKEW
+		case 'u':
+			SkewPpm = atof(optarg);
+			break;
+		case 'U':
+			SkewDrift = atof(optarg);
+			break;
+#endif
+		case 'x':
+			Pace = 1;
+			break;
+#ifdef USE_MIX
+		case 'X':
+			MixPath = optarg;
+			break;
+#endif
+#ifdef USE_SCENARIO
+		case 'Z':
+			ScenarioPath = optarg;
+			break;
+#endif
 		case 'R':
-			SNR_parm = atoff(optarg);
+			if ((NumSnrs = parse_snrs(optarg, Snrs)) == 0)
+				errflag++;
+			SNR_parm = Snrs[0];
 			break;
 		case 'c':
 			Chan_type = atoi(optarg);
 			break;
 		case 'h':
-			printf("%s", HelpString);
+			printf("%s%s%s%s", HelpString, HelpOptions, HelpOptions2, HelpOptions3);
 			exit(0);
 			break;
 		case ':':
@@ -568,7 +1328,13 @@ int main(int argc, char *argv[])
 	}
 
 #ifndef WIN32
-	if ((argc - optind) != 2)
+	i = argc - optind;
+#ifdef USE_DAEMON
+	// the daemon may take the channel from the handshakes only
+	if (ListenAddr && i == 0)
+		i = 2;
+#endif
+	if (i != 2)
 		errflag++;
 #endif
 
@@ -578,8 +1344,211 @@ int main(int argc, char *argv[])
 	}
 
 #ifndef WIN32
-	SNR_parm = atof(argv[optind++]);
-	Chan_type = atoi(argv[optind++]);
+	if (argc - optind == 2) {
+		if ((NumSnrs = parse_snrs(argv[optind++], Snrs)) == 0) {
+			fprintf(stderr, "chansim: invalid SNR: %s\n", argv[optind - 1]);
+			exit(1);
+		}
+		SNR_parm = Snrs[0];
+		Chan_type = atoi(argv[optind++]);
+	}
+#endif
+
+	if (NumSnrs > 1) {
+#ifdef USE_FIXED_POINT
+		fprintf(stderr, "chansim: several SNRs are not supported in chansim-fx\n");
+		exit(1);
+#endif
+		if (IO_type == 1) {
+			fprintf(stderr, "chansim: several SNRs need pipe I/O\n");
+			exit(1);
+		}
+#ifdef USE_TRACE
+		if (TracePath) {
+			fprintf(stderr, "chansim: the state export needs a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_MONITOR
+		if (MonitorPath) {
+			fprintf(stderr, "chansim: the monitor needs a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_DAEMON
+		if (ListenAddr) {
+			fprintf(stderr, "chansim: the daemon takes a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_WIDEBAND
+		if (Subchannels) {
+			fprintf(stderr, "chansim: wideband mode takes a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_TEE
+		if (TeePath) {
+			fprintf(stderr, "chansim: tee mode takes a single SNR per output\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_MIX
+		if (MixPath) {
+			fprintf(stderr, "chansim: mix mode takes a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_CHUNKS
+		if (ChunkSeconds > 0.0F) {
+			fprintf(stderr, "chansim: chunk mode takes a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_SCENARIO
+		if (ScenarioPath) {
+			fprintf(stderr, "chansim: a scenario takes a single SNR\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_GROUP
+		if (GroupChannels) {
+			fprintf(stderr, "chansim: group mode takes a single SNR\n");
+			exit(1);
+		}
+#endif
+	}
+
+#ifdef USE_CHUNKS
+	if (ChunkSeconds > 0.0F && (opt = chunk_conflict()) != NULL) {
+		fprintf(stderr, "chansim: chunk mode does not work with %s\n", opt);
+		exit(1);
+	}
+#endif
+#ifdef USE_GROUP
+	if (GroupChannels) {
+		opt = chunk_conflict();
+#ifdef USE_CHUNKS
+		if (ChunkSeconds > 0.0F)
+			opt = "-k";
+#endif
+		if (opt) {
+			fprintf(stderr, "chansim: group mode does not work with %s\n", opt);
+			exit(1);
+		}
+	}
+#endif
+
+	if (IQMode && IO_type == 1) {
+		fprintf(stderr, "chansim: IQ mode needs pipe I/O\n");
+		exit(1);
+	}
+
+#ifdef USE_SNAPSHOT
+	if (SnapshotPath || ResumePath) {
+		if (IO_type == 1) {
+			fprintf(stderr, "chansim: snapshots need pipe I/O or the test NCO\n");
+			exit(1);
+		}
+#ifdef USE_DAEMON
+		if (ListenAddr) {
+			fprintf(stderr, "chansim: the daemon does not take snapshots\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_WIDEBAND
+		if (Subchannels) {
+			fprintf(stderr, "chansim: wideband mode does not take snapshots\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_PIPELINE
+		// the worker threads are ahead of the channel's state
+		if (Pipelined && SnapshotPath) {
+			fprintf(stderr, "chansim: -j does not work with -S\n");
+			exit(1);
+		}
+#endif
+	}
+#endif
+
+#ifdef USE_QRM
+	if (QrmPath) {
+#ifdef USE_SNAPSHOT
+		// the interferers' state is not saved
+		if (SnapshotPath || ResumePath) {
+			fprintf(stderr, "chansim: -I does not work with snapshots\n");
+			exit(1);
+		}
+#endif
+		if (multi_mode()) {
+			fprintf(stderr, "chansim: -I does not work in daemon, wideband, tee or mix mode\n");
+			exit(1);
+		}
+	}
+#endif
+
+#ifdef USE_SHM
+	if (ShmName && (multi_mode() || IO_type == 1)) {
+		fprintf(stderr, "chansim: -O needs pipe I/O or the test NCO\n");
+		exit(1);
+	}
+#endif
+
+#if defined(USE_PIPELINE) && defined(USE_CONTROL)
+	// the worker threads cut the blocks of a fixed configuration
+	if (Pipelined && ControlPath) {
+		fprintf(stderr, "chansim: -j does not work with a control FIFO\n");
+		exit(1);
+	}
+#endif
+
+#ifdef USE_SCENARIO
+	if (ScenarioPath) {
+		if (multi_mode()) {
+			fprintf(stderr, "chansim: -Z does not work in daemon, wideband, tee or mix mode\n");
+			exit(1);
+		}
+#ifdef USE_PIPELINE
+		if (Pipelined) {
+			fprintf(stderr, "chansim: -j does not work with a scenario\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_CONTROL
+		if (ControlPath) {
+			fprintf(stderr, "chansim: a scenario does not work with a control FIFO\n");
+			exit(1);
+		}
+#endif
+#ifdef USE_SNAPSHOT
+		// the position in the scenario is not saved
+		if (SnapshotPath || ResumePath) {
+			fprintf(stderr, "chansim: a scenario does not work with snapshots\n");
+			exit(1);
+		}
+#endif
+	}
+#endif
+
+#ifdef USE_SKEW
+	if (SkewPpm != 0.0 || SkewDrift != 0.0) {
+		if (fabs(SkewPpm) > SKEW_MAX_PPM) {
+			fprintf(stderr, "chansim: the clock offset is limited to +-%.0f ppm\n", SKEW_MAX_PPM);
+			exit(1);
+		}
+		if (multi_mode()) {
+			fprintf(stderr, "chansim: -u does not work in daemon, wideband, tee or mix mode\n");
+			exit(1);
+		}
+#ifdef USE_SNAPSHOT
+		// the resampler's state is not saved
+		if (SnapshotPath || ResumePath) {
+			fprintf(stderr, "chansim: -u does not work with snapshots\n");
+			exit(1);
+		}
+#endif
+	}
 #endif
 
 	if (Chan_type < 0 || Chan_type > 7) {
@@ -587,16 +1556,152 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
+#if defined(USE_DAEMON) || defined(USE_WIDEBAND) || defined(USE_TEE) || defined(USE_MIX) || defined(USE_CHUNKS) || defined(USE_GROUP)
+	parms.snr = SNR_parm;
+	parms.simform = Chan_type;
+	parms.noisetype = Noise_type;
+	parms.samplerate = SampleRate;
+	parms.bandwidth = ChannelBW;
+	parms.amplitude = Amplitude;	// scaled by the gain of a stream or sub-channel
+	parms.offset = FreqOffset;
+	parms.drift = FreqDrift;
+	parms.doppler0 = DopplerDirect;
+	parms.doppler1 = DopplerDelayed;
+	parms.seed = seed;
+	parms.iq = IQMode;
+	parms.hilbert = Hilbert;
+#endif
+
+#ifdef USE_DAEMON
+	if (ListenAddr)
+		return run_daemon(ListenAddr, Workers, &parms, InputGain) ? 1 : 0;
+#endif
+
+#ifdef USE_WIDEBAND
+	if (Subchannels) {
+		if (IO_type != 2) {
+			fprintf(stderr, "chansim: wideband mode needs pipe I/O\n");
+			exit(1);
+		}
+		return run_wideband(Subchannels, Workers, &parms, InputGain,
+				    SubchannelMap, ControlPath) ? 1 : 0;
+	}
+#endif
+
+#ifdef USE_TEE
+	if (TeePath) {
+		if (IO_type != 2) {
+			fprintf(stderr, "chansim: tee mode needs pipe I/O\n");
+			exit(1);
+		}
+		return run_tee(TeePath, Workers, &parms, InputGain) ? 1 : 0;
+	}
+#endif
+
+#ifdef USE_MIX
+	if (MixPath) {
+		if (IO_type != 2) {
+			fprintf(stderr, "chansim: mix mode needs pipe I/O\n");
+			exit(1);
+		}
+		return run_mix(MixPath, Workers, &parms, InputGain) ? 1 : 0;
+	}
+#endif
+
+#ifdef USE_CHUNKS
+	if (ChunkSeconds > 0.0F) {
+		if (IO_type != 2) {
+			fprintf(stderr, "chansim: chunk mode needs pipe I/O\n");
+			exit(1);
+		}
+		if (Duration > 0.0F)
+			total = (long long)((double)Duration * SampleRate + 0.5);
+		return run_chunks(ChunkSeconds, Workers, &parms, InputGain, total) ? 1 : 0;
+	}
+#endif
+
+#ifdef USE_GROUP
+	if (GroupChannels) {
+		if (IO_type != 2) {
+			fprintf(stderr, "chansim: group mode needs pipe I/O\n");
+			exit(1);
+		}
+		if (!IQMode && Hilbert != FILTER_FIR) {
+			fprintf(stderr, "chansim: group mode needs the FIR Hilbert transformer\n");
+			exit(1);
+		}
+		return run_group(GroupChannels, &parms, InputGain) ? 1 : 0;
+	}
+#endif
+
+#ifdef USE_SCENARIO
+	// the settings at 0 s are the ones to start with
+	if (ScenarioPath) {
+		parms.snr = SNR_parm;
+		parms.simform = Chan_type;
+		parms.noisetype = Noise_type;
+		parms.samplerate = SampleRate;
+		parms.bandwidth = ChannelBW;
+		parms.amplitude = Amplitude;
+		parms.offset = FreqOffset;
+		parms.drift = FreqDrift;
+		parms.doppler0 = DopplerDirect;
+		parms.doppler1 = DopplerDelayed;
+		parms.seed = seed;
+		parms.iq = IQMode;
+		parms.hilbert = Hilbert;
+		if ((Scenario = load_scenario(ScenarioPath, &parms, InputGain)) == NULL)
+			exit(1);
+		if (Scenario->ev[0].sample == 0) {
+			parms = Scenario->ev[Scenario->next++].parms;
+			SNR_parm = parms.snr;
+			Chan_type = parms.simform;
+			Noise_type = parms.noisetype;
+			ChannelBW = parms.bandwidth;
+			Amplitude = parms.amplitude;
+			FreqOffset = parms.offset;
+			FreqDrift = parms.drift;
+			DopplerDirect = parms.doppler0;
+			DopplerDelayed = parms.doppler1;
+			Hilbert = parms.hilbert;
+		}
+	}
+#endif
+
 	// Scale amplitude (set by user) with input gain
 	Amplitude *= InputGain;
 
 	fprintf(stderr, "Simulating %s-type HF Channel\n", HF_Channel_type[Chan_type]);
-	fprintf(stderr, "\tS/N ratio = %.1f dB (%s)\n", SNR_parm, HF_Noise[Noise_type]);
+	if (NumSnrs > 1)
+		fprintf(stderr, "\tS/N ratio = %.1f ... %.1f dB, %d interleaved outputs (%s)\n",
+			Snrs[0], Snrs[NumSnrs - 1], NumSnrs, HF_Noise[Noise_type]);
+	else
+		fprintf(stderr, "\tS/N ratio = %.1f dB (%s)\n", SNR_parm, HF_Noise[Noise_type]);
 	fprintf(stderr, "\tNoise bandwidth = %.1f Hz\n", ChannelBW);
 	fprintf(stderr, "\tSignal amplitude = %.3f%s\n", Amplitude,
 		Amplitude == 0.0 ? " (calculated at runtime)" : "");
 	fprintf(stderr, "\tFrequency offset = %.1f Hz\n", FreqOffset);
-	fprintf(stderr, "\tSample rate = %d sps\n", SampleRate);
+	if (FreqDrift != 0.0F)
+		fprintf(stderr, "\tFrequency drift = %.3f Hz/s\n", FreqDrift);
+	if (DopplerDirect != 0.0F || DopplerDelayed != 0.0F)
+		fprintf(stderr, "\tDoppler shift = %.2f Hz / %.2f Hz\n", DopplerDirect, DopplerDelayed);
+	fprintf(stderr, "\tSample rate = %d sps%s\n", SampleRate, IQMode ? " (IQ)" : "");
+	if (!IQMode && Hilbert != FILTER_FIR)
+		fprintf(stderr, "\tHilbert transformer = IIR all-pass%s\n",
+			Hilbert == FILTER_IIR_BAND ? " with band pass" : "");
+#ifdef USE_QRM
+	if (QrmPath)
+		fprintf(stderr, "\tInterference from %s\n", QrmPath);
+#endif
+#ifdef USE_SCENARIO
+	if (Scenario)
+		fprintf(stderr, "\tScenario %s, %d changes\n", ScenarioPath,
+			Scenario->n - Scenario->next);
+#endif
+#ifdef USE_SKEW
+	if (SkewPpm != 0.0 || SkewDrift != 0.0)
+		fprintf(stderr, "\tSample clock offset = %.1f ppm, drift %.2f ppm/h\n", SkewPpm, SkewDrift);
+#endif
 	fprintf(stderr, "\t%s ", IO_usage[IO_type]);
 	if (IO_type == 0)
 		fprintf(stderr, "(frequency = %.1f Hz)\n", NCOFreq);
@@ -604,8 +1709,6 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "\n");
 
 
-	delta = 2.0F * (float)M_PI * NCOFreq / SampleRate;
-
 	// Initialize the audio hardware to selected sampling rate
 	// also Mono and signed 16 bit quantization.
 	if (IO_type < 2) {
@@ -621,7 +1724,9 @@ int main(int argc, char *argv[])
 			}
 			else {
 				fprintf(stderr, "error audio not available. output will go to stdout as 16 bit mono.\n");
-				usleep_duration = 1000000000UL / SampleRate;
+				// the NCO runs in real time, unless rendering
+				if (Duration == 0.0F)
+					Pace = 1;
 			}
 		}
 	}
@@ -631,46 +1736,164 @@ int main(int argc, char *argv[])
 	_setmode(_fileno(stdout), _O_BINARY);
 #endif
 
-	// Seed the random number generator
-	srand(seed);
-
-	// Initialize HF channel simulation parameters
-	SetParms(SNR_parm, Chan_type);
+	// Initialize the test signal oscillator
+#ifdef USE_FIXED_POINT
+	init_nco_fx(&TestNCO, NCOFreq, 0.0F, (float)SampleRate);
+#else
+	TestNCO = init_nco(NCOFreq, 0.0F, (float)SampleRate);
+	if (!TestNCO) {
+		fprintf(stderr, "NCO initialization failed\n");
+		exit(1);
+	}
+#endif
 
-	// Initialize the noise module
-	Noise = init_noise(Noise_type, (float)SampleRate, ChannelBW);
-	if (!Noise) {
-		fprintf(stderr, "Noise module initialization failed\n");
+	// Initialize HF channel simulation (a snapshot also sets the oscillator)
+	parms.snr = SNR_parm;
+	parms.simform = Chan_type;
+	parms.noisetype = Noise_type;
+	parms.samplerate = SampleRate;
+	parms.bandwidth = ChannelBW;
+	parms.amplitude = Amplitude;
+	parms.offset = FreqOffset;
+	parms.drift = FreqDrift;
+	parms.doppler0 = DopplerDirect;
+	parms.doppler1 = DopplerDelayed;
+	parms.seed = seed;
+	parms.iq = IQMode;
+	parms.hilbert = Hilbert;
+#ifdef USE_FIXED_POINT
+	Channel = init_channel_fx(&parms);
+#else
+	Channel = ResumePath ? resume(&parms, seeded) : init_channel(&parms);
+#endif
+	if (!Channel) {
+		fprintf(stderr, "Channel initialization failed\n");
 		exit(1);
 	}
 
-	// Initialize HF channel Rayleigh fading coefficients
-	GaussInit(FrSpread, TapUpdRate);
+#ifdef USE_CONTROL
+	// Open the control FIFO, settings are kept without the input gain
+	if (ControlPath) {
+		Settings.parms = parms;
+		Settings.parms.amplitude = InputGain != 0.0F ? Amplitude / InputGain : 0.0F;
+		Settings.gain = InputGain;
+		Settings.ramp = 0.0F;
+		Settings.seeded = 0;
+		if ((Control = init_control(ControlPath)) == NULL) {
+			perror("chansim: control FIFO");
+			exit(1);
+		}
+	}
+#endif
 
-	// Initialize tapped delay line channel
-	init_delayline(DelTime, SampleRate);
+#ifdef USE_SHM
+	if (ShmName) {
+		if ((Shm = init_shm_ring(ShmName, BUF_SIZE, (IQMode + 1) * NumSnrs, SampleRate)) == NULL) {
+			perror("chansim: shared-memory ring");
+			exit(1);
+		}
+	}
+#endif
 
-	// Calculate RMS over 256 samples, update every 64 samples
-	RootMeanSqr = init_rms(256, 64);
-	if (!RootMeanSqr) {
-		fprintf(stderr, "RMS initialization failed\n");
-		exit(1);
+#ifdef USE_QRM
+	if (QrmPath) {
+		if ((Qrm = load_qrm(QrmPath, SampleRate, seed)) == NULL)
+			exit(1);
+		channel_set_qrm(Channel, Qrm);
 	}
+#endif
 
-	// Initialize the Hilbert transformer (200...3800Hz @ 8000sps)
-	Filter = init_filter(200.0F / SampleRate, (ChannelBW + 200.0F) / SampleRate);
-	if (!Filter) {
-		fprintf(stderr, "Filter initialization failed\n");
-		exit(1);
+#ifdef USE_TRACE
+	if (TracePath) {
+		if ((Trace = init_trace(TracePath, SampleRate, IQMode)) == NULL) {
+			perror("chansim: trace");
+			exit(1);
+		}
+		channel_set_probe(Channel, trace_probe, Trace);
+	}
+#endif
+
+#ifdef USE_MONITOR
+	if (MonitorPath) {
+		if ((Monitor = init_monitor(MonitorPath, Channel)) == NULL) {
+			fprintf(stderr, "chansim: monitor initialization failed\n");
+			exit(1);
+		}
+#ifdef USE_TRACE
+		if (Trace)
+			channel_set_probe(Channel, probe_both, NULL);
+		else
+#endif
+		channel_set_probe(Channel, monitor_probe, Monitor);
 	}
+#endif
+
+#ifdef USE_PIPELINE
+	if (Pipelined) {
+		if ((Pipeline = init_pipeline(Channel)) == NULL) {
+			fprintf(stderr, "chansim: pipeline initialization failed\n");
+			exit(1);
+		}
+	}
+#endif
+
+#ifdef USE_SKEW
+	if (SkewPpm != 0.0 || SkewDrift != 0.0) {
+		if ((Skew = init_skew(SkewPpm, SkewDrift, SampleRate, (IQMode + 1) * NumSnrs)) == NULL) {
+			fprintf(stderr, "chansim: resampler initialization failed\n");
+			exit(1);
+		}
+	}
+#endif
+
+	if (Duration > 0.0F)
+		total = (long long)((double)Duration * SampleRate + 0.5);
+
+#ifdef USE_SNAPSHOT
+	// -t counts from the start of the first run
+	if (ResumePath) {
+		if (total && total <= Channel->samples) {
+			fprintf(stderr, "chansim: the snapshot is past the end already\n");
+			exit(0);
+		}
+		if (total)
+			total -= Channel->samples;
+		if (IO_type == 2)
+			skip_input(Channel->samples * (IQMode + 1));
+	}
+	if (SnapshotPath) {
+		next_snapshot = Channel->samples + (long long)SNAPSHOT_INTERVAL * SampleRate;
+		signal(SIGINT, on_signal);
+		signal(SIGTERM, on_signal);
+	}
+#ifdef USE_SHM
+	// the readers see the ring closed, also after a signal
+	if (Shm) {
+		signal(SIGINT, on_signal);
+		signal(SIGTERM, on_signal);
+	}
+#endif
+#endif
+
+	clock_now(&start);
 
 	while (1) {
+#ifdef USE_CONTROL
+		if (Control)
+			apply_control();
+#endif
+
 		// Prepare output buffer to minimize delay between
 		// sound card reads and writes. This operation overlap
 		// with the write() function below.
 		//
 		// Fill output buffer
 		size_out = gensig(audio_buf_out, size_in, IO_type);
+#ifdef USE_SKEW
+		// -t counts output samples, which the skewed clock makes more
+		if (total && size_out > total - written)
+			size_out = (int)(total - written);
+#endif
 
 #ifdef USE_SOUND
 		// Wait for a full data buffer -- this is our pacer.
@@ -706,23 +1929,83 @@ int main(int argc, char *argv[])
 		}
 #endif
 
-		// internal test NCO - without soundcard
-		if (IO_type == 0 && audio_fd < 0) {
-			usleep( usleep_duration );
+		// internal test NCO - without soundcard, and File IO.
+		// The block read now is written in the next round, the
+		// last one when the input has ended.
+		if (IO_type == 2 || (IO_type == 0 && audio_fd < 0)) {
 			size_in = BUF_SIZE;
-			if (size_out)
-				fwrite(audio_buf_out, sizeof(int16_t), size_out, stdout);
-		}
-
-		// File IO
-		if (IO_type == 2) {
-			size_in = (int)fread(audio_buf_in, sizeof(int16_t), BUF_SIZE, stdin);
+			if (total && total - written - size_out < size_in)
+				size_in = (int)(total - written - size_out);
+			if (IO_type == 2 && size_in > 0)
+				size_in = (int)fread(audio_buf_in, sizeof(int16_t) * (IQMode + 1), size_in, stdin);
+
+			if (size_out) {
+				if (Pace)
+					pace(&start, written);
+#ifdef USE_SHM
+				if (Shm)
+					shm_ring_write(Shm, audio_buf_out, size_out);
+				else
+#endif
+				fwrite(audio_buf_out, sizeof(int16_t) * (IQMode + 1) * NumSnrs, size_out, stdout);
+				if (Pace)
+					fflush(stdout);
+				written += size_out;
+				if (Duration > 0.0F)
+					progress(&start, written, total, 0);
+			}
 
-			if (size_in == 0)
+#ifdef USE_SNAPSHOT
+			// the block read is not processed yet, the snapshot
+			// is at the end of the output
+			if (Stop)
 				break;
+			if (SnapshotPath && Channel->samples >= next_snapshot) {
+				snapshot();
+				next_snapshot += (long long)SNAPSHOT_INTERVAL * SampleRate;
+			}
+#endif
 
-			fwrite(audio_buf_out, sizeof(int16_t), size_out, stdout);
+			if (size_in <= 0)
+				break;
 		}
 	}
+
+	fflush(stdout);
+	if (Duration > 0.0F)
+		progress(&start, written, total, 1);
+#ifdef USE_SNAPSHOT
+	if (SnapshotPath)
+		snapshot();
+#endif
+#ifdef USE_TRACE
+	if (Trace)
+		clear_trace(Trace);
+#endif
+#ifdef USE_PIPELINE
+	if (Pipeline)
+		clear_pipeline(Pipeline);
+#endif
+#ifdef USE_MONITOR
+	if (Monitor)
+		clear_monitor(Monitor);
+#endif
+#ifdef USE_QRM
+	if (Qrm)
+		clear_qrm(Qrm);
+#endif
+#ifdef USE_SCENARIO
+	if (Scenario)
+		clear_scenario(Scenario);
+#endif
+#ifdef USE_SHM
+	if (Shm)
+		clear_shm_ring(Shm);
+#endif
+#ifdef USE_SKEW
+	if (Skew)
+		clear_skew(Skew);
+#endif
+
 	return 0;
 }
@@ -0,0 +1,372 @@
+//----------------------------------------------------------------------------
+// Mix mode: many transmitters, one receiver, see mix.h.
+//
+// The mix file has one line per transmitter:
+//
+//     # input        settings
+//     station.raw    chan=3 snr=10 ref=1
+//     near.raw       chan=1 level=20 offset=400
+//     far.raw        chan=5 level=-12 offset=-800 doppler0=1
+//
+// The workers (the main thread being one of them) share the transmitters:
+// each reads a chunk of MIX_BLOCKS * CHAN_BLOCK samples from its input
+// and processes it through its channel. Then the main thread adds them
+// up and writes the sum.
+//----------------------------------------------------------------------------
+
+#include "mix.h"
+#include "channel.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define MIX_CHUNK	(MIX_BLOCKS * CHAN_BLOCK)
+
+struct mix_tx_s {
+	char *path;
+	FILE *f;
+	struct chan_settings_s set;
+	float level;			/* at the receiver, in dB */
+	float scale;			/* the level as a voltage ratio */
+	int ref;			/* ref=1 on the line */
+	struct channel_s *ch;
+	int16_t *pcm;
+	float *buf;			/* MIX_CHUNK samples or I/Q pairs */
+	int len;			/* samples read in this chunk */
+};
+
+static int N;				/* transmitters */
+static int Ref;				/* the reference transmitter */
+static int IQ;
+static float Gain;			/* input gain */
+static struct mix_tx_s *Tx;
+
+//----------------------------------------------------------------------------
+// Mix file
+//----------------------------------------------------------------------------
+
+// Take the keys of the mix file off 'line', leaving those of
+// parse_settings(). Returns an error message or NULL.
+static const char *mix_keys(char *line, struct mix_tx_s *t)
+{
+	char *tok, *val, *end;
+	size_t len;
+
+	for (tok = line + strspn(line, " \t"); *tok; tok += len, tok += strspn(tok, " \t")) {
+		len = strcspn(tok, " \t");
+		if (!strncmp(tok, "level=", 6)) {
+			val = tok + 6;
+			t->level = (float)strtod(val, &end);
+		} else if (!strncmp(tok, "ref=", 4)) {
+			val = tok + 4;
+			t->ref = (int)strtol(val, &end, 0);
+		} else {
+			continue;
+		}
+		if (end == val || end != tok + len)
+			return "invalid level or ref";
+		memset(tok, ' ', len);
+	}
+
+	return NULL;
+}
+
+// Parse one "input settings" line into transmitter 'k'. Returns an error
+// message or NULL.
+static const char *tx_settings(char *line, const struct chan_parms_s *defaults, int k)
+{
+	struct mix_tx_s *t = &Tx[k];
+	const char *err;
+	char *path;
+	size_t len;
+
+	line += strspn(line, " \t");
+	len = strcspn(line, " \t");
+	if ((path = malloc(len + 1)) == NULL)
+		return "out of memory";
+	memcpy(path, line, len);
+	path[len] = 0;
+	t->path = path;
+
+	if ((err = mix_keys(line + len, t)) != NULL)
+		return err;
+
+	t->set.parms = *defaults;
+	t->set.parms.seed = defaults->seed + k;
+	t->set.gain = 1.0F;
+	t->set.ramp = 0.0F;
+	t->set.seeded = 0;
+	if ((err = parse_settings(&t->set, line + len)) != NULL)
+		return err;
+
+	// the outputs are added up sample by sample
+	if (t->set.gain != 1.0F)
+		return "the gain is the same for all inputs (-g), see level";
+	if (t->set.parms.samplerate != defaults->samplerate)
+		return "the sample rate is the same for all transmitters";
+	if (t->set.parms.iq != defaults->iq)
+		return "IQ mode is the same for all transmitters";
+
+	return NULL;
+}
+
+static int read_mix(const char *path, const struct chan_parms_s *defaults)
+{
+	char line[CONTROL_LINE];
+	const char *err;
+	void *more;
+	FILE *f;
+	int n, refs = 0, stdins = 0;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror("chansim: mix file");
+		return -1;
+	}
+
+	for (n = 1; fgets(line, sizeof(line), f); n++) {
+		line[strcspn(line, "#\r\n")] = 0;
+		if (line[strspn(line, " \t")] == 0)
+			continue;
+		if ((more = realloc(Tx, (N + 1) * sizeof(struct mix_tx_s))) == NULL) {
+			fclose(f);
+			return -1;
+		}
+		Tx = more;
+		memset(&Tx[N], 0, sizeof(struct mix_tx_s));
+		if ((err = tx_settings(line, defaults, N)) != NULL) {
+			fprintf(stderr, "chansim: %s:%d: %s\n", path, n, err);
+			fclose(f);
+			return -1;
+		}
+		if (Tx[N].ref) {
+			Ref = N;
+			refs++;
+		}
+		stdins += !strcmp(Tx[N].path, "-");
+		N++;
+	}
+
+	fclose(f);
+	if (N == 0) {
+		fprintf(stderr, "chansim: %s: no transmitters\n", path);
+		return -1;
+	}
+	if (refs > 1) {
+		fprintf(stderr, "chansim: %s: more than one reference\n", path);
+		return -1;
+	}
+	if (stdins > 1) {
+		fprintf(stderr, "chansim: %s: stdin is one input only\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Worker pool. Transmitter k belongs to worker k % workers.
+//----------------------------------------------------------------------------
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t Done = PTHREAD_COND_INITIALIZER;
+static int Workers;
+static int Round;			/* chunks started */
+static int Pending;			/* workers still busy with this chunk */
+
+// Read the next chunk of 't' and process it. An input that has ended
+// is silence, so the channel's tail still comes out.
+static void process_tx(struct mix_tx_s *t, struct chan_work_s *work)
+{
+	int w = IQ ? 2 : 1;
+	int i;
+
+	t->len = t->f ? (int)fread(t->pcm, w * sizeof(int16_t), MIX_CHUNK, t->f) : 0;
+	if (t->len < MIX_CHUNK && t->f) {
+		if (ferror(t->f))
+			perror(t->path);
+		if (t->f != stdin)
+			fclose(t->f);
+		t->f = NULL;
+	}
+
+	for (i = 0; i < w * t->len; i++)
+		t->buf[i] = t->pcm[i] * Gain / 32768.0F;
+	memset(t->buf + w * t->len, 0, w * (MIX_CHUNK - t->len) * sizeof(float));
+
+	if (IQ)
+		channel_process_iq_work(t->ch, work, (const float_complex *)t->buf,
+					(float_complex *)t->buf, MIX_CHUNK);
+	else
+		channel_process_work(t->ch, work, t->buf, t->buf, MIX_CHUNK);
+}
+
+static void process_txs(int w, struct chan_work_s *work)
+{
+	int k;
+
+	for (k = w; k < N; k += Workers)
+		process_tx(&Tx[k], work);
+}
+
+static void *worker(void *arg)
+{
+	int w = (int)(intptr_t)arg;
+	struct chan_work_s *work;
+	int round = 0;
+
+	if ((work = malloc(sizeof(struct chan_work_s))) == NULL) {
+		fprintf(stderr, "chansim: worker initialization failed\n");
+		exit(1);
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&Lock);
+		while (Round == round)
+			pthread_cond_wait(&Start, &Lock);
+		round = Round;
+		pthread_mutex_unlock(&Lock);
+
+		process_txs(w, work);
+
+		pthread_mutex_lock(&Lock);
+		if (--Pending == 0)
+			pthread_cond_signal(&Done);
+		pthread_mutex_unlock(&Lock);
+	}
+
+	return NULL;
+}
+
+static void run_chunk(struct chan_work_s *work)
+{
+	pthread_mutex_lock(&Lock);
+	Round++;
+	Pending = Workers - 1;
+	pthread_cond_broadcast(&Start);
+	pthread_mutex_unlock(&Lock);
+
+	process_txs(0, work);
+
+	pthread_mutex_lock(&Lock);
+	while (Pending > 0)
+		pthread_cond_wait(&Done, &Lock);
+	pthread_mutex_unlock(&Lock);
+}
+
+//----------------------------------------------------------------------------
+// Main loop
+//----------------------------------------------------------------------------
+int run_mix(const char *mixfile, int workers, const struct chan_parms_s *defaults,
+	    float gain)
+{
+	struct chan_work_s *work;
+	struct chan_parms_s p;
+	struct mix_tx_s *t;
+	int16_t *pcm;
+	float *sum, x;
+	int w = defaults->iq ? 2 : 1;
+	int i, k, n, clipped;
+	pthread_t tid;
+
+	IQ = defaults->iq;
+	Gain = gain;
+	if (read_mix(mixfile, defaults) < 0)
+		return -1;
+	Workers = (workers < 1) ? 1 : (workers > N ? N : workers);
+
+	sum = malloc(w * MIX_CHUNK * sizeof(float));
+	pcm = malloc(w * MIX_CHUNK * sizeof(int16_t));
+	work = malloc(sizeof(struct chan_work_s));
+	if (!sum || !pcm || !work) {
+		fprintf(stderr, "chansim: out of memory\n");
+		return -1;
+	}
+
+	for (k = 0; k < N; k++) {
+		t = &Tx[k];
+		p = t->set.parms;
+		p.amplitude *= Gain;
+		// the reference's noise is the floor for all
+		if (k != Ref)
+			p.snr = HUGE_VALF;
+		if ((t->ch = init_channel_shared(&p)) == NULL) {
+			fprintf(stderr, "chansim: channel initialization failed\n");
+			return -1;
+		}
+		t->scale = powf(10.0F, t->level / 20.0F);
+		t->buf = malloc(w * MIX_CHUNK * sizeof(float));
+		t->pcm = malloc(w * MIX_CHUNK * sizeof(int16_t));
+		if (!t->buf || !t->pcm) {
+			fprintf(stderr, "chansim: out of memory\n");
+			return -1;
+		}
+		t->f = strcmp(t->path, "-") ? fopen(t->path, "rb") : stdin;
+		if (t->f == NULL) {
+			perror(t->path);
+			return -1;
+		}
+	}
+
+	for (i = 1; i < Workers; i++) {
+		if (pthread_create(&tid, NULL, worker, (void *)(intptr_t)i)) {
+			perror("chansim: pthread_create");
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	fprintf(stderr, "Mix: %d transmitters, %d worker(s)\n", N, Workers);
+	for (k = 0; k < N; k++) {
+		p = Tx[k].set.parms;
+		fprintf(stderr, "\t%s: type %d, level %.1f dB, offset %.1f Hz, seed %u",
+			Tx[k].path, p.simform, Tx[k].level, p.offset, p.seed);
+		if (k == Ref)
+			fprintf(stderr, ", reference: S/N ratio = %.1f dB in %.1f Hz",
+				p.snr, p.bandwidth);
+		fprintf(stderr, "\n");
+	}
+
+	do {
+		run_chunk(work);
+		n = Tx[Ref].len;
+
+		memset(sum, 0, w * n * sizeof(float));
+		for (k = 0; k < N; k++) {
+			t = &Tx[k];
+			for (i = 0; i < w * n; i++)
+				sum[i] += t->buf[i] * t->scale;
+		}
+
+		for (i = clipped = 0; i < w * n; i++) {
+			x = sum[i];
+			if (x > 0.999F || x < -0.999F) {
+				x = (x > 0.0F) ? 0.999F : -0.999F;
+				clipped++;
+			}
+			pcm[i] = (int16_t)(x * 32768.0F);
+		}
+		if (clipped)
+			fprintf(stderr, "chansim: clipping! (%d samples)\n", clipped);
+
+		if (fwrite(pcm, w * sizeof(int16_t), n, stdout) != (size_t)n) {
+			fprintf(stderr, "chansim: write error\n");
+			return -1;
+		}
+	} while (n == MIX_CHUNK);
+
+	fflush(stdout);
+	for (k = 0; k < N; k++) {
+		if (Tx[k].f && Tx[k].f != stdin)
+			fclose(Tx[k].f);
+	}
+	free(sum);
+	free(pcm);
+	free(work);
+
+	return 0;
+}
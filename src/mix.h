@@ -0,0 +1,24 @@
+#ifndef _MIX_H
+#define _MIX_H
+
+#include "channel.h"
+
+#define MIX_BLOCKS	16	/* CHAN_BLOCK blocks read and processed at once */
+
+/*
+ * Mix mode: several transmitters, each going through its own channel,
+ * received together. 'mixfile' holds one line per transmitter: the input
+ * file name ("-" for stdin), then key=value settings like in the daemon
+ * handshake, and level=<dB> to scale its output at the receiver. Settings
+ * not on a line are taken from 'defaults' (amplitude not scaled by
+ * 'gain'), the seed is that of 'defaults' plus the line's index.
+ *
+ * Only the reference transmitter (the line with ref=1, else the first)
+ * adds noise, at its SNR; the others are added without. So the sum has
+ * one noise floor, calibrated against the reference. The output goes to
+ * stdout and ends with the reference's input. Returns nonzero on errors.
+ */
+extern int run_mix(const char *mixfile, int workers, const struct chan_parms_s *defaults,
+		   float gain);
+
+#endif
@@ -0,0 +1,736 @@
+//----------------------------------------------------------------------------
+// Spectrum and fading monitor, see monitor.h.
+//
+// The processing thread collects into a batch of its own (stage) and
+// moves it to the shared batch when it gets the lock without waiting.
+// The monitor thread swaps the shared batch with an empty one once per
+// interval and does all the math on its own time.
+//----------------------------------------------------------------------------
+
+#define _USE_MATH_DEFINES
+
+#include "monitor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define STAGE_FRAMES	8			/* frames kept by the processing thread */
+#define STAGE_GAINS	256			/* and fading updates */
+#define LAGS		64			/* autocorrelation of the fading gains */
+#define LEVEL_MIN	-60.0			/* fading envelope histogram, dB */
+#define LEVEL_STEP	0.25
+#define LEVELS		320
+#define CDF_POINTS	6
+
+static const double CdfLevel[CDF_POINTS] = { -30.0, -20.0, -10.0, -5.0, 0.0, 5.0 };
+
+struct mon_gain_s {
+	long long sample;
+	float_complex g[2];
+};
+
+struct mon_batch_s {
+	float *in, *out;		/* frames of MON_FFT samples, I/Q pairs if iq */
+	int frames, maxframes;
+	struct mon_gain_s *gain;	/* new fading gains */
+	int gains, maxgains;
+	double noise;			/* noise energy */
+	long long noisen;		/* over this many samples */
+	long long samples;		/* processed */
+	long dropped;			/* frames and gains */
+};
+
+struct monitor_s {
+	char *path, *tmp;
+	int prom;
+	int rate, iq, paths;
+	float spread, snr;
+	int tapupdrate;			/* fading updates per second */
+
+	// processing thread
+	struct mon_batch_s stage;
+	int fill;			/* samples of the frame being collected */
+	long skip;			/* samples until the next frame */
+	long gap;
+	float *blk;			/* input of the current block */
+	float *cur_in, *cur_out;	/* the frame being collected */
+	float_complex last;		/* last fading gain seen */
+	int seen;
+
+	// shared
+	struct mon_batch_s shared;
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+
+	// monitor thread
+	struct mon_batch_s work;
+	float win[MON_FFT], cosw[MON_FFT / 2], sinw[MON_FFT / 2];
+	int rev[MON_FFT];
+	double spec_in[MON_FFT], spec_out[MON_FFT];
+	double pin, pout, pnoise;
+	int frames;
+	long long samples;
+	long dropped;
+	long long hist[MON_BINS];
+	long long clipped;
+	long long updates;
+	long long level[2][LEVELS];
+	double power[2];
+	double acf[2][LAGS];		/* autocorrelation by lag */
+	long long pairs[LAGS];		/* summed up in it */
+	float_complex past[2][LAGS];	/* the last LAGS gains, newest at updates % LAGS */
+	long long latest;		/* sample of the last update */
+	int run;			/* updates in a row, none dropped */
+};
+
+//----------------------------------------------------------------------------
+// Batches
+//----------------------------------------------------------------------------
+static int init_batch(struct mon_batch_s *b, int frames, int gains, int w)
+{
+	memset(b, 0, sizeof(*b));
+	b->maxframes = frames;
+	b->maxgains = gains;
+	b->in = malloc(frames * MON_FFT * w * sizeof(float));
+	b->out = malloc(frames * MON_FFT * w * sizeof(float));
+	b->gain = malloc(gains * sizeof(struct mon_gain_s));
+
+	return b->in && b->out && b->gain;
+}
+
+static void clear_batch(struct mon_batch_s *b)
+{
+	free(b->in);
+	free(b->out);
+	free(b->gain);
+}
+
+static void empty_batch(struct mon_batch_s *b)
+{
+	b->frames = b->gains = 0;
+	b->noise = 0.0;
+	b->noisen = b->samples = 0;
+	b->dropped = 0;
+}
+
+// Append 'src' to 'dst', dropping what does not fit.
+static void append_batch(struct mon_batch_s *dst, const struct mon_batch_s *src, int w)
+{
+	size_t fs = MON_FFT * w;
+	int n;
+
+	n = dst->maxframes - dst->frames;
+	if (n > src->frames)
+		n = src->frames;
+	memcpy(dst->in + dst->frames * fs, src->in, n * fs * sizeof(float));
+	memcpy(dst->out + dst->frames * fs, src->out, n * fs * sizeof(float));
+	dst->frames += n;
+	dst->dropped += src->frames - n;
+
+	n = dst->maxgains - dst->gains;
+	if (n > src->gains)
+		n = src->gains;
+	memcpy(dst->gain + dst->gains, src->gain, n * sizeof(struct mon_gain_s));
+	dst->gains += n;
+	dst->dropped += src->gains - n;
+
+	dst->noise += src->noise;
+	dst->noisen += src->noisen;
+	dst->samples += src->samples;
+	dst->dropped += src->dropped;
+}
+
+//----------------------------------------------------------------------------
+// Processing thread
+//----------------------------------------------------------------------------
+void monitor_input(struct monitor_s *m, const float *in, int len)
+{
+	if (m->skip < len)
+		memcpy(m->blk, in, len * (m->iq ? 2 : 1) * sizeof(float));
+}
+
+void monitor_output(struct monitor_s *m, const float *out, int len)
+{
+	struct mon_batch_s *s = &m->stage;
+	int w = m->iq ? 2 : 1;
+	int pos, k;
+
+	for (pos = 0; pos < len; pos += k) {
+		if (m->skip > 0) {
+			k = (m->skip < len - pos) ? (int)m->skip : len - pos;
+			m->skip -= k;
+			continue;
+		}
+
+		k = MON_FFT - m->fill;
+		if (k > len - pos)
+			k = len - pos;
+		memcpy(m->cur_in + m->fill * w, m->blk + pos * w, k * w * sizeof(float));
+		memcpy(m->cur_out + m->fill * w, out + pos * w, k * w * sizeof(float));
+		m->fill += k;
+
+		if (m->fill == MON_FFT) {
+			if (s->frames < s->maxframes) {
+				memcpy(s->in + s->frames * MON_FFT * w, m->cur_in, MON_FFT * w * sizeof(float));
+				memcpy(s->out + s->frames * MON_FFT * w, m->cur_out, MON_FFT * w * sizeof(float));
+				s->frames++;
+			} else {
+				s->dropped++;
+			}
+			m->fill = 0;
+			m->skip = m->gap;
+		}
+	}
+	s->samples += len;
+
+	// hand over, unless the monitor thread has the lock
+	if (pthread_mutex_trylock(&m->lock) == 0) {
+		append_batch(&m->shared, s, w);
+		pthread_mutex_unlock(&m->lock);
+		empty_batch(s);
+	}
+}
+
+void monitor_probe(void *arg, const struct chan_state_s *st)
+{
+	struct monitor_s *m = arg;
+	struct mon_batch_s *s = &m->stage;
+	double e = 0.0;
+	int k;
+
+	for (k = 0; k < (st->iq ? 2 * st->n : st->n); k++)
+		e += st->noise[k] * st->noise[k];
+	s->noise += e;
+	s->noisen += st->n;
+
+	if (m->spread > 0.0F && (!m->seen || crealf(st->fade0) != crealf(m->last) ||
+				 cimagf(st->fade0) != cimagf(m->last))) {
+		m->last = st->fade0;
+		m->seen = 1;
+		if (s->gains < s->maxgains) {
+			s->gain[s->gains].sample = st->sample;
+			s->gain[s->gains].g[0] = st->fade0;
+			s->gain[s->gains].g[1] = st->fade1;
+			s->gains++;
+		} else {
+			s->dropped++;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Monitor thread: statistics
+//----------------------------------------------------------------------------
+
+// In-place radix-2 FFT of MON_FFT points.
+static void fft(const struct monitor_s *m, float *re, float *im)
+{
+	int half, step, i, j, k;
+	float tr, ti, wr, wi;
+
+	for (i = 0; i < MON_FFT; i++) {
+		j = m->rev[i];
+		if (j > i) {
+			tr = re[i]; re[i] = re[j]; re[j] = tr;
+			ti = im[i]; im[i] = im[j]; im[j] = ti;
+		}
+	}
+
+	for (half = 1, step = MON_FFT / 2; half < MON_FFT; half *= 2, step /= 2) {
+		for (k = 0; k < half; k++) {
+			wr = m->cosw[k * step];
+			wi = -m->sinw[k * step];
+			for (i = k; i < MON_FFT; i += 2 * half) {
+				j = i + half;
+				tr = re[j] * wr - im[j] * wi;
+				ti = re[j] * wi + im[j] * wr;
+				re[j] = re[i] - tr;
+				im[j] = im[i] - ti;
+				re[i] += tr;
+				im[i] += ti;
+			}
+		}
+	}
+}
+
+// Add the power spectrum of a frame to 'spec', returns its energy.
+static double spectrum(const struct monitor_s *m, const float *x, double *spec)
+{
+	float re[MON_FFT], im[MON_FFT];
+	double e = 0.0;
+	int i;
+
+	for (i = 0; i < MON_FFT; i++) {
+		if (m->iq) {
+			re[i] = x[2 * i] * m->win[i];
+			im[i] = x[2 * i + 1] * m->win[i];
+			e += x[2 * i] * x[2 * i] + x[2 * i + 1] * x[2 * i + 1];
+		} else {
+			re[i] = x[i] * m->win[i];
+			im[i] = 0.0F;
+			e += x[i] * x[i];
+		}
+	}
+
+	fft(m, re, im);
+	for (i = 0; i < MON_FFT; i++)
+		spec[i] += re[i] * re[i] + im[i] * im[i];
+
+	return e;
+}
+
+static void fading(struct monitor_s *m, const struct mon_gain_s *g)
+{
+	const float_complex *x;
+	double p;
+	int k, b, l, n;
+
+	// dropped updates break the sequence
+	if (m->run && g->sample - m->latest > 2 * m->rate / m->tapupdrate)
+		m->run = 0;
+	m->latest = g->sample;
+	if (m->run < LAGS)
+		m->run++;
+	n = m->run;
+
+	for (l = 0; l < n; l++)
+		m->pairs[l]++;
+
+	for (k = 0; k < m->paths; k++) {
+		p = crealf(g->g[k]) * crealf(g->g[k]) + cimagf(g->g[k]) * cimagf(g->g[k]);
+		m->power[k] += p;
+		b = (p > 0.0) ? (int)floor((10.0 * log10(p) - LEVEL_MIN) / LEVEL_STEP) : 0;
+		if (b < 0)
+			b = 0;
+		if (b >= LEVELS)
+			b = LEVELS - 1;
+		m->level[k][b]++;
+
+		m->past[k][m->updates % LAGS] = g->g[k];
+		for (l = 0; l < n; l++) {
+			x = &m->past[k][(m->updates - l) % LAGS];
+			m->acf[k][l] += crealf(g->g[k]) * crealf(*x) + cimagf(g->g[k]) * cimagf(*x);
+		}
+	}
+	m->updates++;
+}
+
+static void statistics(struct monitor_s *m)
+{
+	const struct mon_batch_s *b = &m->work;
+	int w = m->iq ? 2 : 1;
+	double ein = 0.0, eout = 0.0;
+	float v;
+	int f, i, k;
+
+	for (i = 0; i < MON_FFT; i++)
+		m->spec_in[i] = m->spec_out[i] = 0.0;
+
+	for (f = 0; f < b->frames; f++) {
+		ein += spectrum(m, b->in + f * MON_FFT * w, m->spec_in);
+		eout += spectrum(m, b->out + f * MON_FFT * w, m->spec_out);
+		for (i = 0; i < MON_FFT * w; i++) {
+			v = fabsf(b->out[f * MON_FFT * w + i]);
+			k = (int)(v * MON_BINS);
+			m->hist[k < MON_BINS ? k : MON_BINS - 1]++;
+			if (v >= 0.999F)
+				m->clipped++;
+		}
+	}
+	m->frames = b->frames;
+	m->pin = b->frames ? ein / ((double)b->frames * MON_FFT) : 0.0;
+	m->pout = b->frames ? eout / ((double)b->frames * MON_FFT) : 0.0;
+	m->pnoise = b->noisen ? b->noise / b->noisen : 0.0;
+	m->samples += b->samples;
+	m->dropped += b->dropped;
+
+	for (i = 0; i < b->gains; i++)
+		fading(m, &b->gain[i]);
+}
+
+static double db(double p)
+{
+	return 10.0 * log10(p);
+}
+
+// Spectrum bin 'i' in output order (from -rate/2 in IQ mode) as dB of
+// a full scale tone.
+static double bin_db(const struct monitor_s *m, const double *spec, int i, double *freq)
+{
+	double sw = 0.0, norm;
+	int k;
+
+	for (k = 0; k < MON_FFT; k++)
+		sw += m->win[k];
+
+	if (m->iq) {
+		i = (i + MON_FFT / 2) % MON_FFT;
+		*freq = (double)(i < MON_FFT / 2 ? i : i - MON_FFT) * m->rate / MON_FFT;
+		norm = sw * sw;
+	} else {
+		*freq = (double)i * m->rate / MON_FFT;
+		norm = sw * sw / 4.0;
+	}
+
+	return db(spec[i] / (m->frames * norm));
+}
+
+// Fraction of the fading updates of path 'k' below 'level' dB, relative
+// to the mean power.
+static double cdf(const struct monitor_s *m, int k, double level)
+{
+	double thr = (db(m->power[k] / m->updates) + level - LEVEL_MIN) / LEVEL_STEP;
+	double below = 0.0;
+	int b;
+
+	for (b = 0; b < LEVELS && b < thr; b++)
+		below += (b + 1 <= thr) ? m->level[k][b] : m->level[k][b] * (thr - b);
+
+	return below / m->updates;
+}
+
+// Doppler spread (2 sigma) of a Gaussian spectrum with the same
+// autocorrelation where it falls to one half: rho(t) = exp(-2 (pi sigma t)^2).
+static double spread(const struct monitor_s *m, int k)
+{
+	double dt = 1.0 / m->tapupdrate;
+	double rho, r0, r1;
+	int l;
+
+	if (m->pairs[LAGS - 1] == 0 || m->acf[k][0] <= 0.0)
+		return 0.0;
+
+	for (l = 1; l < LAGS; l++) {
+		r0 = m->acf[k][l - 1] / m->pairs[l - 1] * m->pairs[0] / m->acf[k][0];
+		r1 = m->acf[k][l] / m->pairs[l] * m->pairs[0] / m->acf[k][0];
+		if (r1 <= 0.5) {
+			// lag of rho = 0.5 between l - 1 and l
+			rho = l - 1 + (r0 - 0.5) / (r0 - r1);
+			return sqrt(2.0 * log(2.0)) / (M_PI * rho * dt);
+		}
+	}
+
+	return 0.0;
+}
+
+//----------------------------------------------------------------------------
+// Monitor thread: snapshots
+//----------------------------------------------------------------------------
+
+// JSON has no infinities and NaN
+static void jnum(FILE *f, double x)
+{
+	if (isfinite(x))
+		fprintf(f, "%.6g", x);
+	else
+		fprintf(f, "null");
+}
+
+static void write_json(const struct monitor_s *m, FILE *f)
+{
+	int bins = m->iq ? MON_FFT : MON_FFT / 2 + 1;
+	double freq;
+	int i, k;
+
+	fprintf(f, "{\n  \"time\": %ld,\n  \"rate\": %d,\n  \"iq\": %s,\n",
+		(long)time(NULL), m->rate, m->iq ? "true" : "false");
+	fprintf(f, "  \"samples\": %lld,\n  \"dropped\": %ld,\n", m->samples, m->dropped);
+	fprintf(f, "  \"interval\": {\n    \"frames\": %d,\n    \"input_dbfs\": ", m->frames);
+	jnum(f, db(m->pin));
+	fprintf(f, ",\n    \"output_dbfs\": ");
+	jnum(f, db(m->pout));
+	fprintf(f, ",\n    \"noise_dbfs\": ");
+	jnum(f, db(m->pnoise));
+	fprintf(f, ",\n    \"snr_db\": ");
+	jnum(f, db((m->pout - m->pnoise) / m->pnoise));
+	fprintf(f, ",\n    \"snr_set_db\": %.6g\n  },\n", m->snr);
+
+	fprintf(f, "  \"spectrum\": {\n    \"freq_hz\": [");
+	for (i = 0; i < bins; i++) {
+		bin_db(m, m->spec_in, i, &freq);
+		fprintf(f, "%s%.6g", i ? ", " : "", freq);
+	}
+	fprintf(f, "],\n    \"input_db\": [");
+	for (i = 0; i < bins; i++) {
+		fprintf(f, "%s", i ? ", " : "");
+		jnum(f, bin_db(m, m->spec_in, i, &freq));
+	}
+	fprintf(f, "],\n    \"output_db\": [");
+	for (i = 0; i < bins; i++) {
+		fprintf(f, "%s", i ? ", " : "");
+		jnum(f, bin_db(m, m->spec_out, i, &freq));
+	}
+	fprintf(f, "]\n  },\n");
+
+	fprintf(f, "  \"amplitude\": {\n    \"le\": [");
+	for (i = 0; i < MON_BINS; i++)
+		fprintf(f, "%s%.6g", i ? ", " : "", (i + 1.0) / MON_BINS);
+	fprintf(f, "],\n    \"count\": [");
+	for (i = 0; i < MON_BINS; i++)
+		fprintf(f, "%s%lld", i ? ", " : "", m->hist[i]);
+	fprintf(f, "],\n    \"clipped\": %lld\n  },\n", m->clipped);
+
+	fprintf(f, "  \"fading\": ");
+	if (m->spread <= 0.0F || !m->updates) {
+		fprintf(f, "null\n}\n");
+		return;
+	}
+	fprintf(f, "{\n    \"updates\": %lld,\n    \"spread_set_hz\": %.6g,\n    \"spread_hz\": [",
+		m->updates, m->spread);
+	for (k = 0; k < m->paths; k++)
+		fprintf(f, "%s%.6g", k ? ", " : "", spread(m, k));
+	fprintf(f, "],\n    \"power_db\": [");
+	for (k = 0; k < m->paths; k++)
+		fprintf(f, "%s%.6g", k ? ", " : "", db(m->power[k] / m->updates));
+	fprintf(f, "],\n    \"cdf_level_db\": [");
+	for (i = 0; i < CDF_POINTS; i++)
+		fprintf(f, "%s%.6g", i ? ", " : "", CdfLevel[i]);
+	fprintf(f, "],\n    \"cdf\": [");
+	for (k = 0; k < m->paths; k++) {
+		fprintf(f, "%s[", k ? ", " : "");
+		for (i = 0; i < CDF_POINTS; i++)
+			fprintf(f, "%s%.6g", i ? ", " : "", cdf(m, k, CdfLevel[i]));
+		fprintf(f, "]");
+	}
+	fprintf(f, "],\n    \"cdf_rayleigh\": [");
+	for (i = 0; i < CDF_POINTS; i++)
+		fprintf(f, "%s%.6g", i ? ", " : "", 1.0 - exp(-pow(10.0, CdfLevel[i] / 10.0)));
+	fprintf(f, "]\n  }\n}\n");
+}
+
+// a value and the end of the line, Prometheus style infinities
+static void pval(FILE *f, double x)
+{
+	if (isnan(x))
+		fprintf(f, " NaN\n");
+	else if (isinf(x))
+		fprintf(f, x > 0.0 ? " +Inf\n" : " -Inf\n");
+	else
+		fprintf(f, " %.6g\n", x);
+}
+
+static void prom_head(FILE *f, const char *name, const char *type, const char *help)
+{
+	fprintf(f, "# HELP chansim_%s %s\n# TYPE chansim_%s %s\n", name, help, name, type);
+}
+
+static void write_prom(const struct monitor_s *m, FILE *f)
+{
+	int bins = m->iq ? MON_FFT : MON_FFT / 2 + 1;
+	double freq;
+	long long sum;
+	int i, k;
+
+	prom_head(f, "samples_total", "counter", "Samples processed.");
+	fprintf(f, "chansim_samples_total %lld\n", m->samples);
+	prom_head(f, "monitor_dropped_total", "counter", "Frames and fading updates the monitor dropped.");
+	fprintf(f, "chansim_monitor_dropped_total %ld\n", m->dropped);
+	prom_head(f, "power_dbfs", "gauge", "Mean power over the last interval.");
+	fprintf(f, "chansim_power_dbfs{signal=\"input\"}");
+	pval(f, db(m->pin));
+	fprintf(f, "chansim_power_dbfs{signal=\"output\"}");
+	pval(f, db(m->pout));
+	fprintf(f, "chansim_power_dbfs{signal=\"noise\"}");
+	pval(f, db(m->pnoise));
+	prom_head(f, "snr_db", "gauge", "Achieved SNR over the last interval.");
+	fprintf(f, "chansim_snr_db");
+	pval(f, db((m->pout - m->pnoise) / m->pnoise));
+	prom_head(f, "snr_set_db", "gauge", "SNR set.");
+	fprintf(f, "chansim_snr_set_db %.6g\n", m->snr);
+
+	prom_head(f, "spectrum_db", "gauge", "Power spectrum of the last interval, dB of a full scale tone.");
+	for (i = 0; i < bins; i++) {
+		bin_db(m, m->spec_in, i, &freq);
+		fprintf(f, "chansim_spectrum_db{signal=\"input\",freq=\"%.6g\"}", freq);
+		pval(f, bin_db(m, m->spec_in, i, &freq));
+		fprintf(f, "chansim_spectrum_db{signal=\"output\",freq=\"%.6g\"}", freq);
+		pval(f, bin_db(m, m->spec_out, i, &freq));
+	}
+
+	prom_head(f, "output_amplitude", "histogram", "Output sample magnitudes, full scale is 1.");
+	for (i = 0, sum = 0; i < MON_BINS; i++) {
+		sum += m->hist[i];
+		fprintf(f, "chansim_output_amplitude_bucket{le=\"%.6g\"} %lld\n", (i + 1.0) / MON_BINS, sum);
+	}
+	fprintf(f, "chansim_output_amplitude_bucket{le=\"+Inf\"} %lld\n", sum);
+	fprintf(f, "chansim_output_amplitude_count %lld\n", sum);
+	prom_head(f, "output_clipped_total", "counter", "Output samples at full scale.");
+	fprintf(f, "chansim_output_clipped_total %lld\n", m->clipped);
+
+	if (m->spread <= 0.0F || !m->updates)
+		return;
+	prom_head(f, "fading_updates_total", "counter", "Fading gain updates seen.");
+	fprintf(f, "chansim_fading_updates_total %lld\n", m->updates);
+	prom_head(f, "doppler_spread_hz", "gauge", "Doppler spread (2 sigma), measured and set.");
+	for (k = 0; k < m->paths; k++)
+		fprintf(f, "chansim_doppler_spread_hz{path=\"%d\"} %.6g\n", k, spread(m, k));
+	fprintf(f, "chansim_doppler_spread_hz{path=\"set\"} %.6g\n", m->spread);
+	prom_head(f, "fading_power_db", "gauge", "Mean power of the fading gain.");
+	for (k = 0; k < m->paths; k++)
+		fprintf(f, "chansim_fading_power_db{path=\"%d\"} %.6g\n", k, db(m->power[k] / m->updates));
+	prom_head(f, "fading_envelope_cdf", "gauge", "Fraction of the time below a level relative to the mean power.");
+	for (k = 0; k < m->paths; k++)
+		for (i = 0; i < CDF_POINTS; i++)
+			fprintf(f, "chansim_fading_envelope_cdf{path=\"%d\",level=\"%g\"} %.6g\n",
+				k, CdfLevel[i], cdf(m, k, CdfLevel[i]));
+	for (i = 0; i < CDF_POINTS; i++)
+		fprintf(f, "chansim_fading_envelope_cdf{path=\"rayleigh\",level=\"%g\"} %.6g\n",
+			CdfLevel[i], 1.0 - exp(-pow(10.0, CdfLevel[i] / 10.0)));
+}
+
+static void snapshot(struct monitor_s *m)
+{
+	FILE *f;
+
+	statistics(m);
+
+	if ((f = fopen(m->tmp, "w")) == NULL)
+		return;
+	if (m->prom)
+		write_prom(m, f);
+	else
+		write_json(m, f);
+	if (fclose(f) == 0)
+		rename(m->tmp, m->path);
+}
+
+static void *monitor_thread(void *arg)
+{
+	struct monitor_s *m = arg;
+	struct mon_batch_s b;
+	struct sched_param sp;
+	struct timespec next;
+	int stop = 0;
+
+	// stay out of the way of the processing
+	memset(&sp, 0, sizeof(sp));
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		next.tv_sec += MON_INTERVAL;
+
+		pthread_mutex_lock(&m->lock);
+		while (!m->stop && pthread_cond_timedwait(&m->cond, &m->lock, &next) == 0)
+			;
+		stop = m->stop;
+		b = m->shared;
+		m->shared = m->work;
+		pthread_mutex_unlock(&m->lock);
+
+		m->work = b;
+		snapshot(m);
+		empty_batch(&m->work);
+	}
+
+	return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Set up
+//----------------------------------------------------------------------------
+struct monitor_s *init_monitor(const char *path, const struct channel_s *ch)
+{
+	struct monitor_s *m;
+	pthread_condattr_t ca;
+	size_t len = strlen(path);
+	int w = ch->parms.iq ? 2 : 1;
+	int i, j, r, bits;
+
+	if ((m = calloc(1, sizeof(struct monitor_s))) == NULL)
+		return NULL;
+
+	m->rate = ch->parms.samplerate;
+	m->iq = ch->parms.iq;
+	m->snr = ch->parms.snr;
+	m->spread = ch->FrSpread;
+	m->tapupdrate = ch->TapUpdRate;
+	m->paths = ch->DelTime > 0.0F ? 2 : 1;
+	m->prom = (len > 5 && !strcmp(path + len - 5, ".prom"));
+	m->gap = m->rate / MON_FRAMES - MON_FFT;
+	if (m->gap < 0)
+		m->gap = 0;
+
+	m->path = malloc(len + 1);
+	m->tmp = malloc(len + 5);
+	m->blk = malloc(CHAN_BLOCK * w * sizeof(float));
+	m->cur_in = malloc(MON_FFT * w * sizeof(float));
+	m->cur_out = malloc(MON_FFT * w * sizeof(float));
+	if (!m->path || !m->tmp || !m->blk || !m->cur_in || !m->cur_out ||
+	    !init_batch(&m->stage, STAGE_FRAMES, STAGE_GAINS, w) ||
+	    !init_batch(&m->shared, 2 * MON_FRAMES * MON_INTERVAL, MON_GAINS, w) ||
+	    !init_batch(&m->work, 2 * MON_FRAMES * MON_INTERVAL, MON_GAINS, w)) {
+		clear_batch(&m->stage);
+		clear_batch(&m->shared);
+		clear_batch(&m->work);
+		free(m->path);
+		free(m->tmp);
+		free(m->blk);
+		free(m->cur_in);
+		free(m->cur_out);
+		free(m);
+		return NULL;
+	}
+	strcpy(m->path, path);
+	sprintf(m->tmp, "%s.tmp", path);
+
+	for (i = 0; i < MON_FFT; i++)
+		m->win[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / MON_FFT));
+	for (i = 0; i < MON_FFT / 2; i++) {
+		m->cosw[i] = (float)cos(2.0 * M_PI * i / MON_FFT);
+		m->sinw[i] = (float)sin(2.0 * M_PI * i / MON_FFT);
+	}
+	for (bits = 0; (1 << bits) < MON_FFT; bits++)
+		;
+	for (i = 0; i < MON_FFT; i++) {
+		for (j = 0, r = 0; j < bits; j++)
+			r = 2 * r + ((i >> j) & 1);
+		m->rev[i] = r;
+	}
+
+	pthread_mutex_init(&m->lock, NULL);
+	pthread_condattr_init(&ca);
+	pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+	pthread_cond_init(&m->cond, &ca);
+	pthread_condattr_destroy(&ca);
+	if (pthread_create(&m->thread, NULL, monitor_thread, m)) {
+		m->stop = 1;
+		clear_monitor(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+void clear_monitor(struct monitor_s *m)
+{
+	pthread_mutex_lock(&m->lock);
+	append_batch(&m->shared, &m->stage, m->iq ? 2 : 1);
+	if (!m->stop) {
+		m->stop = 1;
+		pthread_cond_signal(&m->cond);
+		pthread_mutex_unlock(&m->lock);
+		pthread_join(m->thread, NULL);
+	} else {
+		pthread_mutex_unlock(&m->lock);
+	}
+
+	pthread_mutex_destroy(&m->lock);
+	pthread_cond_destroy(&m->cond);
+	clear_batch(&m->stage);
+	clear_batch(&m->shared);
+	clear_batch(&m->work);
+	free(m->path);
+	free(m->tmp);
+	free(m->blk);
+	free(m->cur_in);
+	free(m->cur_out);
+	free(m);
+}
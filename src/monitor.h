@@ -0,0 +1,54 @@
+#ifndef _MONITOR_H
+#define _MONITOR_H
+
+#include "channel.h"
+
+#define MON_FFT		256	/* samples per spectrum frame */
+#define MON_FRAMES	64	/* frames per second at most, the rest is skipped */
+#define MON_GAINS	65536	/* fading updates per interval at most */
+#define MON_BINS	32	/* output amplitude histogram, 0 ... full scale */
+#define MON_INTERVAL	1	/* seconds between snapshots */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Monitor of a running channel. The processing thread hands decimated
+ * input and output frames, the fading gains and the noise power over to
+ * a low priority thread, which writes a snapshot every MON_INTERVAL
+ * seconds: JSON, or the Prometheus text format if the file name ends
+ * in ".prom". The file is replaced as a whole (written next to it and
+ * renamed), so a reader never sees half a snapshot.
+ *
+ * The processing thread never waits: if the monitor thread holds the
+ * hand over lock, the data stays with the processing thread until the
+ * next block, and frames that do not fit are dropped (and counted).
+ *
+ * Per interval: the input and output spectra (Hann window, averaged),
+ * input, output and noise power, the achieved SNR. Since the start:
+ * the output amplitude histogram, the fading envelope CDF and the
+ * measured Doppler spread of each path.
+ */
+struct monitor_s;
+
+/* ---------------------------------------------------------------------- */
+
+/* starts the thread, the settings are taken from 'ch' once */
+extern struct monitor_s *init_monitor(const char *path, const struct channel_s *ch);
+
+/* writes a last snapshot and stops the thread */
+extern void clear_monitor(struct monitor_s *);
+
+/*
+ * A block of up to CHAN_BLOCK samples (I/Q pairs in IQ mode): the input
+ * before and the output after processing. 'in' may be overwritten by
+ * the processing in between.
+ */
+extern void monitor_input(struct monitor_s *, const float *in, int len);
+extern void monitor_output(struct monitor_s *, const float *out, int len);
+
+/* the probe, see channel_set_probe() */
+extern void monitor_probe(void *monitor, const struct chan_state_s *);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _MONITOR_H */
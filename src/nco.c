@@ -0,0 +1,227 @@
+
+#define _USE_MATH_DEFINES
+
+#include "nco.h"
+#include "cplx.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+struct nco_s *init_nco(float freq, float drift, float samplerate)
+{
+	struct nco_s *n;
+
+	if ((n = calloc(1, sizeof(struct nco_s))) == NULL)
+		return NULL;
+
+	n->re = 1.0F;
+	n->im = 0.0F;
+	n->freq = freq;
+	n->drift = drift;
+	n->samplerate = samplerate;
+	n->w = -1.0;
+
+	return n;
+}
+
+void clear_nco(struct nco_s *n)
+{
+	free(n);
+}
+
+/*
+ * The lane phasors at the start of the current period: lane k starts
+ * at phasor * step^k and is advanced by step^NCO_LANES. The step uses
+ * the mean frequency over the period, which keeps the phase at the
+ * period end exact for a linear drift.
+ */
+static void nco_lanes(struct nco_s *n, float *lre, float *lim)
+{
+	double w;
+	int k;
+
+	w = 2.0 * M_PI * (n->freq + 0.5 * n->drift * NCO_PERIOD / n->samplerate) / n->samplerate;
+	if (w != n->w) {
+		n->w = w;
+		n->cw = (float)cos(w);
+		n->sw = (float)sin(w);
+		n->cl = (float)cos(NCO_LANES * w);
+		n->sl = (float)sin(NCO_LANES * w);
+	}
+
+	lre[0] = n->re;
+	lim[0] = n->im;
+	for (k = 1; k < NCO_LANES; k++) {
+		lre[k] = lre[k - 1] * n->cw - lim[k - 1] * n->sw;
+		lim[k] = lre[k - 1] * n->sw + lim[k - 1] * n->cw;
+	}
+}
+
+/*
+ * The phasors of the current period, pre[k] + j pim[k] for its samples
+ * k = 0 ... NCO_PERIOD, the last one being the start of the next.
+ */
+static void nco_period(struct nco_s *n, float *pre, float *pim)
+{
+	float lre[NCO_LANES], lim[NCO_LANES];
+	float t;
+	int i, k;
+
+	nco_lanes(n, lre, lim);
+	for (i = 0; i < NCO_PERIOD; i += NCO_LANES) {
+		for (k = 0; k < NCO_LANES; k++) {
+			pre[i + k] = lre[k];
+			pim[i + k] = lim[k];
+
+			t = lre[k] * n->cl - lim[k] * n->sl;
+			lim[k] = lre[k] * n->sl + lim[k] * n->cl;
+			lre[k] = t;
+		}
+	}
+	pre[NCO_PERIOD] = lre[0];
+	pim[NCO_PERIOD] = lim[0];
+}
+
+/*
+ * Start the next period with the phasor pulled back to unity.
+ * Rounding errors accumulate only over one period.
+ */
+static void nco_next(struct nco_s *n, float re, float im)
+{
+	float g = 1.0F / sqrtf(re * re + im * im);
+
+	n->re = re * g;
+	n->im = im * g;
+	n->freq += n->drift * NCO_PERIOD / n->samplerate;
+	n->pos = 0;
+}
+
+// A whole period, the same phasors as nco_period() without the table.
+static void nco_mix_period(struct nco_s *n, float_complex *buf)
+{
+	float lre[NCO_LANES], lim[NCO_LANES];
+	float x, y, t;
+	int i, k;
+
+	nco_lanes(n, lre, lim);
+	for (i = 0; i < NCO_PERIOD; i += NCO_LANES) {
+		for (k = 0; k < NCO_LANES; k++) {
+			x = crealf(buf[i + k]);
+			y = cimagf(buf[i + k]);
+			buf[i + k] = make_float_complex(x * lre[k] - y * lim[k],
+							x * lim[k] + y * lre[k]);
+
+			t = lre[k] * n->cl - lim[k] * n->sl;
+			lim[k] = lre[k] * n->sl + lim[k] * n->cl;
+			lre[k] = t;
+		}
+	}
+	nco_next(n, lre[0], lim[0]);
+}
+
+void nco_mix(struct nco_s *n, float_complex *buf, int len)
+{
+	float pre[NCO_PERIOD + 1], pim[NCO_PERIOD + 1];
+	const float *a, *b;
+	float x, y;
+	int i, m;
+
+	while (len > 0) {
+		if (n->pos == 0 && len >= NCO_PERIOD) {
+			nco_mix_period(n, buf);
+			buf += NCO_PERIOD;
+			len -= NCO_PERIOD;
+			continue;
+		}
+
+		// a part of a period
+		nco_period(n, pre, pim);
+		m = NCO_PERIOD - n->pos;
+		if (m > len)
+			m = len;
+		a = pre + n->pos;
+		b = pim + n->pos;
+		for (i = 0; i < m; i++) {
+			x = crealf(buf[i]);
+			y = cimagf(buf[i]);
+			buf[i] = make_float_complex(x * a[i] - y * b[i], x * b[i] + y * a[i]);
+		}
+
+		buf += m;
+		len -= m;
+		if ((n->pos += m) == NCO_PERIOD)
+			nco_next(n, pre[NCO_PERIOD], pim[NCO_PERIOD]);
+	}
+}
+
+void nco_real(struct nco_s *n, float *out, int len)
+{
+	float pre[NCO_PERIOD + 1], pim[NCO_PERIOD + 1];
+	int i, m;
+
+	while (len > 0) {
+		nco_period(n, pre, pim);
+		m = NCO_PERIOD - n->pos;
+		if (m > len)
+			m = len;
+		for (i = 0; i < m; i++)
+			out[i] = pre[n->pos + i];
+
+		out += m;
+		len -= m;
+		if ((n->pos += m) == NCO_PERIOD)
+			nco_next(n, pre[NCO_PERIOD], pim[NCO_PERIOD]);
+	}
+}
+
+void nco_skip(struct nco_s *n, int len)
+{
+	float pre[NCO_PERIOD + 1], pim[NCO_PERIOD + 1];
+	int m;
+
+	while (len > 0) {
+		m = NCO_PERIOD - n->pos;
+		if (m > len)
+			m = len;
+		len -= m;
+		if ((n->pos += m) == NCO_PERIOD) {
+			nco_period(n, pre, pim);
+			nco_next(n, pre[NCO_PERIOD], pim[NCO_PERIOD]);
+		}
+	}
+}
+
+void nco_seek(struct nco_s *n, long long len)
+{
+	long long periods = (n->pos + len) / NCO_PERIOD;
+	double t = (double)(periods * NCO_PERIOD) / n->samplerate;
+	double cycles, w;
+	float re = n->re;
+
+	// phase of the linear chirp over the whole periods, whole cycles
+	// taken out
+	cycles = n->freq * t + 0.5 * n->drift * t * t;
+	w = 2.0 * M_PI * (cycles - floor(cycles));
+	n->freq += n->drift * t;
+	n->pos = (int)((n->pos + len) % NCO_PERIOD);
+
+	n->re = re * (float)cos(w) - n->im * (float)sin(w);
+	n->im = re * (float)sin(w) + n->im * (float)cos(w);
+}
+
+void nco_retune(struct nco_s *n, double freq, double drift)
+{
+	float pre[NCO_PERIOD + 1], pim[NCO_PERIOD + 1];
+	float g;
+
+	// a new period starts at the current phasor
+	if (n->pos > 0) {
+		nco_period(n, pre, pim);
+		g = 1.0F / sqrtf(pre[n->pos] * pre[n->pos] + pim[n->pos] * pim[n->pos]);
+		n->re = pre[n->pos] * g;
+		n->im = pim[n->pos] * g;
+		n->pos = 0;
+	}
+	n->freq = freq;
+	n->drift = drift;
+}
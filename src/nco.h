@@ -0,0 +1,51 @@
+#ifndef _NCO_H
+#define _NCO_H
+
+#include "cplx.h"
+
+#define NCO_LANES	8	/* phasors rotated in parallel within a period */
+#define NCO_PERIOD	128	/* samples per renormalization, multiple of NCO_LANES */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Recursive complex phasor oscillator. The phasor is advanced by one
+ * complex multiply per sample and renormalized once per period of
+ * NCO_PERIOD samples, so no sin/cos is evaluated in the sample loop.
+ * The frequency may drift linearly; it is updated once per period.
+ * The periods are counted from the start, not from the calls, so the
+ * output does not depend on how the samples are cut into blocks.
+ */
+struct nco_s {
+	float re, im;		/* phasor at the start of the current period */
+	double freq;		/* frequency at the start of the period in Hz */
+	double drift;		/* linear frequency drift in Hz/s */
+	double samplerate;
+	int pos;		/* samples of the current period done */
+	double w;		/* phase step the cached rotations are for */
+	float cw, sw, cl, sl;	/* rotation by w and by NCO_LANES * w */
+};
+
+/* ---------------------------------------------------------------------- */
+
+extern struct nco_s *init_nco(float freq, float drift, float samplerate);
+extern void clear_nco(struct nco_s *);
+
+/* multiply buf[] in place with the phasor (frequency shift) */
+extern void nco_mix(struct nco_s *, float_complex *buf, int len);
+
+/* write the real part of the phasor (cosine) to out[] */
+extern void nco_real(struct nco_s *, float *out, int len);
+
+/* advance the phasor by 'len' samples, as nco_mix() would */
+extern void nco_skip(struct nco_s *, int len);
+
+/* the same for any number of samples at once, with one sin/cos */
+extern void nco_seek(struct nco_s *, long long len);
+
+/* new frequency and drift from the next sample on, phase continuous */
+extern void nco_retune(struct nco_s *, double freq, double drift);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _NCO_H */
@@ -7,12 +7,16 @@
 #include <stdlib.h>
 #include <math.h>
 
+static void noise_gauss(struct noise_s *n, float *out, int len);
+static void noise_laplace(struct noise_s *n, float *out, int len);
+static void noise_impulse(struct noise_s *n, float *out, int len);
+
 //----------------------------------------------------------------------------
 // Filter to limit noise to the desired base band bandwidth.
 // 2nd Order Butterworth IIR filter,
 // Code contributed by Tomi Manninen, OH2BNS.
 //----------------------------------------------------------------------------
-struct noise_s *init_noise(int type, float samplerate, float cutoff)
+struct noise_s *init_noise(int type, float samplerate, float cutoff, struct rng_s *rng)
 {
 	struct noise_s *n;
 	double w, bn0, bn1, bn2;
@@ -36,6 +40,19 @@ struct noise_s *init_noise(int type, float samplerate, float cutoff)
 
 	// what kind of noise?
 	n->noisetype = type;
+	n->rng = rng;
+	switch (type) {
+	default:
+	case 0:
+		n->block = noise_gauss;
+		break;
+	case 1:
+		n->block = noise_laplace;
+		break;
+	case 2:
+		n->block = noise_impulse;
+		break;
+	}
 
 	// compensate for power loss in IIR filter
 	n->BGG = 1.0F / sqrtf(2.0F * cutoff / samplerate);
@@ -43,6 +60,11 @@ struct noise_s *init_noise(int type, float samplerate, float cutoff)
 	return n;
 }
 
+void clear_noise(struct noise_s *n)
+{
+	free(n);
+}
+
 static inline float noisefilter(struct noise_s *n, float in)
 {
 	n->xv[0] = n->xv[1];
@@ -61,22 +83,20 @@ static inline float noisefilter(struct noise_s *n, float in)
 }
 
 //----------------------------------------------------------------------------
-// Bandlimited noise generator.
-// Used for adding band-limited Gaussian, La Placian, or impulse noise.
-// Note: noise filter scales automatically for sample rate and channel
-// bandwidth.
+// Unfiltered noise sample of the given type, from noise_draws() uniform
+// random numbers u[].
 //----------------------------------------------------------------------------
-float BandLtdNoise(struct noise_s *n)
+static ALWAYS_INLINE float noise_shape_one(const float *u, const int type)
 {
 	float z = 0.0F;
 
-	switch (n->noisetype) {
+	switch (type) {
 	case 0:					// Gaussian
-		z = sqrtf(-2.0F * logf(RNG()));
-		z *= cosf(2.0F * (float)M_PI * RNG());
+		z = sqrtf(-2.0F * logf(u[0]));
+		z *= cosf(2.0F * (float)M_PI * u[1]);
 		break;
 	case 1:					// La Placian
-		z = RNG();
+		z = u[0];
 		if (z < 0.5F)
 			z = logf(2.0F * z) / (float)M_SQRT2;
 		else
@@ -84,12 +104,106 @@ float BandLtdNoise(struct noise_s *n)
 		break;
 	case 2:					// Impulsive
 		// This only works for SNR <= 5 or so
-		z = (float)(-M_SQRT2) * logf(RNG());
+		z = (float)(-M_SQRT2) * logf(u[0]);
 		// 5 => scratchy, 8 => Geiger
 		if (fabsf(z) <= 8.0F)
 			z = 0.0F;		// choose whatever you fancy.
 		break;
 	}
 
-	return noisefilter(n, z) * n->BGG;
+	return z;
+}
+
+static ALWAYS_INLINE int draws(const int type)
+{
+	return (type == 0) ? 2 : 1;
+}
+
+static ALWAYS_INLINE float noise_source(struct rng_s *rng, const int type)
+{
+	float u[2];
+
+	u[0] = RNG(rng);
+	if (draws(type) > 1)
+		u[1] = RNG(rng);
+
+	return noise_shape_one(u, type);
+}
+
+//----------------------------------------------------------------------------
+// Bandlimited noise generator.
+// Used for adding band-limited Gaussian, La Placian, or impulse noise.
+// Note: noise filter scales automatically for sample rate and channel
+// bandwidth.
+//----------------------------------------------------------------------------
+float BandLtdNoise(struct noise_s *n)
+{
+	return noisefilter(n, noise_source(n->rng, n->noisetype)) * n->BGG;
+}
+
+//----------------------------------------------------------------------------
+// Block generators, one per noise type. The type is a constant here,
+// so there is no switch in the sample loop.
+//----------------------------------------------------------------------------
+static void noise_gauss(struct noise_s *n, float *out, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = noisefilter(n, noise_source(n->rng, 0)) * n->BGG;
+}
+
+static void noise_laplace(struct noise_s *n, float *out, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = noisefilter(n, noise_source(n->rng, 1)) * n->BGG;
+}
+
+static void noise_impulse(struct noise_s *n, float *out, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = noisefilter(n, noise_source(n->rng, 2)) * n->BGG;
+}
+
+//----------------------------------------------------------------------------
+// The same in two steps, which may run on different threads: drawing
+// the random numbers and shaping them. noise_shape() of what
+// noise_draw() returned is what BandLtdNoiseBlock() would give.
+//----------------------------------------------------------------------------
+int noise_draws(const struct noise_s *n)
+{
+	return draws(n->noisetype);
+}
+
+void noise_draw(struct noise_s *n, float *u, int len)
+{
+	int i;
+
+	for (i = 0; i < len * draws(n->noisetype); i++)
+		u[i] = RNG(n->rng);
+}
+
+void noise_shape(struct noise_s *n, const float *u, float *out, int len)
+{
+	int i;
+
+	switch (n->noisetype) {
+	default:
+	case 0:
+		for (i = 0; i < len; i++)
+			out[i] = noisefilter(n, noise_shape_one(u + 2 * i, 0)) * n->BGG;
+		break;
+	case 1:
+		for (i = 0; i < len; i++)
+			out[i] = noisefilter(n, noise_shape_one(u + i, 1)) * n->BGG;
+		break;
+	case 2:
+		for (i = 0; i < len; i++)
+			out[i] = noisefilter(n, noise_shape_one(u + i, 2)) * n->BGG;
+		break;
+	}
 }
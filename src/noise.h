@@ -4,6 +4,8 @@
 #define NZEROS 2
 #define NPOLES 2
 
+struct rng_s;
+
 struct noise_s {
 	float xv[NZEROS + 1];
 	float yv[NPOLES + 1];
@@ -11,9 +13,27 @@ struct noise_s {
 	float bn0, bn1, bn2;
 	int noisetype;
 	float BGG;
+	struct rng_s *rng;
+	/* block generator for noisetype, selected in init_noise() */
+	void (*block)(struct noise_s *n, float *out, int len);
 };
 
-struct noise_s *init_noise(int type, float samplerate, float cutoff);
+struct noise_s *init_noise(int type, float samplerate, float cutoff, struct rng_s *rng);
+void clear_noise(struct noise_s *n);
 float BandLtdNoise(struct noise_s *n);
 
+/*
+ * The same in two steps: noise_draw() takes len * noise_draws() uniform
+ * random numbers, noise_shape() makes len noise samples of them.
+ */
+int noise_draws(const struct noise_s *n);
+void noise_draw(struct noise_s *n, float *u, int len);
+void noise_shape(struct noise_s *n, const float *u, float *out, int len);
+
+/* fill out[] with len samples of band limited noise */
+static inline void BandLtdNoiseBlock(struct noise_s *n, float *out, int len)
+{
+	n->block(n, out, len);
+}
+
 #endif
@@ -0,0 +1,259 @@
+
+#define _USE_MATH_DEFINES
+
+#include "pfb.h"
+#include "cplx.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Root raised cosine with rolloff 'b', 't' in symbols (sub-channel
+ * spacings).
+ */
+static double rrc(double t, double b)
+{
+	double x = 4.0 * b * t;
+
+	if (fabs(t) < 1e-9)
+		return 1.0 - b + 4.0 * b / M_PI;
+	if (fabs(fabs(x) - 1.0) < 1e-9)
+		return b / M_SQRT2 * ((1.0 + 2.0 / M_PI) * sin(M_PI / (4.0 * b)) +
+				      (1.0 - 2.0 / M_PI) * cos(M_PI / (4.0 * b)));
+
+	return (sin(M_PI * t * (1.0 - b)) + x * cos(M_PI * t * (1.0 + b))) /
+	       (M_PI * t * (1.0 - x * x));
+}
+
+struct pfb_s *init_pfb(int m)
+{
+	struct pfb_s *p;
+	double *proto, sum, pwr, t;
+	int cap, i, j, r, bits;
+
+	if (m < 4 || (m & (m - 1)))
+		return NULL;
+
+	if ((p = calloc(1, sizeof(struct pfb_s))) == NULL)
+		return NULL;
+
+	p->m = m;
+	p->d = m / 2;
+	p->len = PFB_TAPS * m;
+	p->aflip = p->sflip = 1;
+	cap = p->len + PFB_SLACK * p->d;
+
+	proto = malloc(p->len * sizeof(double));
+	p->ana = malloc(p->len * sizeof(float));
+	p->syn = malloc(p->len * sizeof(float));
+	p->hre = calloc(cap, sizeof(float));
+	p->him = calloc(cap, sizeof(float));
+	p->are = calloc(cap, sizeof(float));
+	p->aim = calloc(cap, sizeof(float));
+	p->wre = malloc(m * sizeof(float));
+	p->wim = malloc(m * sizeof(float));
+	p->cosw = malloc(m / 2 * sizeof(float));
+	p->sinw = malloc(m / 2 * sizeof(float));
+	p->rev = malloc(m * sizeof(int));
+	if (!proto || !p->ana || !p->syn || !p->hre || !p->him || !p->are ||
+	    !p->aim || !p->wre || !p->wim || !p->cosw || !p->sinw || !p->rev) {
+		free(proto);
+		clear_pfb(p);
+		return NULL;
+	}
+
+	// prototype lowpass, unity gain at DC
+	sum = 0.0;
+	for (i = 0; i < p->len; i++) {
+		t = (i - (p->len - 1) / 2.0) / m;
+		proto[i] = rrc(t, PFB_ROLLOFF);
+		sum += proto[i];
+	}
+	pwr = 0.0;
+	for (i = 0; i < p->len; i++) {
+		proto[i] /= sum;
+		pwr += proto[i] * proto[i];
+	}
+
+	// the synthesis gain makes the frames (d apart) add up to unity
+	for (i = 0; i < p->len; i++) {
+		p->ana[i] = (float)proto[p->len - 1 - i];
+		p->syn[i] = (float)(proto[p->len - 1 - i] * p->d / (m * pwr));
+	}
+	free(proto);
+
+	for (i = 0; i < m / 2; i++) {
+		p->cosw[i] = (float)cos(2.0 * M_PI * i / m);
+		p->sinw[i] = (float)sin(2.0 * M_PI * i / m);
+	}
+
+	for (bits = 0; (1 << bits) < m; bits++)
+		;
+	for (i = 0; i < m; i++) {
+		for (j = 0, r = 0; j < bits; j++)
+			r = 2 * r + ((i >> j) & 1);
+		p->rev[i] = r;
+	}
+
+	return p;
+}
+
+void clear_pfb(struct pfb_s *p)
+{
+	free(p->ana);
+	free(p->syn);
+	free(p->hre);
+	free(p->him);
+	free(p->are);
+	free(p->aim);
+	free(p->wre);
+	free(p->wim);
+	free(p->cosw);
+	free(p->sinw);
+	free(p->rev);
+	free(p);
+
+	return;
+}
+
+int pfb_delay(const struct pfb_s *p)
+{
+	return p->len - p->d;
+}
+
+/*
+ * In-place radix-2 FFT, X[k] = sum x[n] exp(-j 2 pi k n / m).
+ * Swapping re and im gives the inverse transform (not scaled).
+ */
+static void fft(const struct pfb_s *p, float *re, float *im)
+{
+	int m = p->m;
+	int half, step, i, j, k;
+	float tr, ti, wr, wi;
+
+	for (i = 0; i < m; i++) {
+		j = p->rev[i];
+		if (j > i) {
+			tr = re[i]; re[i] = re[j]; re[j] = tr;
+			ti = im[i]; im[i] = im[j]; im[j] = ti;
+		}
+	}
+
+	for (half = 1, step = m / 2; half < m; half *= 2, step /= 2) {
+		for (k = 0; k < half; k++) {
+			wr = p->cosw[k * step];
+			wi = -p->sinw[k * step];
+			for (i = k; i < m; i += 2 * half) {
+				j = i + half;
+				tr = re[j] * wr - im[j] * wi;
+				ti = re[j] * wi + im[j] * wr;
+				re[j] = re[i] - tr;
+				im[j] = im[i] - ti;
+				re[i] += tr;
+				im[i] += ti;
+			}
+		}
+	}
+}
+
+/*
+ * Sub-channel k of a frame is sum x[T - l] h[l] exp(j 2 pi k l / m),
+ * T being the newest input sample. This is the FFT of the history
+ * weighted with the time reversed prototype and folded to m points.
+ * Frames advance by m/2, so the odd bins change sign from frame to
+ * frame; flipping them back brings every sub-channel to baseband.
+ */
+void pfb_analyze(struct pfb_s *p, const float_complex *in, float_complex *sub)
+{
+	int m = p->m, d = p->d, len = p->len;
+	const float *h = p->ana;
+	float *wr = p->wre, *wi = p->wim;
+	float *xr, *xi;
+	int i, q;
+
+	if (p->hpos + len + d > len + PFB_SLACK * d) {
+		memmove(p->hre, p->hre + p->hpos, len * sizeof(float));
+		memmove(p->him, p->him + p->hpos, len * sizeof(float));
+		p->hpos = 0;
+	}
+	xr = p->hre + p->hpos + len;
+	xi = p->him + p->hpos + len;
+	for (i = 0; i < d; i++) {
+		xr[i] = crealf(in[i]);
+		xi[i] = cimagf(in[i]);
+	}
+	p->hpos += d;
+
+	xr = p->hre + p->hpos;
+	xi = p->him + p->hpos;
+	for (i = 0; i < m; i++) {
+		wr[i] = h[i] * xr[i];
+		wi[i] = h[i] * xi[i];
+	}
+	for (q = m; q < len; q += m) {
+		for (i = 0; i < m; i++) {
+			wr[i] += h[q + i] * xr[q + i];
+			wi[i] += h[q + i] * xi[q + i];
+		}
+	}
+
+	fft(p, p->wre, p->wim);
+
+	for (i = 0; i < m; i++) {
+		if (p->aflip && (i & 1))
+			sub[i] = make_float_complex(-p->wre[i], -p->wim[i]);
+		else
+			sub[i] = make_float_complex(p->wre[i], p->wim[i]);
+	}
+	p->aflip ^= 1;
+}
+
+/*
+ * The transpose of pfb_analyze(): inverse FFT of the sub-channels,
+ * weighted with the prototype and added to the last len output samples.
+ * The oldest d of them are complete.
+ */
+void pfb_synthesize(struct pfb_s *p, const float_complex *sub, float_complex *out)
+{
+	int m = p->m, d = p->d, len = p->len;
+	const float *g = p->syn;
+	float *ar, *ai;
+	float vr, vi;
+	int i, q;
+
+	for (i = 0; i < m; i++) {
+		vr = crealf(sub[i]);
+		vi = cimagf(sub[i]);
+		if (p->sflip && (i & 1)) {
+			vr = -vr;
+			vi = -vi;
+		}
+		p->wre[i] = vr;
+		p->wim[i] = vi;
+	}
+	p->sflip ^= 1;
+
+	fft(p, p->wim, p->wre);
+
+	ar = p->are + p->apos;
+	ai = p->aim + p->apos;
+	for (q = 0; q < len; q += m) {
+		for (i = 0; i < m; i++) {
+			ar[q + i] += g[q + i] * p->wre[i];
+			ai[q + i] += g[q + i] * p->wim[i];
+		}
+	}
+
+	for (i = 0; i < d; i++)
+		out[i] = make_float_complex(ar[i], ai[i]);
+
+	p->apos += d;
+	if (p->apos + len > len + PFB_SLACK * d) {
+		memmove(p->are, p->are + p->apos, (len - d) * sizeof(float));
+		memmove(p->aim, p->aim + p->apos, (len - d) * sizeof(float));
+		p->apos = 0;
+	}
+	memset(p->are + p->apos + len - d, 0, d * sizeof(float));
+	memset(p->aim + p->apos + len - d, 0, d * sizeof(float));
+}
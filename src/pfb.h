@@ -0,0 +1,51 @@
+#ifndef _PFB_H
+#define _PFB_H
+
+#include "cplx.h"
+
+#define PFB_TAPS	16	/* prototype taps per polyphase branch */
+#define PFB_ROLLOFF	0.25F	/* excess bandwidth of the prototype */
+#define PFB_SLACK	16	/* frames between two history moves */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Polyphase filter bank with m sub-channels, spaced rate/m apart and
+ * oversampled by two: each sub-channel runs at 2 * rate / m. Sub-channel
+ * k is centered at k * rate / m, k >= m/2 are the negative frequencies.
+ * The prototype is a root raised cosine, so analysis followed by synthesis
+ * reconstructs the input, delayed by pfb_delay() samples.
+ */
+struct pfb_s {
+	int m;			/* sub-channels, FFT size (power of 2) */
+	int d;			/* input samples per frame, m/2 */
+	int len;		/* prototype length, PFB_TAPS * m */
+	int aflip, sflip;	/* negate odd bins in this frame */
+	float *ana;		/* analysis prototype, time reversed */
+	float *syn;		/* synthesis prototype, time reversed */
+	float *hre, *him;	/* input history */
+	int hpos;		/* start of the history */
+	float *are, *aim;	/* overlap-add accumulator */
+	int apos;
+	float *wre, *wim;	/* FFT work, m each */
+	float *cosw, *sinw;	/* twiddle factors, m/2 each */
+	int *rev;		/* bit reversal permutation */
+};
+
+/* ---------------------------------------------------------------------- */
+
+extern struct pfb_s *init_pfb(int m);
+extern void clear_pfb(struct pfb_s *);
+
+/* delay of analysis followed by synthesis */
+extern int pfb_delay(const struct pfb_s *);
+
+/* d input samples in, one sample per sub-channel out */
+extern void pfb_analyze(struct pfb_s *, const float_complex *in, float_complex *sub);
+
+/* one sample per sub-channel in, d output samples out */
+extern void pfb_synthesize(struct pfb_s *, const float_complex *sub, float_complex *out);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _PFB_H */
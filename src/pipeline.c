@@ -0,0 +1,289 @@
+//----------------------------------------------------------------------------
+// Noise and fading on worker threads, see pipeline.h.
+//
+// Slots of PIPE_BLOCKS * CHAN_BLOCK samples go around: the draw thread
+// fills in the fading gains and the uniform random numbers, the shape
+// threads the noise, then the channel takes them. Every stage counts
+// the slots it has done, slot k is in slot[k % PIPE_SLOTS].
+//----------------------------------------------------------------------------
+
+#include "pipeline.h"
+#include "noise.h"
+#include "fade.h"
+#include "fpmode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define SLOT_LEN	(PIPE_BLOCKS * CHAN_BLOCK)
+
+struct pipe_slot_s {
+	float *u[2];			/* uniform random numbers, I and Q noise */
+	float *noise[2];		/* unit noise */
+	float_complex *fade;		/* fade0 and fade1 of each update */
+	int nfade;
+};
+
+struct pipeline_s;
+
+struct shape_arg_s {
+	struct pipeline_s *p;
+	int k;
+};
+
+struct pipeline_s {
+	struct channel_s *ch;
+	struct chan_source_s source;
+	struct pipe_slot_s slot[PIPE_SLOTS];
+	int streams;			/* noise generators, 2 in IQ mode */
+	int fading;
+
+	long drawn;			/* slots done by the draw thread */
+	long shaped[2];			/* by the shape threads */
+	long used;			/* by the channel */
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread[3];
+	struct shape_arg_s shape[2];
+	int threads;
+
+	// the channel's position in slot 'used'
+	int held;
+	int pos;
+	int fpos;
+};
+
+//----------------------------------------------------------------------------
+// Threads
+//----------------------------------------------------------------------------
+
+// Wait until 'ready' slots are there for slot 'k', or stop. Returns 0 on stop.
+static int wait_for(struct pipeline_s *p, const long *ready, long k)
+{
+	int stop;
+
+	pthread_mutex_lock(&p->lock);
+	while (*ready <= k && !p->stop)
+		pthread_cond_wait(&p->cond, &p->lock);
+	stop = p->stop;
+	pthread_mutex_unlock(&p->lock);
+
+	return !stop;
+}
+
+static void done(struct pipeline_s *p, long *count)
+{
+	pthread_mutex_lock(&p->lock);
+	(*count)++;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
+// The kernel's segments: a fading update when due, then the noise up
+// to the next update or the block end. Denormals are off as in the
+// kernel, the fading filters decay like there.
+static void *draw_thread(void *arg)
+{
+	struct pipeline_s *p = arg;
+	struct channel_s *ch = p->ch;
+	int pointsleft = ch->pointsleft;
+	int updrem = ch->updrem;
+	struct pipe_slot_s *s;
+	long k, free_until;
+	int d = noise_draws(ch->noise);
+	int b, i, n, off;
+	fpmode_t mode = denormals_off();
+
+	for (k = 0; ; k++) {
+		// slot k is free once the channel is done with slot k - PIPE_SLOTS
+		free_until = k - PIPE_SLOTS;
+		if (free_until >= 0 && !wait_for(p, &p->used, free_until))
+			break;
+
+		s = &p->slot[k % PIPE_SLOTS];
+		s->nfade = 0;
+		for (b = 0; b < PIPE_BLOCKS; b++) {
+			for (i = 0; i < CHAN_BLOCK; i += n) {
+				n = CHAN_BLOCK - i;
+				if (p->fading) {
+					if (pointsleft <= 0) {
+						FadeGains(ch->fade, s->fade + 2 * s->nfade, s->fade + 2 * s->nfade + 1);
+						s->nfade++;
+						pointsleft = (ch->parms.samplerate + updrem) / ch->TapUpdRate;
+						updrem = (ch->parms.samplerate + updrem) % ch->TapUpdRate;
+					}
+					if (n > pointsleft)
+						n = pointsleft;
+					pointsleft -= n;
+				}
+
+				off = b * CHAN_BLOCK + i;
+				noise_draw(ch->noise, s->u[0] + off * d, n);
+				if (p->streams > 1)
+					noise_draw(ch->noiseq, s->u[1] + off * d, n);
+			}
+		}
+
+		done(p, &p->drawn);
+	}
+
+	denormals_restore(mode);
+	return NULL;
+}
+
+static void *shape_thread(void *arg)
+{
+	struct shape_arg_s *a = arg;
+	struct pipeline_s *p = a->p;
+	struct noise_s *gen = a->k ? p->ch->noiseq : p->ch->noise;
+	struct pipe_slot_s *s;
+	fpmode_t mode = denormals_off();
+	long k;
+
+	for (k = 0; wait_for(p, &p->drawn, k); k++) {
+		s = &p->slot[k % PIPE_SLOTS];
+		noise_shape(gen, s->u[a->k], s->noise[a->k], SLOT_LEN);
+		done(p, &p->shaped[a->k]);
+	}
+
+	denormals_restore(mode);
+	return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Source of the channel, called from the processing thread
+//----------------------------------------------------------------------------
+static struct pipe_slot_s *hold(struct pipeline_s *p)
+{
+	if (!p->held) {
+		wait_for(p, &p->shaped[0], p->used);
+		if (p->streams > 1)
+			wait_for(p, &p->shaped[1], p->used);
+		p->held = 1;
+		p->pos = 0;
+		p->fpos = 0;
+	}
+
+	return &p->slot[p->used % PIPE_SLOTS];
+}
+
+static void pipe_fade(void *arg, float_complex *fade0, float_complex *fade1)
+{
+	struct pipeline_s *p = arg;
+	struct pipe_slot_s *s = hold(p);
+
+	*fade0 = s->fade[2 * p->fpos];
+	*fade1 = s->fade[2 * p->fpos + 1];
+	p->fpos++;
+}
+
+static void pipe_noise(void *arg, float *n, float *nq, int len)
+{
+	struct pipeline_s *p = arg;
+	struct pipe_slot_s *s;
+	int k;
+
+	// CHAN_BLOCK blocks never cross a slot end, other blocks may
+	for (; len > 0; len -= k) {
+		s = hold(p);
+		k = SLOT_LEN - p->pos;
+		if (k > len)
+			k = len;
+		memcpy(n, s->noise[0] + p->pos, k * sizeof(float));
+		n += k;
+		if (nq) {
+			memcpy(nq, s->noise[1] + p->pos, k * sizeof(float));
+			nq += k;
+		}
+		if ((p->pos += k) == SLOT_LEN) {
+			p->held = 0;
+			done(p, &p->used);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Set up
+//----------------------------------------------------------------------------
+struct pipeline_s *init_pipeline(struct channel_s *ch)
+{
+	struct pipeline_s *p;
+	int d = noise_draws(ch->noise);
+	int i, k;
+
+	if ((p = calloc(1, sizeof(struct pipeline_s))) == NULL)
+		return NULL;
+
+	p->ch = ch;
+	p->streams = ch->parms.iq ? 2 : 1;
+	p->fading = (ch->FrSpread > 0.0F);
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->cond, NULL);
+
+	for (i = 0; i < PIPE_SLOTS; i++) {
+		for (k = 0; k < p->streams; k++) {
+			p->slot[i].u[k] = malloc(SLOT_LEN * d * sizeof(float));
+			p->slot[i].noise[k] = malloc(SLOT_LEN * sizeof(float));
+			if (!p->slot[i].u[k] || !p->slot[i].noise[k]) {
+				clear_pipeline(p);
+				return NULL;
+			}
+		}
+		if ((p->slot[i].fade = malloc(2 * SLOT_LEN * sizeof(float_complex))) == NULL) {
+			clear_pipeline(p);
+			return NULL;
+		}
+	}
+
+	if (pthread_create(&p->thread[p->threads], NULL, draw_thread, p)) {
+		clear_pipeline(p);
+		return NULL;
+	}
+	p->threads++;
+	for (k = 0; k < p->streams; k++) {
+		p->shape[k].p = p;
+		p->shape[k].k = k;
+		if (pthread_create(&p->thread[p->threads], NULL, shape_thread, &p->shape[k])) {
+			clear_pipeline(p);
+			return NULL;
+		}
+		p->threads++;
+	}
+
+	p->source.fade = pipe_fade;
+	p->source.noise = pipe_noise;
+	p->source.arg = p;
+	channel_set_source(ch, &p->source);
+
+	return p;
+}
+
+void clear_pipeline(struct pipeline_s *p)
+{
+	int i, k;
+
+	pthread_mutex_lock(&p->lock);
+	p->stop = 1;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+
+	for (i = 0; i < p->threads; i++)
+		pthread_join(p->thread[i], NULL);
+
+	if (p->ch->source == &p->source)
+		channel_set_source(p->ch, NULL);
+
+	for (i = 0; i < PIPE_SLOTS; i++) {
+		for (k = 0; k < 2; k++) {
+			free(p->slot[i].u[k]);
+			free(p->slot[i].noise[k]);
+		}
+		free(p->slot[i].fade);
+	}
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->cond);
+	free(p);
+}
@@ -0,0 +1,33 @@
+#ifndef _PIPELINE_H
+#define _PIPELINE_H
+
+#include "channel.h"
+
+#define PIPE_BLOCKS	8	/* CHAN_BLOCK blocks per slot */
+#define PIPE_SLOTS	4	/* slots made ahead of the channel */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Noise and fading of one channel on worker threads, ahead of the
+ * processing thread. One thread draws the random numbers (and runs the
+ * fading filters) in the kernel's order, one more per noise generator
+ * (two in IQ mode) shapes them into band limited noise. The processing
+ * thread is left with the filters, mixing and I/O.
+ *
+ * The output is the same as without the pipeline, as long as the
+ * channel is not reconfigured.
+ */
+struct pipeline_s;
+
+/* ---------------------------------------------------------------------- */
+
+/* start the threads and make them the channel's source */
+extern struct pipeline_s *init_pipeline(struct channel_s *);
+
+/* stop the threads, the channel must not be processed any more */
+extern void clear_pipeline(struct pipeline_s *);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _PIPELINE_H */
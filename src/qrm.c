@@ -0,0 +1,420 @@
+//----------------------------------------------------------------------------
+// Interference generator, see qrm.h.
+//
+// Every interferer is an NCO (nco.h) mixed onto a real envelope: 1 for
+// carriers and sweeps, the keying of CW, the +-1 of BPSK. The envelope
+// is constant between the events of an interferer (a symbol, a keying
+// edge, the turn of a sweep, a fading update), so a block is cut into
+// segments at these events and each segment is one nco_mix() and one
+// multiply-add with a constant gain. Keying edges and PSK reversals are
+// raised cosine shaped, computed by a phasor recurrence.
+//----------------------------------------------------------------------------
+
+#define _USE_MATH_DEFINES
+
+#include "qrm.h"
+#include "channel.h"
+#include "nco.h"
+#include "fade.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define QRM_LINE	256
+
+struct qrm_one_s {
+	struct qrm_parms_s p;
+	struct nco_s *osc;
+	struct fade_s *fade;		/* NULL without spread */
+	float ampl;			/* level as a voltage ratio */
+	float_complex gain;		/* ampl times the fading gain */
+	int tapupdrate;
+	int pointsleft;			/* samples until the next fading update */
+	int updrem;
+
+	int left;			/* samples until the next event, -1 = none */
+	double clock;			/* fraction of a sample carried over */
+	double base;			/* QRM_FSK: the drifting center frequency */
+	int mark;			/* QRM_CW: key down */
+
+	/* envelope, going from 'from' to 'to' over 'edge' samples */
+	float env, from, to;
+	int t, edge;
+	float cre, cim, rre, rim;	/* phasor of the raised cosine, its step */
+};
+
+struct qrm_s {
+	int n;
+	int samplerate;
+	struct qrm_one_s *q;
+	struct rng_s rng;		/* keying, data and fading */
+	float_complex tmp[CHAN_BLOCK];
+};
+
+//----------------------------------------------------------------------------
+// Interferer lines
+//----------------------------------------------------------------------------
+static const char *const Types[] = { "carrier", "sweep", "cw", "psk", "fsk" };
+
+const char *parse_qrm(struct qrm_parms_s *p, char *line)
+{
+	char *tok, *val;
+	float x;
+	int k;
+
+	memset(p, 0, sizeof(struct qrm_parms_s));
+	p->type = -1;
+	p->freq = 1500.0F;
+	p->rate = 100.0F;
+	p->wpm = 20.0F;
+	p->shift = 170.0F;
+
+	for (tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t")) {
+		if (p->type < 0) {
+			for (k = 0; k < (int)(sizeof(Types) / sizeof(Types[0])); k++)
+				if (!strcmp(tok, Types[k]))
+					p->type = k;
+			if (p->type < 0)
+				return "unknown interferer type";
+			p->baud = (p->type == QRM_FSK) ? 45.45F : 31.25F;
+			p->to = p->freq;
+			continue;
+		}
+		if ((val = strchr(tok, '=')) == NULL)
+			return "expected key=value";
+		*val++ = 0;
+		x = (float)atof(val);
+		if (!strcmp(tok, "freq"))
+			p->freq = x;
+		else if (!strcmp(tok, "level"))
+			p->level = x;
+		else if (!strcmp(tok, "drift"))
+			p->drift = x;
+		else if (!strcmp(tok, "to"))
+			p->to = x;
+		else if (!strcmp(tok, "rate"))
+			p->rate = x;
+		else if (!strcmp(tok, "baud"))
+			p->baud = x;
+		else if (!strcmp(tok, "shift"))
+			p->shift = x;
+		else if (!strcmp(tok, "wpm"))
+			p->wpm = x;
+		else if (!strcmp(tok, "fade"))
+			p->spread = x;
+		else
+			return "unknown key";
+	}
+
+	if (p->type < 0)
+		return "no interferer type";
+	if (p->rate <= 0.0F || p->baud <= 0.0F || p->wpm <= 0.0F || p->spread < 0.0F)
+		return "rate, baud and wpm must be positive, fade not negative";
+
+	return NULL;
+}
+
+//----------------------------------------------------------------------------
+// Envelope
+//----------------------------------------------------------------------------
+
+// Go from the current envelope to 'to' over 'edge' samples.
+static void ramp(struct qrm_one_s *o, float to, int edge)
+{
+	double w;
+
+	o->from = o->env;
+	o->to = to;
+	if (edge < 1 || o->from == to) {
+		o->env = to;
+		o->edge = 0;
+		return;
+	}
+
+	w = M_PI / edge;
+	o->t = 0;
+	o->edge = edge;
+	o->cre = 1.0F;
+	o->cim = 0.0F;
+	o->rre = (float)cos(w);
+	o->rim = (float)sin(w);
+}
+
+// Envelope of the next 'n' samples to buf[].
+static void envelope(struct qrm_one_s *o, float_complex *buf, int n)
+{
+	float d = 0.5F * (o->to - o->from);
+	float t;
+	int k = 0;
+
+	for (; k < n && o->t < o->edge; k++, o->t++) {
+		buf[k] = make_float_complex(o->from + d * (1.0F - o->cre), 0.0F);
+		t = o->cre * o->rre - o->cim * o->rim;
+		o->cim = o->cre * o->rim + o->cim * o->rre;
+		o->cre = t;
+	}
+	if (o->edge && o->t >= o->edge) {
+		o->env = o->to;
+		o->edge = 0;
+	}
+
+	for (; k < n; k++)
+		buf[k] = make_float_complex(o->env, 0.0F);
+}
+
+//----------------------------------------------------------------------------
+// Events
+//----------------------------------------------------------------------------
+
+// Samples until 'seconds' from now, the fraction carried over.
+static int samples(struct qrm_one_s *o, double seconds, int samplerate)
+{
+	double t = o->clock + seconds * samplerate;
+	int n = (int)t;
+
+	o->clock = t - n;
+
+	return (n < 1) ? 1 : n;
+}
+
+// Morse-like keying: dots and dashes, gaps between elements, letters
+// and words. One unit is 1.2 / wpm seconds (PARIS).
+static void key(struct qrm_s *g, struct qrm_one_s *o)
+{
+	double unit = 1.2 / o->p.wpm;
+	int edge = (int)(QRM_EDGE * g->samplerate);
+	int units;
+	float r;
+
+	if (edge > unit * g->samplerate / 2)
+		edge = (int)(unit * g->samplerate / 2);
+
+	o->mark = !o->mark;
+	if (o->mark) {
+		units = (RNG(&g->rng) < 0.5F) ? 1 : 3;
+	} else {
+		r = RNG(&g->rng);
+		units = (r < 0.1F) ? 7 : (r < 0.4F ? 3 : 1);
+	}
+
+	ramp(o, o->mark ? 1.0F : 0.0F, edge);
+	o->left = samples(o, units * unit, g->samplerate);
+}
+
+static void next_event(struct qrm_s *g, struct qrm_one_s *o)
+{
+	double sym = 1.0 / o->p.baud;
+	double span;
+
+	switch (o->p.type) {
+	case QRM_SWEEP:
+		// turn around at the end, exactly there
+		nco_retune(o->osc, (o->osc->drift > 0.0) == (o->p.to > o->p.freq) ? o->p.to : o->p.freq,
+			   -o->osc->drift);
+		span = fabs(o->p.to - o->p.freq) / o->p.rate;
+		o->left = samples(o, span, g->samplerate);
+		break;
+	case QRM_CW:
+		key(g, o);
+		break;
+	case QRM_PSK:
+		// a reversal over the whole symbol, or none
+		o->left = samples(o, sym, g->samplerate);
+		if (RNG(&g->rng) < 0.5F)
+			ramp(o, -o->env, o->left);
+		break;
+	case QRM_FSK:
+		o->left = samples(o, sym, g->samplerate);
+		nco_retune(o->osc, o->base + ((RNG(&g->rng) < 0.5F) ? -0.5 : 0.5) * o->p.shift,
+			   o->osc->drift);
+		o->base += o->p.drift * o->left / g->samplerate;
+		break;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Set up
+//----------------------------------------------------------------------------
+struct qrm_s *init_qrm(const struct qrm_parms_s *p, int n, int samplerate,
+		       unsigned int seed)
+{
+	struct qrm_one_s *o;
+	struct qrm_s *g;
+	float phi;
+	int k;
+
+	if ((g = calloc(1, sizeof(struct qrm_s))) == NULL)
+		return NULL;
+	if ((g->q = calloc(n, sizeof(struct qrm_one_s))) == NULL) {
+		free(g);
+		return NULL;
+	}
+	g->n = n;
+	g->samplerate = samplerate;
+
+	// not the channel's sequence
+	rng_seed(&g->rng, seed ^ 0x51524dU);
+
+	for (k = 0; k < n; k++) {
+		o = &g->q[k];
+		o->p = p[k];
+		o->ampl = powf(10.0F, p[k].level / 20.0F);
+		o->gain = make_float_complex(o->ampl, 0.0F);
+		o->env = 1.0F;
+		o->left = -1;
+		o->base = p[k].freq;
+
+		// random start phase, so carriers of equal frequency add up
+		// like independent ones
+		if ((o->osc = init_nco(p[k].freq, p[k].drift, (float)samplerate)) == NULL) {
+			clear_qrm(g);
+			return NULL;
+		}
+		phi = 2.0F * (float)M_PI * RNG(&g->rng);
+		o->osc->re = cosf(phi);
+		o->osc->im = sinf(phi);
+
+		if (p[k].spread > 0.0F) {
+			o->tapupdrate = (int)(50.0F * p[k].spread + 1.0F);
+			if ((o->fade = GaussInit(p[k].spread, o->tapupdrate, &g->rng)) == NULL) {
+				clear_qrm(g);
+				return NULL;
+			}
+		}
+
+		switch (p[k].type) {
+		case QRM_SWEEP:
+			if (p[k].to != p[k].freq) {
+				o->osc->drift = (p[k].to > p[k].freq) ? p[k].rate : -p[k].rate;
+				o->left = samples(o, fabs(p[k].to - p[k].freq) / p[k].rate, samplerate);
+			} else {
+				o->osc->drift = 0.0;
+			}
+			break;
+		case QRM_CW:
+			o->env = 0.0F;
+			o->left = 0;
+			break;
+		case QRM_PSK:
+		case QRM_FSK:
+			o->left = 0;
+			break;
+		}
+	}
+
+	return g;
+}
+
+void clear_qrm(struct qrm_s *g)
+{
+	int k;
+
+	if (g == NULL)
+		return;
+	for (k = 0; k < g->n; k++) {
+		clear_nco(g->q[k].osc);
+		clear_fade(g->q[k].fade);
+	}
+	free(g->q);
+	free(g);
+}
+
+struct qrm_s *load_qrm(const char *path, int samplerate, unsigned int seed)
+{
+	struct qrm_parms_s p[QRM_MAX];
+	char line[QRM_LINE];
+	const char *err;
+	FILE *f;
+	int k, n = 0;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror(path);
+		return NULL;
+	}
+
+	for (k = 1; fgets(line, sizeof(line), f); k++) {
+		line[strcspn(line, "#\r\n")] = 0;
+		if (line[strspn(line, " \t")] == 0)
+			continue;
+		if (n == QRM_MAX) {
+			fprintf(stderr, "chansim: %s: more than %d interferers\n", path, QRM_MAX);
+			fclose(f);
+			return NULL;
+		}
+		if ((err = parse_qrm(&p[n], line)) != NULL) {
+			fprintf(stderr, "chansim: %s:%d: %s\n", path, k, err);
+			fclose(f);
+			return NULL;
+		}
+		n++;
+	}
+
+	fclose(f);
+	if (n == 0) {
+		fprintf(stderr, "chansim: %s: no interferers\n", path);
+		return NULL;
+	}
+
+	return init_qrm(p, n, samplerate, seed);
+}
+
+//----------------------------------------------------------------------------
+// Generate
+//----------------------------------------------------------------------------
+static void add_one(struct qrm_s *g, struct qrm_one_s *o, float_complex *out, int len)
+{
+	float_complex *tmp = g->tmp;
+	float_complex f1;
+	float gr, gi, x, y;
+	int i, k, n;
+
+	for (i = 0; i < len; i += n) {
+		// Rayleigh fading of its own, the update rate carried over
+		// like in the channel
+		if (o->fade && o->pointsleft <= 0) {
+			FadeGains(o->fade, &o->gain, &f1);
+			o->gain = make_float_complex(crealf(o->gain) * o->ampl,
+						     cimagf(o->gain) * o->ampl);
+			o->pointsleft = (g->samplerate + o->updrem) / o->tapupdrate;
+			o->updrem = (g->samplerate + o->updrem) % o->tapupdrate;
+		}
+		if (o->left == 0)
+			next_event(g, o);
+
+		n = len - i;
+		if (o->fade && n > o->pointsleft)
+			n = o->pointsleft;
+		if (o->left > 0 && n > o->left)
+			n = o->left;
+
+		envelope(o, tmp, n);
+		nco_mix(o->osc, tmp, n);
+
+		gr = crealf(o->gain);
+		gi = cimagf(o->gain);
+		for (k = 0; k < n; k++) {
+			x = crealf(tmp[k]);
+			y = cimagf(tmp[k]);
+			out[i + k] = make_float_complex(crealf(out[i + k]) + x * gr - y * gi,
+							cimagf(out[i + k]) + x * gi + y * gr);
+		}
+
+		if (o->fade)
+			o->pointsleft -= n;
+		if (o->left > 0)
+			o->left -= n;
+	}
+}
+
+void qrm_block(struct qrm_s *g, float_complex *out, int len)
+{
+	int k;
+
+	for (k = 0; k < len; k++)
+		out[k] = make_float_complex(0.0F, 0.0F);
+
+	for (k = 0; k < g->n; k++)
+		add_one(g, &g->q[k], out, len);
+}
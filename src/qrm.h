@@ -0,0 +1,64 @@
+#ifndef _QRM_H
+#define _QRM_H
+
+#include "chansim.h"
+#include "cplx.h"
+
+#define QRM_MAX		64	/* interferers at most */
+#define QRM_EDGE	0.005F	/* raised cosine keying edges in seconds */
+
+#define QRM_CARRIER	0	/* steady carrier */
+#define QRM_SWEEP	1	/* tone swept from freq to 'to' and back */
+#define QRM_CW		2	/* on-off keyed carrier, random Morse-like timing */
+#define QRM_PSK		3	/* BPSK of random data, cosine shaped reversals */
+#define QRM_FSK		4	/* 2-FSK of random data, continuous phase */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * One interferer. The level is relative to the input signal, like the
+ * SNR: an interferer at 0 dB has the power of the signal.
+ */
+struct qrm_parms_s {
+	int type;
+	float freq;		/* Hz, negative frequencies in IQ mode */
+	float level;		/* dB relative to the input signal */
+	float drift;		/* linear drift in Hz/s, not of QRM_SWEEP */
+	float to;		/* QRM_SWEEP: other end of the sweep in Hz */
+	float rate;		/* QRM_SWEEP: sweep rate in Hz/s */
+	float baud;		/* QRM_PSK, QRM_FSK: symbols per second */
+	float shift;		/* QRM_FSK: tone distance in Hz */
+	float wpm;		/* QRM_CW: words per minute */
+	float spread;		/* Doppler spread of its own fading, 0 = none */
+};
+
+/*
+ * Interference generator: a bank of NCOs (see nco.h) with keying
+ * envelopes and fading gains of their own. The random numbers are its
+ * own as well, so the channel's noise and fading stay the same with or
+ * without interference.
+ */
+struct qrm_s;
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Parse a line "<type> key=value ...", the type being carrier, sweep,
+ * cw, psk or fsk, the keys freq, level, drift, to, rate, baud, shift,
+ * wpm and fade. Returns NULL, or an error message. The line is modified.
+ */
+extern const char *parse_qrm(struct qrm_parms_s *p, char *line);
+
+extern struct qrm_s *init_qrm(const struct qrm_parms_s *p, int n, int samplerate,
+			      unsigned int seed);
+
+/* init_qrm() of a file with one line per interferer, # starts a comment */
+extern struct qrm_s *load_qrm(const char *path, int samplerate, unsigned int seed);
+extern void clear_qrm(struct qrm_s *);
+
+/* the sum of all interferers, 'len' up to CHAN_BLOCK samples */
+extern void qrm_block(struct qrm_s *, float_complex *out, int len);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _QRM_H */
@@ -0,0 +1,51 @@
+
+#include "ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct ring_s *init_ring(int len, int window, int width)
+{
+	struct ring_s *r;
+
+	if ((r = calloc(1, sizeof(struct ring_s))) == NULL)
+		return NULL;
+
+	for (r->size = 16; r->size < len || r->size < window; r->size *= 2)
+		;
+	r->mask = r->size - 1;
+	r->window = window;
+	r->width = width;
+	r->pos = 0;
+
+	if ((r->buf = calloc((r->size + window) * width, sizeof(float))) == NULL) {
+		free(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+void clear_ring(struct ring_s *r)
+{
+	free(r->buf);
+	free(r);
+}
+
+/*
+ * The newest min(size) elements are kept, in order. A larger 'dst' has
+ * zeros before them.
+ */
+void ring_copy(struct ring_s *dst, const struct ring_s *src)
+{
+	int n = (src->size < dst->size) ? src->size : dst->size;
+	int w = src->width;
+	int i;
+
+	memset(dst->buf, 0, (dst->size + dst->window) * w * sizeof(float));
+	dst->pos = 0;
+
+	// element by element, the window of src may be shorter than n
+	for (i = n; i > 0; i--)
+		ring_write(dst, src->buf + ((src->pos - i) & src->mask) * w, 1);
+}
@@ -0,0 +1,94 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include <string.h>
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Ring buffer for sample histories (Hilbert transformer input, delay
+ * line, RMS window). The size is a power of two, and the first 'window'
+ * elements are mirrored behind the end. So any 'window' consecutive
+ * elements are contiguous in memory: readers need no wrap checks, there
+ * are no periodic copies, and vectorized loops can read the history in
+ * place. An element is 'width' floats, 1 for real and 2 for complex
+ * samples.
+ */
+struct ring_s {
+	float *buf;		/* (size + window) * width floats */
+	int width;
+	int size;
+	int mask;
+	int window;		/* longest contiguous read */
+	int pos;		/* next element to write */
+};
+
+/* ---------------------------------------------------------------------- */
+
+/* room for 'len' elements of history, cleared */
+extern struct ring_s *init_ring(int len, int window, int width);
+extern void clear_ring(struct ring_s *);
+
+/* copy the newest elements of 'src' (same width) into 'dst' */
+extern void ring_copy(struct ring_s *dst, const struct ring_s *src);
+
+/* append one real sample */
+static inline void ring_put(struct ring_s *r, float x)
+{
+	r->buf[r->pos] = x;
+	if (r->pos < r->window)
+		r->buf[r->size + r->pos] = x;
+	r->pos = (r->pos + 1) & r->mask;
+}
+
+/* append 'n' elements */
+static inline void ring_write(struct ring_s *r, const float *x, int n)
+{
+	int w = r->width;
+	int c;
+
+	while (n > 0) {
+		c = r->size - r->pos;
+		if (c > n)
+			c = n;
+		memcpy(r->buf + r->pos * w, x, c * w * sizeof(float));
+		if (r->pos < r->window)
+			memcpy(r->buf + (r->size + r->pos) * w, x,
+			       ((c < r->window - r->pos) ? c : r->window - r->pos) * w * sizeof(float));
+		r->pos = (r->pos + c) & r->mask;
+		x += c * w;
+		n -= c;
+	}
+}
+
+/* append 'n' zero elements */
+static inline void ring_zero(struct ring_s *r, int n)
+{
+	int w = r->width;
+	int c;
+
+	while (n > 0) {
+		c = r->size - r->pos;
+		if (c > n)
+			c = n;
+		memset(r->buf + r->pos * w, 0, c * w * sizeof(float));
+		if (r->pos < r->window)
+			memset(r->buf + (r->size + r->pos) * w, 0,
+			       ((c < r->window - r->pos) ? c : r->window - r->pos) * w * sizeof(float));
+		r->pos = (r->pos + c) & r->mask;
+		n -= c;
+	}
+}
+
+/*
+ * The 'n' (<= window) consecutive elements, the newest of which was
+ * written 'age' elements before the newest one, oldest first.
+ */
+static inline const float *ring_window(const struct ring_s *r, int n, int age)
+{
+	return r->buf + ((r->pos - age - n) & r->mask) * r->width;
+}
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _RING_H */
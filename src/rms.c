@@ -6,22 +6,22 @@
 #include <stdlib.h>
 #include <math.h>
 
-struct rms_s *init_rms(int len, int interval)
+struct rms_s *init_rms(int len, int interval, int iq)
 {
 	struct rms_s *r;
 
 	if ((r = calloc(1, sizeof(struct rms_s))) == NULL)
 		return NULL;
 
-	if ((r->buffer = calloc(len, sizeof(float))) == NULL) {
+	if ((r->hist = init_ring(len + RMS_BLOCK, len, iq ? 2 : 1)) == NULL) {
 		free(r);
 		return NULL;
 	}
 
-	r->bufferlen = len;
+	r->iq = iq;
+	r->len = len;
 	r->interval = interval;
 	r->counter = 0;
-	r->ptr = 0;
 	r->rms = 0.0F;
 
 	return r;
@@ -29,7 +29,7 @@ struct rms_s *init_rms(int len, int interval)
 
 void clear_rms(struct rms_s *r)
 {
-	free(r->buffer);
+	clear_ring(r->hist);
 	free(r);
 
 	return;
@@ -37,7 +37,7 @@ void clear_rms(struct rms_s *r)
 
 static inline float calculate_rms(const float *buf, int len)
 {
-        float sum, pwr, avg, rms;
+        float sum, pwr, avg, var;
         int i;
 
         sum = 0.0F;
@@ -48,22 +48,78 @@ static inline float calculate_rms(const float *buf, int len)
         }
 
         avg = sum / len;
-        rms = sqrtf(pwr / len - avg * avg);
+        var = pwr / len - avg * avg;
 
-        return rms;
+        // rounding may leave a tiny negative variance, e.g. for DC input
+        return (var > 0.0F) ? sqrtf(var) : 0.0F;
 }
 
-float rms(struct rms_s *r, float input)
+/*
+ * Complex baseband: a carrier at 0 Hz is signal, so the mean is kept.
+ */
+static inline float calculate_rms_iq(const float *buf, int len)
 {
-        r->buffer[r->ptr] = input;
+        float pwr;
+        int i;
+
+        pwr = 0.0F;
+        for (i = 0; i < 2 * len; i++)
+                pwr += buf[i] * buf[i];
 
-        r->ptr = (r->ptr + 1) % r->bufferlen;
+        return sqrtf(pwr / len);
+}
+
+float rms(struct rms_s *r, float input)
+{
+        ring_put(r->hist, input);
 
         if (r->counter++ == r->interval) {
-                r->rms = calculate_rms(r->buffer, r->bufferlen);
+                r->rms = calculate_rms(ring_window(r->hist, r->len, 0), r->len);
                 r->counter = 0;
         }
 
         return r->rms;
 }
 
+/*
+ * Same as calling rms() for every input sample,
+ * the returned values are written to output[].
+ * Blocks of samples go to the window at once, the updates
+ * read it at the sample they are due.
+ */
+void rms_block(struct rms_s *r, const float *input, float *output, int len)
+{
+        int c, i;
+
+        for (; len > 0; len -= c, input += c, output += c) {
+                c = (len < RMS_BLOCK) ? len : RMS_BLOCK;
+                ring_write(r->hist, input, c);
+
+                for (i = 0; i < c; i++) {
+                        if (r->counter++ == r->interval) {
+                                r->rms = calculate_rms(ring_window(r->hist, r->len, c - 1 - i), r->len);
+                                r->counter = 0;
+                        }
+                        output[i] = r->rms;
+                }
+        }
+}
+
+
+void rms_block_iq(struct rms_s *r, const float_complex *input, float *output, int len)
+{
+        int c, i;
+
+        for (; len > 0; len -= c, input += c, output += c) {
+                c = (len < RMS_BLOCK) ? len : RMS_BLOCK;
+                ring_write(r->hist, (const float *)input, c);
+
+                for (i = 0; i < c; i++) {
+                        if (r->counter++ == r->interval) {
+                                r->rms = calculate_rms_iq(ring_window(r->hist, r->len, c - 1 - i), r->len);
+                                r->counter = 0;
+                        }
+                        output[i] = r->rms;
+                }
+        }
+}
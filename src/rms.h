@@ -1,18 +1,25 @@
 #ifndef _RMS_H
 #define _RMS_H
 
+#include "cplx.h"
+#include "ring.h"
+
+#define RMS_BLOCK	512	/* samples written to the window at once */
+
 struct rms_s {
-	float *buffer;  /* ring buffer for previous samples */
-	int bufferlen;
+	struct ring_s *hist;  /* previous samples, I/Q pairs if iq */
+	int iq;
+	int len;
         int interval;  /* number of new samples (= calls to rms()) to update it's return value */
         int counter;
-        int ptr;
         float rms;  /* cached return for rms() */
 };
 
-extern struct rms_s *init_rms(int len, int interval);
+extern struct rms_s *init_rms(int len, int interval, int iq);
 extern void clear_rms(struct rms_s *r);
 
 extern float rms(struct rms_s *r, float input);
+extern void rms_block(struct rms_s *r, const float *input, float *output, int len);
+extern void rms_block_iq(struct rms_s *r, const float_complex *input, float *output, int len);
 
 #endif
@@ -0,0 +1,206 @@
+//----------------------------------------------------------------------------
+// Scenario timelines, see scenario.h.
+//
+// All parsing and all set-ups are done by load_scenario(). At run time an
+// event is one channel_switch() between two kernel calls, cut at its
+// sample; the blocks in between run with the channel as it is.
+//----------------------------------------------------------------------------
+
+#include "scenario.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SCENARIO_LINE	256	/* max length of a line */
+
+static int add_event(struct scenario_s *sc, const struct scenario_event_s *e)
+{
+	void *more;
+
+	if ((more = realloc(sc->ev, (sc->n + 1) * sizeof(struct scenario_event_s))) == NULL)
+		return -1;
+	sc->ev = more;
+	sc->ev[sc->n++] = *e;
+
+	return 0;
+}
+
+// Parse one "time settings" line onto 'set'. Returns an error message
+// or NULL.
+static const char *parse_line(char *line, struct chan_settings_s *set, double *t)
+{
+	const struct chan_parms_s old = set->parms;
+	const char *err;
+	char *end;
+
+	*t = strtod(line, &end);
+	if (end == line || (*end && !strchr(" \t", *end)) || *t < 0.0)
+		return "expected a time in seconds";
+
+	set->ramp = 0.0F;
+	set->seeded = 0;
+	if ((err = parse_settings(set, end)) != NULL)
+		return err;
+
+	if (set->seeded)
+		return "the seed cannot be changed";
+	if (set->gain != 1.0F)
+		return "the gain cannot be changed (-g)";
+	if (set->parms.samplerate != old.samplerate)
+		return "the sample rate cannot be changed";
+	if (set->parms.iq != old.iq)
+		return "IQ mode cannot be changed";
+
+	return NULL;
+}
+
+struct scenario_s *load_scenario(const char *path, const struct chan_parms_s *defaults,
+				 float gain)
+{
+	const double rate = defaults->samplerate;
+	struct scenario_s *sc;
+	struct scenario_event_s e, glide, at;
+	struct chan_settings_s set;
+	char line[SCENARIO_LINE];
+	const char *err = NULL;
+	double t, from;
+	long long last = 0;
+	int gliding = 0;
+	FILE *f;
+	int k;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror(path);
+		return NULL;
+	}
+	if ((sc = calloc(1, sizeof(struct scenario_s))) == NULL) {
+		fclose(f);
+		return NULL;
+	}
+	sc->gain = gain;
+
+	set.parms = *defaults;
+	set.gain = 1.0F;
+	at.sample = 0;
+	at.parms = *defaults;
+	at.ramp = 0.0F;
+
+	for (k = 1; fgets(line, sizeof(line), f); k++) {
+		line[strcspn(line, "#\r\n")] = 0;
+		if (line[strspn(line, " \t")] == 0)
+			continue;
+		if ((err = parse_line(line, &set, &t)) != NULL)
+			break;
+
+		e.sample = (long long)(t * rate + 0.5);
+		e.parms = set.parms;
+		e.ramp = set.ramp;
+		e.prep = NULL;
+		if (e.sample < last) {
+			err = "the times go backwards";
+			break;
+		}
+		last = e.sample;
+
+		// the end of a glide before this line, else the line ends it
+		if (gliding && glide.sample <= e.sample) {
+			if (add_event(sc, &glide) < 0) {
+				err = "out of memory";
+				break;
+			}
+			at = glide;
+		}
+		gliding = 0;
+
+		// an offset glide is a drift from where the offset is now
+		from = at.parms.offset + at.parms.drift * (e.sample - at.sample) / rate;
+		if (e.ramp > 0.0F && (float)from != e.parms.offset) {
+			glide = e;
+			glide.sample = e.sample + (long long)(e.ramp * rate + 0.5);
+			glide.ramp = 0.0F;
+			e.parms.offset = (float)from;
+			e.parms.drift = (float)((glide.parms.offset - from) / e.ramp);
+			gliding = 1;
+		}
+
+		if (add_event(sc, &e) < 0) {
+			err = "out of memory";
+			break;
+		}
+		at = e;
+	}
+	fclose(f);
+
+	if (err) {
+		fprintf(stderr, "chansim: %s:%d: %s\n", path, k, err);
+		clear_scenario(sc);
+		return NULL;
+	}
+	if (gliding && add_event(sc, &glide) < 0) {
+		clear_scenario(sc);
+		return NULL;
+	}
+	if (sc->n == 0) {
+		fprintf(stderr, "chansim: %s: no settings\n", path);
+		clear_scenario(sc);
+		return NULL;
+	}
+
+	// The modules of each event. A fading generator started by an event
+	// is primed from a generator of its own, with the seed of the event.
+	for (k = 0; k < sc->n; k++) {
+		struct chan_parms_s p = sc->ev[k].parms;
+
+		// the first one at 0 s is the start, see main()
+		if (k == 0 && sc->ev[k].sample == 0)
+			continue;
+		p.amplitude *= gain;
+		p.seed += 1 + k;
+		if ((sc->ev[k].prep = init_channel_shared(&p)) == NULL) {
+			fprintf(stderr, "chansim: %s: out of memory\n", path);
+			clear_scenario(sc);
+			return NULL;
+		}
+	}
+
+	return sc;
+}
+
+void clear_scenario(struct scenario_s *sc)
+{
+	int k;
+
+	if (sc == NULL)
+		return;
+	for (k = 0; k < sc->n; k++) {
+		if (sc->ev[k].prep)
+			clear_channel(sc->ev[k].prep);
+	}
+	free(sc->ev);
+	free(sc);
+}
+
+long long scenario_step(struct scenario_s *sc, struct channel_s *ch)
+{
+	const struct scenario_event_s *e;
+	struct chan_parms_s p;
+
+	for (; sc->next < sc->n && sc->ev[sc->next].sample <= ch->samples; sc->next++) {
+		e = &sc->ev[sc->next];
+		p = e->parms;
+		p.amplitude *= sc->gain;
+		if (e->prep == NULL || channel_switch(ch, e->prep, e->ramp) < 0) {
+			fprintf(stderr, "chansim: scenario: reconfiguration failed at %.3f s\n",
+				(double)e->sample / p.samplerate);
+			continue;
+		}
+		fprintf(stderr, "chansim: scenario: %.3f s, type %d, S/N ratio = %.1f dB%s\n",
+			(double)e->sample / p.samplerate, p.simform, p.snr,
+			e->ramp > 0.0F ? " (ramp)" : "");
+	}
+
+	return (sc->next < sc->n) ? sc->ev[sc->next].sample - ch->samples : 0;
+}
@@ -0,0 +1,53 @@
+#ifndef _SCENARIO_H
+#define _SCENARIO_H
+
+#include "channel.h"
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Scenario: a timeline of channel settings, loaded once. Each line of
+ * the file is a time in seconds and key=value settings like on the
+ * control FIFO, changed from the line before:
+ *
+ *     0      chan=3 snr=20
+ *     60     snr=0 offset=50 ramp=30
+ *     90     chan=6
+ *
+ * With ramp=<s> the SNR (in dB) and the frequency offset move to the new
+ * values over that time instead of stepping. The lines are resolved to complete
+ * channel settings when the file is loaded; a glide of the offset
+ * becomes a drift and a second event at its end. The modules each event
+ * needs are set up then too, an event only switches over to them.
+ */
+struct scenario_event_s {
+	long long sample;		/* takes effect before this sample */
+	struct chan_parms_s parms;	/* amplitude not scaled by the gain */
+	float ramp;			/* SNR ramp in seconds, 0 = step */
+	struct channel_s *prep;		/* modules for channel_switch(), NULL at the start */
+};
+
+struct scenario_s {
+	struct scenario_event_s *ev;
+	int n;
+	int next;			/* first event not applied */
+	float gain;			/* input gain */
+};
+
+/*
+ * Load 'path'. Settings not given are those of 'defaults' (amplitude
+ * not scaled by 'gain'). Returns NULL on errors, after a message.
+ */
+extern struct scenario_s *load_scenario(const char *path, const struct chan_parms_s *defaults,
+					float gain);
+extern void clear_scenario(struct scenario_s *);
+
+/*
+ * Apply the events due before the channel's next sample. Returns the
+ * samples up to the next event, or 0 if there is none.
+ */
+extern long long scenario_step(struct scenario_s *, struct channel_s *ch);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _SCENARIO_H */
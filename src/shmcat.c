@@ -0,0 +1,92 @@
+//----------------------------------------------------------------------------
+// chansim-shmcat: example reader of the shared-memory output ring (-O),
+// see shmring.h.
+//
+//     chansim -O hf 15 5 < in.raw &
+//     chansim-shmcat hf | demod1 &
+//     chansim-shmcat -n hf
+//
+// Copies the stream to stdout, or with -n reads the blocks in place and
+// reports their RMS every second. Lost blocks are reported on stderr.
+//----------------------------------------------------------------------------
+
+#include "shmring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+static const char *UsageString =
+"Usage: chansim-shmcat [-n] <name>\n"
+"    -n    no output, report the RMS every second\n";
+
+int main(int argc, char *argv[])
+{
+	const struct shm_header_s *h;
+	struct shm_reader_s *r;
+	const int16_t *data;
+	uint64_t lost = 0;
+	long long samples = 0;
+	double pwr = 0.0;
+	int quiet = 0;
+	int i, n;
+
+	while ((i = getopt(argc, argv, "n")) != EOF) {
+		switch (i) {
+		case 'n':
+			quiet = 1;
+			break;
+		default:
+			fprintf(stderr, "%s", UsageString);
+			return 1;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "%s", UsageString);
+		return 1;
+	}
+
+	if ((r = shm_open_reader(argv[optind])) == NULL) {
+		fprintf(stderr, "chansim-shmcat: %s: no chansim ring\n", argv[optind]);
+		return 1;
+	}
+	h = shm_reader_header(r);
+	fprintf(stderr, "chansim-shmcat: %u sps, %u int16 per sample, %u blocks of %u\n",
+		h->samplerate, h->channels, h->slots, h->block);
+
+	while ((n = shm_read(r, &data, -1)) != SHM_ENDED) {
+		if (n == SHM_OVERRUN) {
+			fprintf(stderr, "chansim-shmcat: overrun, %llu blocks lost\n",
+				(unsigned long long)(shm_reader_lost(r) - lost));
+			lost = shm_reader_lost(r);
+			continue;
+		}
+
+		if (!quiet) {
+			fwrite(data, h->channels * sizeof(int16_t), n, stdout);
+		} else {
+			for (i = 0; i < n * (int)h->channels; i++)
+				pwr += (double)data[i] * data[i];
+		}
+
+		// the block may have been overwritten meanwhile
+		if (shm_reader_check(r) == SHM_OVERRUN)
+			fprintf(stderr, "chansim-shmcat: block overwritten while read\n");
+
+		samples += n;
+		if (quiet && samples >= h->samplerate) {
+			fprintf(stderr, "RMS %.1f dBFS, %llu blocks lost\n",
+				10.0 * log10(pwr / (samples * h->channels) / (32768.0 * 32768.0) + 1e-20),
+				(unsigned long long)shm_reader_lost(r));
+			samples = 0;
+			pwr = 0.0;
+		}
+	}
+
+	fflush(stdout);
+	shm_close_reader(r);
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+//----------------------------------------------------------------------------
+// Shared-memory output ring, the reader library, see shmring.h.
+//
+// Readers only map the ring, the writer knows nothing of them. Waiting
+// for the next block polls the head every SHM_POLL microseconds.
+//----------------------------------------------------------------------------
+
+#include "shmring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_POLL	500	/* microseconds between looks at the head */
+
+struct shm_reader_s {
+	const struct shm_header_s *hdr;
+	size_t size;
+	uint64_t next;			/* block to read next */
+	uint64_t cur;			/* block of the last shm_read() */
+	const struct shm_slot_s *slot;	/* its slot */
+	uint64_t lost;
+};
+
+static const struct shm_slot_s *slot(const struct shm_reader_s *r, uint64_t n)
+{
+	return (const struct shm_slot_s *)((const char *)(r->hdr + 1) +
+					   (n % r->hdr->slots) * r->hdr->stride);
+}
+
+struct shm_reader_s *shm_open_reader(const char *name)
+{
+	const struct shm_header_s *h;
+	struct shm_reader_s *r;
+	struct stat st;
+	char *path;
+	int fd;
+
+	if ((path = malloc(strlen(name) + 2)) == NULL)
+		return NULL;
+	path[0] = '/';
+	strcpy(path + (name[0] != '/'), name);
+	fd = shm_open(path, O_RDONLY, 0);
+	free(path);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct shm_header_s)) {
+		close(fd);
+		return NULL;
+	}
+	h = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED)
+		return NULL;
+
+	if (memcmp(h->magic, SHM_MAGIC, 4) || h->version != SHM_VERSION || h->slots == 0 ||
+	    (size_t)st.st_size < sizeof(struct shm_header_s) + (size_t)h->slots * h->stride) {
+		munmap((void *)h, st.st_size);
+		return NULL;
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	if ((r = calloc(1, sizeof(struct shm_reader_s))) == NULL) {
+		munmap((void *)h, st.st_size);
+		return NULL;
+	}
+	r->hdr = h;
+	r->size = st.st_size;
+	r->next = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	r->cur = SHM_BUSY;
+
+	return r;
+}
+
+void shm_close_reader(struct shm_reader_s *r)
+{
+	if (r == NULL)
+		return;
+	munmap((void *)r->hdr, r->size);
+	free(r);
+}
+
+const struct shm_header_s *shm_reader_header(const struct shm_reader_s *r)
+{
+	return r->hdr;
+}
+
+// Skip to the oldest block the writer is not about to overwrite.
+static int overrun(struct shm_reader_s *r, uint64_t head)
+{
+	uint64_t oldest = head - r->hdr->slots + 1;
+
+	r->lost += oldest - r->next;
+	r->next = oldest;
+
+	return SHM_OVERRUN;
+}
+
+int shm_read(struct shm_reader_s *r, const int16_t **data, int timeout_ms)
+{
+	const struct shm_header_s *h = r->hdr;
+	struct timespec ts = { 0, SHM_POLL * 1000L };
+	const struct shm_slot_s *s;
+	uint64_t head, seq;
+	long waited = 0;
+
+	for (;;) {
+		head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+		if (head > r->next)
+			break;
+		if (__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE))
+			return SHM_ENDED;
+		if (timeout_ms >= 0 && waited >= 1000L * timeout_ms)
+			return 0;
+		nanosleep(&ts, NULL);
+		waited += SHM_POLL;
+	}
+
+	if (head - r->next >= h->slots)
+		return overrun(r, head);
+
+	s = slot(r, r->next);
+	seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+	if (seq != r->next)
+		return overrun(r, __atomic_load_n(&h->head, __ATOMIC_ACQUIRE));
+
+	r->slot = s;
+	r->cur = r->next++;
+	*data = s->data;
+
+	return (int)s->len;
+}
+
+int shm_reader_check(const struct shm_reader_s *r)
+{
+	if (r->slot == NULL)
+		return 0;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return (__atomic_load_n(&r->slot->seq, __ATOMIC_RELAXED) == r->cur) ? 0 : SHM_OVERRUN;
+}
+
+uint64_t shm_reader_lost(const struct shm_reader_s *r)
+{
+	return r->lost;
+}
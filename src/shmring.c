@@ -0,0 +1,155 @@
+//----------------------------------------------------------------------------
+// Shared-memory output ring, the writer, see shmring.h.
+//----------------------------------------------------------------------------
+
+#include "shmring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct shm_ring_s {
+	char *name;
+	struct shm_header_s *hdr;
+	size_t size;
+	uint64_t next;			/* block to publish next */
+};
+
+static char *shm_path(const char *name)
+{
+	char *path;
+
+	if ((path = malloc(strlen(name) + 2)) == NULL)
+		return NULL;
+	path[0] = '/';
+	strcpy(path + (name[0] != '/'), name);
+
+	return path;
+}
+
+static struct shm_slot_s *slot(const struct shm_ring_s *r, uint64_t n)
+{
+	return (struct shm_slot_s *)((char *)(r->hdr + 1) + (n % r->hdr->slots) * r->hdr->stride);
+}
+
+// Mark an old ring of this name closed, so that readers still mapping
+// it (a writer that crashed never closed it) end instead of waiting.
+static void close_old(const char *path)
+{
+	struct shm_header_s *h;
+	struct stat st;
+	int fd;
+
+	if ((fd = shm_open(path, O_RDWR, 0)) < 0)
+		return;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct shm_header_s)) {
+		h = mmap(NULL, sizeof(struct shm_header_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (h != MAP_FAILED) {
+			if (!memcmp(h->magic, SHM_MAGIC, 4) && h->version == SHM_VERSION)
+				__atomic_store_n(&h->closed, 1, __ATOMIC_RELEASE);
+			munmap(h, sizeof(struct shm_header_s));
+		}
+	}
+	close(fd);
+}
+
+struct shm_ring_s *init_shm_ring(const char *name, int block, int channels,
+				 int samplerate)
+{
+	struct shm_ring_s *r;
+	struct shm_header_s *h;
+	uint32_t stride;
+	int fd, err;
+	int i;
+
+	if ((r = calloc(1, sizeof(struct shm_ring_s))) == NULL)
+		return NULL;
+	if ((r->name = shm_path(name)) == NULL) {
+		free(r);
+		return NULL;
+	}
+
+	// slots on cache lines of their own
+	stride = (sizeof(struct shm_slot_s) + block * channels * sizeof(int16_t) + 63) & ~63U;
+	r->size = sizeof(struct shm_header_s) + (size_t)SHM_SLOTS * stride;
+
+	// readers of an old ring keep their mapping, this is a new one
+	close_old(r->name);
+	shm_unlink(r->name);
+	if ((fd = shm_open(r->name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)
+		goto fail;
+	if (ftruncate(fd, r->size) < 0) {
+		err = errno;
+		close(fd);
+		shm_unlink(r->name);
+		errno = err;
+		goto fail;
+	}
+	h = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	err = errno;
+	close(fd);
+	if (h == MAP_FAILED) {
+		shm_unlink(r->name);
+		errno = err;
+		goto fail;
+	}
+	r->hdr = h;
+
+	h->version = SHM_VERSION;
+	h->slots = SHM_SLOTS;
+	h->block = block;
+	h->channels = channels;
+	h->samplerate = samplerate;
+	h->stride = stride;
+	for (i = 0; i < SHM_SLOTS; i++)
+		slot(r, i)->seq = SHM_BUSY;
+
+	// the magic last: a reader seeing it sees the rest
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(h->magic, SHM_MAGIC, 4);
+
+	return r;
+
+fail:
+	free(r->name);
+	free(r);
+	return NULL;
+}
+
+void shm_ring_write(struct shm_ring_s *r, const int16_t *buf, int len)
+{
+	struct shm_header_s *h = r->hdr;
+	struct shm_slot_s *s;
+	int n;
+
+	for (; len > 0; len -= n, buf += n * h->channels) {
+		n = (len < (int)h->block) ? len : (int)h->block;
+		s = slot(r, r->next);
+
+		// seqlock: busy, the samples, then the block number
+		__atomic_store_n(&s->seq, SHM_BUSY, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(s->data, buf, n * h->channels * sizeof(int16_t));
+		s->len = n;
+		__atomic_store_n(&s->seq, r->next, __ATOMIC_RELEASE);
+
+		r->next++;
+		__atomic_store_n(&h->head, r->next, __ATOMIC_RELEASE);
+	}
+}
+
+void clear_shm_ring(struct shm_ring_s *r)
+{
+	if (r == NULL)
+		return;
+
+	__atomic_store_n(&r->hdr->closed, 1, __ATOMIC_RELEASE);
+	munmap(r->hdr, r->size);
+	shm_unlink(r->name);
+	free(r->name);
+	free(r);
+}
@@ -0,0 +1,119 @@
+#ifndef _SHMRING_H
+#define _SHMRING_H
+
+#include <stdint.h>
+
+#define SHM_SLOTS	256	/* blocks in the ring, a power of 2 */
+
+#define SHM_ENDED	(-1)	/* the writer has closed the ring */
+#define SHM_OVERRUN	(-2)	/* blocks were overwritten before they were read */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Shared-memory output ring (POSIX shm_open()). The writer publishes
+ * blocks of 16 bit PCM and never waits; any number of readers map the
+ * ring and read the blocks in place, each at its own pace. A reader
+ * that falls more than the ring behind loses blocks and is told so.
+ *
+ * The shared memory holds the header, then 'slots' slots of 'stride'
+ * bytes: a slot header and up to 'block' samples of 'channels' int16
+ * each (I/Q pairs in IQ mode, one per SNR of a sweep, interleaved):
+ *
+ *     char     magic[4]	"CHSM"
+ *     uint32   version		1
+ *     uint32   slots
+ *     uint32   block		samples per slot at most
+ *     uint32   channels	int16 per sample
+ *     uint32   samplerate
+ *     uint32   stride		bytes per slot
+ *     uint32   closed		nonzero when the writer has ended
+ *     uint64   head		blocks published so far
+ *
+ * Block n is in slot n % slots. The writer sets the slot's sequence
+ * number to SHM_BUSY, writes the samples, sets it to n and then the
+ * head to n + 1. A reader checks the sequence number before and after
+ * using a block: if it is not n any more, the block was overwritten.
+ */
+#define SHM_MAGIC	"CHSM"
+#define SHM_VERSION	1
+#define SHM_BUSY	UINT64_MAX
+
+struct shm_header_s {
+	char magic[4];
+	uint32_t version;
+	uint32_t slots;
+	uint32_t block;
+	uint32_t channels;
+	uint32_t samplerate;
+	uint32_t stride;
+	uint32_t closed;
+	uint64_t head;
+	uint8_t pad[24];		/* to 64 bytes, the slots cache line aligned */
+};
+
+struct shm_slot_s {
+	uint64_t seq;			/* block number, SHM_BUSY while written */
+	uint32_t len;			/* samples */
+	uint32_t pad;
+	int16_t data[];
+};
+
+/* ---------------------------------------------------------------------- */
+
+/* Writer */
+
+struct shm_ring_s;
+
+/*
+ * Create the ring 'name' ("/name", the slash is added if missing).
+ * An old ring of that name, also one left by a writer that crashed, is
+ * marked closed and removed first; readers still mapping it see it
+ * closed. Returns NULL on errors, with errno set.
+ */
+extern struct shm_ring_s *init_shm_ring(const char *name, int block, int channels,
+					int samplerate);
+
+/* publish 'len' samples, in blocks of up to 'block' samples */
+extern void shm_ring_write(struct shm_ring_s *, const int16_t *buf, int len);
+
+/* mark the ring closed and remove its name */
+extern void clear_shm_ring(struct shm_ring_s *);
+
+/* ---------------------------------------------------------------------- */
+
+/* Reader library (shmread.c) */
+
+struct shm_reader_s;
+
+/*
+ * Map the ring 'name' read-only. Reading starts with the next block
+ * published. Returns NULL if there is no ring of this version.
+ */
+extern struct shm_reader_s *shm_open_reader(const char *name);
+extern void shm_close_reader(struct shm_reader_s *);
+
+/* the layout, see above */
+extern const struct shm_header_s *shm_reader_header(const struct shm_reader_s *);
+
+/*
+ * Wait up to 'timeout_ms' (-1 = no limit) for the next block. Returns
+ * its samples with '*data' pointing into the ring, 0 on a timeout,
+ * SHM_ENDED, or SHM_OVERRUN if the reader was too slow: it then goes
+ * on with the oldest block still in the ring. The block stays valid
+ * until it is overwritten, see shm_reader_check().
+ */
+extern int shm_read(struct shm_reader_s *, const int16_t **data, int timeout_ms);
+
+/*
+ * Returns 0 if the block of the last shm_read() is still intact, or
+ * SHM_OVERRUN if the writer has overwritten it while it was used.
+ */
+extern int shm_reader_check(const struct shm_reader_s *);
+
+/* blocks lost to overruns so far */
+extern uint64_t shm_reader_lost(const struct shm_reader_s *);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _SHMRING_H */
@@ -0,0 +1,188 @@
+//----------------------------------------------------------------------------
+// Sample clock skew, see skew.h.
+//
+// Output sample m is interpolated at the input position p(m), which
+// advances by 1 / (1 + ppm / 1e6) per output sample. With n = floor(p)
+// and mu = p - n, it is
+//
+//     y = sum over k of h(k - (SKEW_TAPS / 2 - 1) - mu) * x(n + k)
+//
+// for k = 0 ... SKEW_TAPS - 1. Each h(k - ... - mu) is a polynomial of
+// degree SKEW_ORDER in s = 2 mu - 1, so y is the polynomial in s whose
+// coefficients are SKEW_ORDER + 1 fixed FIR filters of x at n.
+//----------------------------------------------------------------------------
+
+#define _USE_MATH_DEFINES
+
+#include "skew.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define KAISER_BETA	8.0	/* window of the sinc */
+#define FIT_POINTS	64	/* fractions the polynomials are fitted at */
+
+#define M		(SKEW_ORDER + 1)
+
+// Modified Bessel function of the first kind, order 0.
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for (k = 1; k < 50 && term > 1e-12 * sum; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+// The interpolation filter, zero outside +-SKEW_TAPS / 2.
+static double kernel(double t)
+{
+	double r = t / (SKEW_TAPS / 2);
+	double sinc = (fabs(t) < 1e-9) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+
+	if (fabs(r) >= 1.0)
+		return 0.0;
+
+	return sinc * bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / bessel_i0(KAISER_BETA);
+}
+
+//----------------------------------------------------------------------------
+// Least squares fit of the polynomials, normalized to a DC gain of 1 at
+// every fraction. The normal equations are the same for all taps.
+//----------------------------------------------------------------------------
+static void design(struct skew_s *sk)
+{
+	double a[M][M + SKEW_TAPS], h[SKEW_TAPS];
+	double mu, s, sp[M], sum, f;
+	int i, j, k, q;
+
+	memset(a, 0, sizeof(a));
+	for (q = 0; q < FIT_POINTS; q++) {
+		mu = (q + 0.5) / FIT_POINTS;
+		s = 2.0 * mu - 1.0;
+		for (i = 0, sp[0] = 1.0; i + 1 < M; i++)
+			sp[i + 1] = sp[i] * s;
+
+		for (k = 0, sum = 0.0; k < SKEW_TAPS; k++)
+			sum += h[k] = kernel(k - (SKEW_TAPS / 2 - 1) - mu);
+
+		for (i = 0; i < M; i++) {
+			for (j = 0; j < M; j++)
+				a[i][j] += sp[i] * sp[j];
+			for (k = 0; k < SKEW_TAPS; k++)
+				a[i][M + k] += sp[i] * h[k] / sum;
+		}
+	}
+
+	// Gauss-Jordan, the matrix is positive definite
+	for (i = 0; i < M; i++) {
+		for (j = M + SKEW_TAPS - 1; j >= i; j--)
+			a[i][j] /= a[i][i];
+		for (q = 0; q < M; q++) {
+			if (q == i)
+				continue;
+			f = a[q][i];
+			for (j = i; j < M + SKEW_TAPS; j++)
+				a[q][j] -= f * a[i][j];
+		}
+	}
+
+	for (i = 0; i < M; i++)
+		for (k = 0; k < SKEW_TAPS; k++)
+			sk->c[i][k] = (float)a[i][M + k];
+}
+
+struct skew_s *init_skew(double ppm, double drift, int samplerate, int width)
+{
+	struct skew_s *sk;
+
+	if ((sk = calloc(1, sizeof(struct skew_s))) == NULL)
+		return NULL;
+
+	sk->ppm = ppm;
+	sk->drift = drift;
+	sk->samplerate = samplerate;
+	sk->width = width;
+	sk->x = calloc((SKEW_TAPS - 1 + SKEW_BLOCK) * width, sizeof(float));
+	sk->v = calloc(M * SKEW_BLOCK * width, sizeof(float));
+	if (!sk->x || !sk->v) {
+		clear_skew(sk);
+		return NULL;
+	}
+
+	design(sk);
+
+	return sk;
+}
+
+void clear_skew(struct skew_s *sk)
+{
+	free(sk->x);
+	free(sk->v);
+	free(sk);
+}
+
+double skew_ppm(const struct skew_s *sk)
+{
+	double ppm = sk->ppm + sk->drift * sk->inputs / sk->samplerate / 3600.0;
+
+	if (ppm > SKEW_MAX_PPM)
+		return SKEW_MAX_PPM;
+	if (ppm < -SKEW_MAX_PPM)
+		return -SKEW_MAX_PPM;
+	return ppm;
+}
+
+int skew_process(struct skew_s *sk, const float *in, int n, float *out)
+{
+	const int w = sk->width;
+	const double step = 1.0 / (1.0 + skew_ppm(sk) * 1e-6);
+	const float *c, *x0, *x1, *x2, *x3;
+	float *v, s, y;
+	int i, k, m, len, outs = 0;
+
+	// The filters at the n positions of this block, four taps per pass
+	len = n * w;
+	memcpy(sk->x + (SKEW_TAPS - 1) * w, in, len * sizeof(float));
+	for (m = 0; m < M; m++) {
+		v = sk->v + m * len;
+		for (i = 0; i < len; i++)
+			v[i] = 0.0F;
+		for (k = 0; k < SKEW_TAPS; k += 4) {
+			c = &sk->c[m][k];
+			x0 = sk->x + k * w;
+			x1 = x0 + w;
+			x2 = x1 + w;
+			x3 = x2 + w;
+			for (i = 0; i < len; i++)
+				v[i] += c[0] * x0[i] + c[1] * x1[i] + c[2] * x2[i] + c[3] * x3[i];
+		}
+	}
+	memmove(sk->x, sk->x + len, (SKEW_TAPS - 1) * w * sizeof(float));
+
+	// The output samples in this block, one polynomial each
+	for (; sk->pos < n; outs++, out += w) {
+		s = (float)(2.0 * sk->mu - 1.0);
+		for (i = 0; i < w; i++) {
+			v = sk->v + sk->pos * w + i;
+			y = v[(M - 1) * len];
+			for (m = M - 2; m >= 0; m--)
+				y = y * s + v[m * len];
+			out[i] = y;
+		}
+
+		sk->mu += step;
+		k = (int)sk->mu;
+		sk->pos += k;
+		sk->mu -= k;
+	}
+	sk->pos -= n;
+	sk->inputs += n;
+
+	return outs;
+}
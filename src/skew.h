@@ -0,0 +1,59 @@
+#ifndef _SKEW_H
+#define _SKEW_H
+
+#define SKEW_TAPS	32	/* input samples per output sample, a multiple of 4 */
+#define SKEW_ORDER	6	/* degree of the polynomials in the fraction */
+#define SKEW_BLOCK	512	/* input samples per call at most */
+#define SKEW_MAX_PPM	10000.0	/* the offset is limited to 1 %, also by the drift */
+
+/* output samples for 'n' input samples at most */
+#define SKEW_OUT(n)	((n) + (n) / 64 + 2)
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Sample clock skew: the output is the input resampled to a clock
+ * that is 'ppm' parts per million fast (negative: slow), drifting by
+ * 'drift' ppm per hour. So a second of input gives 1 + ppm / 1e6
+ * seconds of output samples.
+ *
+ * A Farrow resampler: the interpolation filter, a Kaiser windowed sinc
+ * of SKEW_TAPS taps, is a polynomial in the fractional position for
+ * each tap. SKEW_ORDER + 1 fixed filters run over the input, and an
+ * output sample is their outputs combined by Horner's rule at its
+ * fraction. The filters run over whole blocks and vectorize.
+ *
+ * The samples are frames of 'width' floats (I/Q pairs, one value per
+ * SNR of a sweep), resampled alike. The output is delayed by
+ * SKEW_TAPS / 2 samples.
+ */
+struct skew_s {
+	double ppm;
+	double drift;		/* ppm per hour */
+	double samplerate;
+	int width;
+	float c[SKEW_ORDER + 1][SKEW_TAPS];	/* coefficients of the filters */
+	float *x;		/* SKEW_TAPS - 1 frames of history, then a block */
+	float *v;		/* filter outputs, SKEW_ORDER + 1 blocks */
+	long long inputs;	/* samples taken so far */
+	int pos;		/* filter output of the next output sample */
+	double mu;		/* and its fraction */
+};
+
+/* ---------------------------------------------------------------------- */
+
+extern struct skew_s *init_skew(double ppm, double drift, int samplerate, int width);
+extern void clear_skew(struct skew_s *);
+
+/*
+ * Resample 'n' (<= SKEW_BLOCK) frames of 'in' to 'out', which has room
+ * for SKEW_OUT(n) frames. Returns the number of frames written.
+ */
+extern int skew_process(struct skew_s *, const float *in, int n, float *out);
+
+/* the current offset in ppm, with the drift */
+extern double skew_ppm(const struct skew_s *);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _SKEW_H */
@@ -0,0 +1,405 @@
+//----------------------------------------------------------------------------
+// Snapshot of the complete channel state, see snapshot.h.
+//
+// The channel is saved module by module, each one behind a byte that
+// tells if it is there. Loading builds a channel from the saved
+// settings and fills in the state, so derived values (coefficients,
+// kernel) are set up as usual.
+//----------------------------------------------------------------------------
+
+#include "snapshot.h"
+#include "filter.h"
+#include "rms.h"
+#include "noise.h"
+#include "fade.h"
+#include "delay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SNAPSHOT_VERSION	3
+
+static const char Magic[4] = { 'C', 'H', 'S', 'S' };
+
+//----------------------------------------------------------------------------
+// Fields and modules. All return 0, or -1 on errors.
+//----------------------------------------------------------------------------
+static int put(FILE *f, const void *p, size_t n)
+{
+	return (fwrite(p, 1, n, f) == n) ? 0 : -1;
+}
+
+static int get(FILE *f, void *p, size_t n)
+{
+	return (fread(p, 1, n, f) == n) ? 0 : -1;
+}
+
+// Presence of a module: saved, and checked against the loaded channel.
+static int put_flag(FILE *f, const void *module)
+{
+	uint8_t b = (module != NULL);
+
+	return put(f, &b, 1);
+}
+
+static int get_flag(FILE *f, const void *module)
+{
+	uint8_t b;
+
+	if (get(f, &b, 1) < 0)
+		return -1;
+
+	return (b == (module != NULL)) ? 0 : -1;
+}
+
+static int put_ring(FILE *f, const struct ring_s *r)
+{
+	int32_t dim[4] = { r->width, r->size, r->window, r->pos };
+	int err = 0;
+
+	err |= put(f, dim, sizeof(dim));
+	err |= put(f, r->buf, (size_t)(r->size + r->window) * r->width * sizeof(float));
+
+	return err;
+}
+
+// A ring of another size (a longer delay line after a reconfiguration)
+// hands its newest samples over, see ring_copy().
+static int get_ring(FILE *f, struct ring_s *r)
+{
+	struct ring_s *t;
+	int32_t dim[4];
+	int err = 0;
+
+	if (get(f, dim, sizeof(dim)) < 0 || dim[0] != r->width ||
+	    dim[1] < 16 || (dim[1] & (dim[1] - 1)) || dim[2] < 0 || dim[2] > dim[1])
+		return -1;
+
+	if (dim[1] == r->size && dim[2] == r->window) {
+		err |= get(f, r->buf, (size_t)(r->size + r->window) * r->width * sizeof(float));
+		r->pos = dim[3] & r->mask;
+		return err;
+	}
+
+	if ((t = init_ring(dim[1], dim[2], dim[0])) == NULL)
+		return -1;
+	err |= get(f, t->buf, (size_t)(t->size + t->window) * t->width * sizeof(float));
+	t->pos = dim[3] & t->mask;
+	if (!err)
+		ring_copy(r, t);
+	clear_ring(t);
+
+	return err;
+}
+
+static int put_nco(FILE *f, const struct nco_s *n)
+{
+	int32_t pos;
+	int err = put_flag(f, n);
+
+	if (n) {
+		pos = n->pos;
+		err |= put(f, &n->re, sizeof(n->re));
+		err |= put(f, &n->im, sizeof(n->im));
+		err |= put(f, &pos, sizeof(pos));
+		err |= put(f, &n->freq, sizeof(n->freq));
+		err |= put(f, &n->drift, sizeof(n->drift));
+	}
+
+	return err;
+}
+
+static int get_nco(FILE *f, struct nco_s *n)
+{
+	int32_t pos;
+	int err = get_flag(f, n);
+
+	if (n && !err) {
+		err |= get(f, &n->re, sizeof(n->re));
+		err |= get(f, &n->im, sizeof(n->im));
+		err |= get(f, &pos, sizeof(pos));
+		err |= get(f, &n->freq, sizeof(n->freq));
+		err |= get(f, &n->drift, sizeof(n->drift));
+		if (pos < 0 || pos >= NCO_PERIOD)
+			err = -1;
+		n->pos = pos;
+	}
+
+	return err;
+}
+
+static int put_noise(FILE *f, const struct noise_s *n)
+{
+	int err = put_flag(f, n);
+
+	if (n) {
+		err |= put(f, n->xv, sizeof(n->xv));
+		err |= put(f, n->yv, sizeof(n->yv));
+	}
+
+	return err;
+}
+
+static int get_noise(FILE *f, struct noise_s *n)
+{
+	int err = get_flag(f, n);
+
+	if (n && !err) {
+		err |= get(f, n->xv, sizeof(n->xv));
+		err |= get(f, n->yv, sizeof(n->yv));
+	}
+
+	return err;
+}
+
+static int put_filter(FILE *f, const struct filter_s *filter)
+{
+	float state[FILTER_IIR_STATE];
+	int err = put_flag(f, filter);
+
+	if (!filter)
+		return err;
+
+	err |= put_flag(f, filter->iir);
+	if (filter->iir) {
+		filter_get_state(filter, state);
+		err |= put(f, state, sizeof(state));
+	} else {
+		err |= put_ring(f, filter->hist);
+	}
+
+	return err;
+}
+
+static int get_filter(FILE *f, struct filter_s *filter)
+{
+	float state[FILTER_IIR_STATE];
+
+	if (get_flag(f, filter) < 0)
+		return -1;
+	if (!filter)
+		return 0;
+
+	if (get_flag(f, filter->iir) < 0)
+		return -1;
+	if (!filter->iir)
+		return get_ring(f, filter->hist);
+
+	if (get(f, state, sizeof(state)) < 0)
+		return -1;
+	filter_set_state(filter, state);
+
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Channel
+//----------------------------------------------------------------------------
+static int rng_valid(const struct rng_s *g)
+{
+	return g->f >= 0 && g->f < 31 && g->r >= 0 && g->r < 31;
+}
+
+static int put_channel(FILE *f, const struct channel_s *ch)
+{
+	int32_t counts[4] = { ch->rampleft, ch->pointsleft, ch->updrem, ch->silent };
+	int64_t samples = ch->samples;
+	int err = 0;
+
+	err |= put(f, &ch->parms, sizeof(ch->parms));
+	err |= put(f, &ch->rng, sizeof(ch->rng));
+	err |= put(f, &ch->rngq, sizeof(ch->rngq));
+	err |= put(f, &ch->SigLvl, sizeof(ch->SigLvl));
+	err |= put(f, &ch->SigStep, sizeof(ch->SigStep));
+	err |= put(f, &ch->SigTarget, sizeof(ch->SigTarget));
+	err |= put(f, counts, sizeof(counts));
+	err |= put(f, &samples, sizeof(samples));
+	err |= put(f, &ch->fade0, sizeof(ch->fade0));
+	err |= put(f, &ch->fade1, sizeof(ch->fade1));
+
+	err |= put_filter(f, ch->filter);
+
+	err |= put_flag(f, ch->rms);
+	if (ch->rms) {
+		err |= put_ring(f, ch->rms->hist);
+		err |= put(f, &ch->rms->counter, sizeof(ch->rms->counter));
+		err |= put(f, &ch->rms->rms, sizeof(ch->rms->rms));
+	}
+
+	err |= put_noise(f, ch->noise);
+	err |= put_noise(f, ch->noiseq);
+
+	err |= put_flag(f, ch->fade);
+	if (ch->fade) {
+		err |= put(f, ch->fade->IFade0, sizeof(ch->fade->IFade0));
+		err |= put(f, ch->fade->QFade0, sizeof(ch->fade->QFade0));
+		err |= put(f, ch->fade->IFade1, sizeof(ch->fade->IFade1));
+		err |= put(f, ch->fade->QFade1, sizeof(ch->fade->QFade1));
+	}
+
+	err |= put_flag(f, ch->delay);
+	if (ch->delay) {
+		err |= put(f, &ch->delay->taps, sizeof(ch->delay->taps));
+		err |= put_ring(f, ch->delay->line);
+	}
+
+	err |= put_nco(f, ch->offset);
+	err |= put_nco(f, ch->direct);
+	err |= put_nco(f, ch->delayed);
+
+	return err;
+}
+
+static int get_channel(FILE *f, struct channel_s *ch)
+{
+	int32_t counts[4];
+	int64_t samples;
+	int taps;
+	int err = 0;
+
+	err |= get(f, &ch->rng, sizeof(ch->rng));
+	err |= get(f, &ch->rngq, sizeof(ch->rngq));
+	err |= get(f, &ch->SigLvl, sizeof(ch->SigLvl));
+	err |= get(f, &ch->SigStep, sizeof(ch->SigStep));
+	err |= get(f, &ch->SigTarget, sizeof(ch->SigTarget));
+	err |= get(f, counts, sizeof(counts));
+	err |= get(f, &samples, sizeof(samples));
+	err |= get(f, &ch->fade0, sizeof(ch->fade0));
+	err |= get(f, &ch->fade1, sizeof(ch->fade1));
+	if (err || !rng_valid(&ch->rng) || !rng_valid(&ch->rngq))
+		return -1;
+	ch->rampleft = counts[0];
+	ch->pointsleft = counts[1];
+	ch->updrem = counts[2];
+	ch->silent = counts[3];
+	ch->samples = samples;
+
+	if (get_filter(f, ch->filter) < 0)
+		return -1;
+
+	if (get_flag(f, ch->rms) < 0)
+		return -1;
+	if (ch->rms) {
+		err |= get_ring(f, ch->rms->hist);
+		err |= get(f, &ch->rms->counter, sizeof(ch->rms->counter));
+		err |= get(f, &ch->rms->rms, sizeof(ch->rms->rms));
+	}
+
+	err |= get_noise(f, ch->noise);
+	err |= get_noise(f, ch->noiseq);
+	if (err)
+		return -1;
+
+	if (get_flag(f, ch->fade) < 0)
+		return -1;
+	if (ch->fade) {
+		err |= get(f, ch->fade->IFade0, sizeof(ch->fade->IFade0));
+		err |= get(f, ch->fade->QFade0, sizeof(ch->fade->QFade0));
+		err |= get(f, ch->fade->IFade1, sizeof(ch->fade->IFade1));
+		err |= get(f, ch->fade->QFade1, sizeof(ch->fade->QFade1));
+	}
+
+	if (get_flag(f, ch->delay) < 0)
+		return -1;
+	if (ch->delay) {
+		err |= get(f, &taps, sizeof(taps));
+		if (err || taps < 1 || taps > ch->delay->maxtaps)
+			return -1;
+		ch->delay->taps = taps;
+		err |= get_ring(f, ch->delay->line);
+	}
+
+	err |= get_nco(f, ch->offset);
+	err |= get_nco(f, ch->direct);
+	err |= get_nco(f, ch->delayed);
+
+	return err;
+}
+
+//----------------------------------------------------------------------------
+// Files
+//----------------------------------------------------------------------------
+// Settings init_channel() can take, from a file that may be anything.
+static int valid(const struct chan_parms_s *p)
+{
+	return p->simform >= 0 && p->simform <= 7 && p->noisetype >= 0 && p->noisetype <= 2 &&
+	       p->samplerate > 0 && p->bandwidth > 0.0F && p->bandwidth < p->samplerate &&
+	       (p->iq == 0 || p->iq == 1) &&
+	       p->hilbert >= FILTER_FIR && p->hilbert <= FILTER_IIR_BAND;
+}
+
+int save_snapshot(const char *path, const struct channel_s *ch, const struct nco_s *tone)
+{
+	uint16_t head[2] = { SNAPSHOT_VERSION, tone != NULL };
+	char *tmp;
+	FILE *f;
+	int err = 0;
+
+	if ((tmp = malloc(strlen(path) + 5)) == NULL)
+		return -1;
+	sprintf(tmp, "%s.tmp", path);
+
+	if ((f = fopen(tmp, "wb")) == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	err |= put(f, Magic, sizeof(Magic));
+	err |= put(f, head, sizeof(head));
+	err |= put_channel(f, ch);
+	if (tone)
+		err |= put_nco(f, tone);
+	err |= (fclose(f) != 0) ? -1 : 0;
+
+#ifdef _WIN32
+	// rename() does not replace a file here
+	if (!err)
+		remove(path);
+#endif
+	if (!err && rename(tmp, path) != 0)
+		err = -1;
+	if (err)
+		remove(tmp);
+	free(tmp);
+
+	return err;
+}
+
+struct channel_s *load_snapshot(const char *path, struct nco_s *tone)
+{
+	struct chan_parms_s parms;
+	struct channel_s *ch;
+	uint16_t head[2];
+	struct nco_s saved;
+	char magic[4];
+	FILE *f;
+
+	if ((f = fopen(path, "rb")) == NULL)
+		return NULL;
+
+	if (get(f, magic, sizeof(magic)) < 0 || memcmp(magic, Magic, sizeof(Magic)) ||
+	    get(f, head, sizeof(head)) < 0 || head[0] != SNAPSHOT_VERSION ||
+	    get(f, &parms, sizeof(parms)) < 0 || !valid(&parms) ||
+	    (ch = init_channel(&parms)) == NULL) {
+		fclose(f);
+		return NULL;
+	}
+
+	if (get_channel(f, ch) < 0 || ((head[1] & 1) && get_nco(f, &saved) < 0)) {
+		clear_channel(ch);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+
+	// the test tone keeps its frequency, the phase is restored
+	if ((head[1] & 1) && tone) {
+		tone->re = saved.re;
+		tone->im = saved.im;
+		tone->pos = saved.pos;
+	}
+
+	return ch;
+}
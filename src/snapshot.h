@@ -0,0 +1,63 @@
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include "channel.h"
+#include "nco.h"
+
+#define SNAPSHOT_INTERVAL	600	/* seconds of output between snapshots */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Snapshot of the complete state of a channel: its settings, the random
+ * number generator, the Hilbert transformer's history (or the IIR
+ * state), the RMS window, the noise and fading filters, the delay line,
+ * the shifters' phases, the SNR ramp and the position in the fading
+ * update and the sample count. A channel loaded from it goes on sample
+ * identical to the one saved.
+ *
+ * The fields are in host byte order, as laid out by the build that
+ * wrote them: a snapshot is meant for the same chansim version on the
+ * same kind of machine. The file starts with
+ *
+ *     char     magic[4]	"CHSS"
+ *     uint16   version		3
+ *     uint16   flags		bit 0: test oscillator saved
+ *
+ * followed by the channel:
+ *
+ *     struct chan_parms_s	settings
+ *     struct rng_s		rng, then rngq (quadrature noise)
+ *     float    SigLvl, SigStep, SigTarget
+ *     int32    rampleft, pointsleft, updrem, silent
+ *     int64    samples
+ *     complex  fade0, fade1
+ *     module   filter, rms, noise, noiseq, fade, delay,
+ *              offset, direct, delayed
+ *
+ * and the test oscillator if flagged. A module is a byte, 1 if present,
+ * and its state: a ring is int32 width, size, window, pos and its
+ * buffer; a shifter is float re, im, int32 pos (in the NCO_PERIOD),
+ * double freq, drift.
+ *
+ * The file is written next to 'path' and renamed, so a run killed
+ * while saving leaves the snapshot before.
+ */
+
+/* ---------------------------------------------------------------------- */
+
+/* saves 'ch' and the test oscillator 'tone' (NULL = none), returns 0 or -1 */
+extern int save_snapshot(const char *path, const struct channel_s *ch,
+			 const struct nco_s *tone);
+
+/*
+ * A new channel in the saved state, with its own scratch buffers. The
+ * test oscillator's phase goes to 'tone', if it was saved and 'tone' is
+ * not NULL. Returns NULL if 'path' cannot be read or is no snapshot of
+ * this build.
+ */
+extern struct channel_s *load_snapshot(const char *path, struct nco_s *tone);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _SNAPSHOT_H */
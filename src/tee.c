@@ -0,0 +1,323 @@
+//----------------------------------------------------------------------------
+// Tee mode: one input, many channels, see tee.h.
+//
+// The tee file has one line per output:
+//
+//     # file         settings
+//     poor.raw       chan=5 snr=10
+//     flutter.raw    chan=6 snr=10 seed=7
+//
+// The main thread reads a chunk of TEE_BLOCKS * CHAN_BLOCK samples and
+// runs the Hilbert transformer on it once. Then the workers (the main
+// thread being one of them) share the channels: each processes the
+// chunk from the analytic signal and writes its own file.
+//----------------------------------------------------------------------------
+
+#include "tee.h"
+#include "channel.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TEE_CHUNK	(TEE_BLOCKS * CHAN_BLOCK)
+
+struct tee_out_s {
+	char *path;
+	FILE *f;
+	struct chan_settings_s set;
+	struct channel_s *ch;
+	float *buf;			/* TEE_CHUNK samples or I/Q pairs */
+	int16_t *pcm;
+	int error;
+};
+
+static int N;				/* outputs */
+static int IQ;
+static float Gain;			/* input gain */
+static struct tee_out_s *Out;
+static struct channel_s *Src;		/* runs the Hilbert transformer */
+static struct chan_analytic_s *Analytic;	/* TEE_BLOCKS blocks */
+static float *In;			/* the chunk, I/Q pairs in IQ mode */
+static int Len;				/* samples in the chunk */
+
+//----------------------------------------------------------------------------
+// Tee file
+//----------------------------------------------------------------------------
+
+// Parse one "file settings" line into output 'k'. Returns an error
+// message or NULL.
+static const char *out_settings(char *line, const struct chan_parms_s *defaults, int k)
+{
+	struct tee_out_s *o = &Out[k];
+	const char *err;
+	char *path;
+	size_t len;
+
+	line += strspn(line, " \t");
+	len = strcspn(line, " \t");
+	if ((path = malloc(len + 1)) == NULL)
+		return "out of memory";
+	memcpy(path, line, len);
+	path[len] = 0;
+	o->path = path;
+
+	o->set.parms = *defaults;
+	o->set.parms.seed = defaults->seed + k;
+	o->set.gain = 1.0F;
+	o->set.ramp = 0.0F;
+	o->set.seeded = 0;
+	if ((err = parse_settings(&o->set, line + len)) != NULL)
+		return err;
+
+	// one input and one Hilbert transformer for all
+	if (o->set.gain != 1.0F)
+		return "the gain is the same for all outputs (-g)";
+	if (o->set.parms.samplerate != defaults->samplerate)
+		return "the sample rate is the same for all outputs";
+	if (o->set.parms.iq != defaults->iq)
+		return "IQ mode is the same for all outputs";
+	if (o->set.parms.hilbert != defaults->hilbert)
+		return "the Hilbert transformer is the same for all outputs (-H)";
+
+	return NULL;
+}
+
+static int read_tee(const char *path, const struct chan_parms_s *defaults)
+{
+	char line[CONTROL_LINE];
+	const char *err;
+	void *more;
+	FILE *f;
+	int n;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror("chansim: tee file");
+		return -1;
+	}
+
+	for (n = 1; fgets(line, sizeof(line), f); n++) {
+		line[strcspn(line, "#\r\n")] = 0;
+		if (line[strspn(line, " \t")] == 0)
+			continue;
+		if ((more = realloc(Out, (N + 1) * sizeof(struct tee_out_s))) == NULL) {
+			fclose(f);
+			return -1;
+		}
+		Out = more;
+		memset(&Out[N], 0, sizeof(struct tee_out_s));
+		if ((err = out_settings(line, defaults, N)) != NULL) {
+			fprintf(stderr, "chansim: %s:%d: %s\n", path, n, err);
+			fclose(f);
+			return -1;
+		}
+		N++;
+	}
+
+	fclose(f);
+	if (N == 0) {
+		fprintf(stderr, "chansim: %s: no outputs\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Worker pool. Output k belongs to worker k % workers.
+//----------------------------------------------------------------------------
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t Done = PTHREAD_COND_INITIALIZER;
+static int Workers;
+static int Round;			/* chunks started */
+static int Pending;			/* workers still busy with this chunk */
+
+static void process_output(struct tee_out_s *o, struct chan_work_s *work)
+{
+	int w = IQ ? 2 : 1;
+	int b, i, n, clipped = 0;
+	float x;
+
+	if (IQ) {
+		channel_process_iq_work(o->ch, work, (const float_complex *)In,
+					(float_complex *)o->buf, Len);
+	} else {
+		for (b = 0; b * CHAN_BLOCK < Len; b++) {
+			n = (Len - b * CHAN_BLOCK < CHAN_BLOCK) ? Len - b * CHAN_BLOCK : CHAN_BLOCK;
+			channel_process_analytic(o->ch, work, &Analytic[b], In + b * CHAN_BLOCK,
+						 o->buf + b * CHAN_BLOCK, n);
+		}
+	}
+
+	for (i = 0; i < w * Len; i++) {
+		x = o->buf[i];
+		if (x > 0.999F || x < -0.999F) {
+			x = (x > 0.0F) ? 0.999F : -0.999F;
+			clipped++;
+		}
+		o->pcm[i] = (int16_t)(x * 32768.0F);
+	}
+
+	if (clipped)
+		fprintf(stderr, "chansim: %s: clipping! (%d samples)\n", o->path, clipped);
+	if (!o->error && fwrite(o->pcm, w * sizeof(int16_t), Len, o->f) != (size_t)Len) {
+		fprintf(stderr, "chansim: %s: write error\n", o->path);
+		o->error = 1;
+	}
+}
+
+static void process_outputs(int w, struct chan_work_s *work)
+{
+	int k;
+
+	for (k = w; k < N; k += Workers)
+		process_output(&Out[k], work);
+}
+
+static void *worker(void *arg)
+{
+	int w = (int)(intptr_t)arg;
+	struct chan_work_s *work;
+	int round = 0;
+
+	if ((work = malloc(sizeof(struct chan_work_s))) == NULL) {
+		fprintf(stderr, "chansim: worker initialization failed\n");
+		exit(1);
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&Lock);
+		while (Round == round)
+			pthread_cond_wait(&Start, &Lock);
+		round = Round;
+		pthread_mutex_unlock(&Lock);
+
+		process_outputs(w, work);
+
+		pthread_mutex_lock(&Lock);
+		if (--Pending == 0)
+			pthread_cond_signal(&Done);
+		pthread_mutex_unlock(&Lock);
+	}
+
+	return NULL;
+}
+
+static void run_chunk(struct chan_work_s *work)
+{
+	pthread_mutex_lock(&Lock);
+	Round++;
+	Pending = Workers - 1;
+	pthread_cond_broadcast(&Start);
+	pthread_mutex_unlock(&Lock);
+
+	process_outputs(0, work);
+
+	pthread_mutex_lock(&Lock);
+	while (Pending > 0)
+		pthread_cond_wait(&Done, &Lock);
+	pthread_mutex_unlock(&Lock);
+}
+
+//----------------------------------------------------------------------------
+// Main loop
+//----------------------------------------------------------------------------
+int run_tee(const char *teefile, int workers, const struct chan_parms_s *defaults,
+	    float gain)
+{
+	struct chan_work_s *work;
+	struct chan_parms_s p;
+	struct tee_out_s *o;
+	int16_t *pcm;
+	int w = defaults->iq ? 2 : 1;
+	int b, i, k, n;
+	pthread_t tid;
+
+	IQ = defaults->iq;
+	Gain = gain;
+	if (read_tee(teefile, defaults) < 0)
+		return -1;
+	Workers = (workers < 1) ? 1 : (workers > N ? N : workers);
+
+	In = malloc(w * TEE_CHUNK * sizeof(float));
+	pcm = malloc(w * TEE_CHUNK * sizeof(int16_t));
+	Analytic = malloc(TEE_BLOCKS * sizeof(struct chan_analytic_s));
+	work = malloc(sizeof(struct chan_work_s));
+	if (!In || !pcm || !Analytic || !work) {
+		fprintf(stderr, "chansim: out of memory\n");
+		return -1;
+	}
+
+	p = *defaults;
+	p.amplitude *= Gain;
+	if (!IQ && (Src = init_channel_shared(&p)) == NULL) {
+		fprintf(stderr, "chansim: channel initialization failed\n");
+		return -1;
+	}
+
+	for (k = 0; k < N; k++) {
+		o = &Out[k];
+		p = o->set.parms;
+		p.amplitude *= Gain;
+		if ((o->ch = init_channel_shared(&p)) == NULL) {
+			fprintf(stderr, "chansim: channel initialization failed\n");
+			return -1;
+		}
+		o->buf = malloc(w * TEE_CHUNK * sizeof(float));
+		o->pcm = malloc(w * TEE_CHUNK * sizeof(int16_t));
+		if (!o->buf || !o->pcm) {
+			fprintf(stderr, "chansim: out of memory\n");
+			return -1;
+		}
+		o->f = strcmp(o->path, "-") ? fopen(o->path, "wb") : stdout;
+		if (o->f == NULL) {
+			perror(o->path);
+			return -1;
+		}
+	}
+
+	for (i = 1; i < Workers; i++) {
+		if (pthread_create(&tid, NULL, worker, (void *)(intptr_t)i)) {
+			perror("chansim: pthread_create");
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	fprintf(stderr, "Tee: %d outputs, %d worker(s)\n", N, Workers);
+	for (k = 0; k < N; k++) {
+		p = Out[k].set.parms;
+		fprintf(stderr, "\t%s: type %d, S/N ratio = %.1f dB, seed %u\n",
+			Out[k].path, p.simform, p.snr, p.seed);
+	}
+
+	while ((n = (int)fread(pcm, w * sizeof(int16_t), TEE_CHUNK, stdin)) > 0) {
+		for (i = 0; i < w * n; i++)
+			In[i] = pcm[i] * Gain / 32768.0F;
+		Len = n;
+
+		// the Hilbert transformer once for all outputs
+		if (!IQ) {
+			for (b = 0; b * CHAN_BLOCK < n; b++)
+				channel_analytic(Src, In + b * CHAN_BLOCK, &Analytic[b],
+						 (n - b * CHAN_BLOCK < CHAN_BLOCK) ? n - b * CHAN_BLOCK : CHAN_BLOCK);
+		}
+
+		run_chunk(work);
+	}
+
+	for (k = 0; k < N; k++) {
+		if (Out[k].f == stdout)
+			fflush(stdout);
+		else if (fclose(Out[k].f) != 0)
+			perror(Out[k].path);
+	}
+	free(pcm);
+	free(work);
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _TEE_H
+#define _TEE_H
+
+#include "channel.h"
+
+#define TEE_BLOCKS	16	/* CHAN_BLOCK blocks read and processed at once */
+
+/*
+ * Tee mode: the PCM on stdin goes through several channels, each
+ * writing its own file. 'teefile' holds one line per output: the file
+ * name ("-" for stdout), then key=value settings like in the daemon
+ * handshake. Settings not on a line are taken from 'defaults' (amplitude
+ * not scaled by 'gain'), the seed is that of 'defaults' plus the line's
+ * index. The input is read and Hilbert transformed once, with the
+ * bandwidth and transformer of 'defaults'. Returns nonzero on errors.
+ */
+extern int run_tee(const char *teefile, int workers, const struct chan_parms_s *defaults,
+		   float gain);
+
+#endif
@@ -0,0 +1,167 @@
+//----------------------------------------------------------------------------
+// Channel state export with a writer thread, see trace.h.
+//----------------------------------------------------------------------------
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TRACE_RECORD	32	/* bytes before the noise */
+
+struct trace_s {
+	FILE *f;
+	char *buf;			/* TRACE_BUFFER bytes */
+	size_t head, tail;		/* bytes put and written, ever */
+	int waiting;			/* writer waits for a chunk */
+	int done;
+	int error;
+	pthread_mutex_t lock;
+	pthread_cond_t more;		/* a chunk or the end is there */
+	pthread_cond_t room;		/* the writer made room */
+	pthread_t thread;
+};
+
+static void *writer(void *arg)
+{
+	struct trace_s *t = arg;
+	size_t n, pos;
+
+	pthread_mutex_lock(&t->lock);
+	for (;;) {
+		while (t->head - t->tail < TRACE_CHUNK && !t->done) {
+			t->waiting = 1;
+			pthread_cond_wait(&t->more, &t->lock);
+			t->waiting = 0;
+		}
+		if (t->head == t->tail)
+			break;
+
+		// the buffered bytes up to the buffer end
+		pos = t->tail % TRACE_BUFFER;
+		n = t->head - t->tail;
+		if (n > TRACE_BUFFER - pos)
+			n = TRACE_BUFFER - pos;
+		pthread_mutex_unlock(&t->lock);
+
+		if (!t->error && fwrite(t->buf + pos, 1, n, t->f) != n) {
+			perror("chansim: trace");
+			t->error = 1;
+		}
+
+		pthread_mutex_lock(&t->lock);
+		t->tail += n;
+		pthread_cond_signal(&t->room);
+	}
+	pthread_mutex_unlock(&t->lock);
+
+	return NULL;
+}
+
+// Append 'n' bytes, called with the lock held and room for them.
+static void put(struct trace_s *t, const void *data, size_t n)
+{
+	size_t pos = t->head % TRACE_BUFFER;
+	size_t c = (n < TRACE_BUFFER - pos) ? n : TRACE_BUFFER - pos;
+
+	memcpy(t->buf + pos, data, c);
+	memcpy(t->buf, (const char *)data + c, n - c);
+	t->head += n;
+}
+
+struct trace_s *init_trace(const char *path, int samplerate, int iq)
+{
+	struct trace_s *t;
+	char header[16];
+	uint16_t u16;
+	uint32_t u32;
+
+	if ((t = calloc(1, sizeof(struct trace_s))) == NULL)
+		return NULL;
+
+	if ((t->buf = malloc(TRACE_BUFFER)) == NULL) {
+		free(t);
+		return NULL;
+	}
+
+	if ((t->f = fopen(path, "wb")) == NULL) {
+		free(t->buf);
+		free(t);
+		return NULL;
+	}
+
+	memcpy(header, "CHST", 4);
+	u16 = 1;
+	memcpy(header + 4, &u16, 2);
+	u16 = iq ? 1 : 0;
+	memcpy(header + 6, &u16, 2);
+	u32 = (uint32_t)samplerate;
+	memcpy(header + 8, &u32, 4);
+	u32 = 0;
+	memcpy(header + 12, &u32, 4);
+	put(t, header, sizeof(header));
+
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->more, NULL);
+	pthread_cond_init(&t->room, NULL);
+	if (pthread_create(&t->thread, NULL, writer, t)) {
+		fclose(t->f);
+		free(t->buf);
+		free(t);
+		return NULL;
+	}
+
+	return t;
+}
+
+void clear_trace(struct trace_s *t)
+{
+	pthread_mutex_lock(&t->lock);
+	t->done = 1;
+	pthread_cond_signal(&t->more);
+	pthread_mutex_unlock(&t->lock);
+
+	pthread_join(t->thread, NULL);
+
+	fclose(t->f);
+	pthread_mutex_destroy(&t->lock);
+	pthread_cond_destroy(&t->more);
+	pthread_cond_destroy(&t->room);
+	free(t->buf);
+	free(t);
+}
+
+void trace_probe(void *arg, const struct chan_state_s *st)
+{
+	struct trace_s *t = arg;
+	char rec[TRACE_RECORD];
+	size_t nbytes = (st->iq ? 2 : 1) * st->n * sizeof(float);
+	uint64_t u64 = (uint64_t)st->sample;
+	uint32_t u32 = (uint32_t)st->n;
+	int32_t i32 = st->delay;
+	float g[4];
+
+	g[0] = crealf(st->fade0);
+	g[1] = cimagf(st->fade0);
+	g[2] = crealf(st->fade1);
+	g[3] = cimagf(st->fade1);
+
+	memcpy(rec, &u64, 8);
+	memcpy(rec + 8, &u32, 4);
+	memcpy(rec + 12, &i32, 4);
+	memcpy(rec + 16, g, 16);
+
+	pthread_mutex_lock(&t->lock);
+	while (TRACE_BUFFER - (t->head - t->tail) < TRACE_RECORD + nbytes)
+		pthread_cond_wait(&t->room, &t->lock);
+
+	put(t, rec, TRACE_RECORD);
+	put(t, st->noise, nbytes);
+
+	if (t->waiting && t->head - t->tail >= TRACE_CHUNK)
+		pthread_cond_signal(&t->more);
+	pthread_mutex_unlock(&t->lock);
+}
@@ -0,0 +1,57 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "channel.h"
+
+#define TRACE_BUFFER	(4 << 20)	/* bytes buffered for the writer */
+#define TRACE_CHUNK	(64 << 10)	/* bytes written at once */
+
+/* ---------------------------------------------------------------------- */
+
+/*
+ * Channel state export. The records of a probe go to a buffer, a
+ * writer thread saves them to a file or FIFO. The processing thread
+ * only waits if the writer is TRACE_BUFFER bytes behind.
+ *
+ * Fields are in host byte order. The file starts with a header:
+ *
+ *     char     magic[4]	"CHST"
+ *     uint16   version		1
+ *     uint16   flags		bit 0: IQ mode
+ *     uint32   samplerate
+ *     uint32   reserved	0
+ *
+ * followed by one record per segment of constant fading gains:
+ *
+ *     uint64   sample		first sample of the segment
+ *     uint32   n		samples in the segment
+ *     int32    delay		delayed path in samples, 0 = none
+ *     float32  fade0[2]	direct path gain (re, im)
+ *     float32  fade1[2]	delayed path gain (re, im)
+ *     float32  noise[n]	noise (and interference, -I) in the output,
+ *			n I/Q pairs in IQ mode
+ *
+ * The output is the fading sum plus the noise, with x the analytic
+ * (shifted) input and x' the delayed one:
+ *
+ *     two paths    re(x * fade0 + x' * fade1)
+ *                  IQ: (x * fade0 + x' * fade1) / sqrt(2)
+ *     flat         re(x * fade0) * sqrt(2)
+ *                  IQ: x * fade0
+ */
+struct trace_s;
+
+/* ---------------------------------------------------------------------- */
+
+/* opens 'path' (a FIFO blocks until there is a reader) and writes the header */
+extern struct trace_s *init_trace(const char *path, int samplerate, int iq);
+
+/* writes the rest and closes the file */
+extern void clear_trace(struct trace_s *);
+
+/* the probe, see channel_set_probe() */
+extern void trace_probe(void *trace, const struct chan_state_s *);
+
+/* ---------------------------------------------------------------------- */
+
+#endif  /* _TRACE_H */
@@ -0,0 +1,357 @@
+//----------------------------------------------------------------------------
+// Wideband mode: many independent HF channels in one IQ stream.
+//
+// A polyphase filter bank splits the complex baseband on stdin into m
+// sub-channels, rate/m apart. Every sub-channel runs through its own
+// channel (profile, SNR, noise and random numbers) at 2 * rate / m, then
+// the band is resynthesized to stdout, time aligned with the input.
+//
+// The map file sets single sub-channels or ranges, one per line:
+//
+//     # k    settings
+//     -3     snr=10 chan=5
+//     0:4    snr=20 chan=3 offset=1
+//
+// Sub-channel k (-m/2 ... m/2-1) is centered at k * rate / m. The settings
+// are those of the daemon handshake; rate, bw and iq are given by the filter
+// bank, gain scales the sub-channel. Sub-channels not in the file take the
+// command line settings. Control FIFO lines have the same format.
+//
+// The main thread runs the filter bank and the I/O. For every chunk of
+// frames the workers (the main thread being one of them) share the
+// sub-channels.
+//----------------------------------------------------------------------------
+
+#include "wideband.h"
+#include "channel.h"
+#include "control.h"
+#include "pfb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#define WB_FRAMES	64	/* filter bank frames per chunk */
+
+static int M, D;			/* sub-channels, samples per frame */
+static float Gain;			/* input gain */
+static struct pfb_s *Bank;
+static struct channel_s **Chan;
+static struct chan_settings_s *Set;	/* amplitude not scaled by the gains */
+static float_complex *Sub;		/* M rows of WB_FRAMES samples */
+static int Frames;			/* frames in the current chunk */
+
+//----------------------------------------------------------------------------
+// Sub-channel settings
+//----------------------------------------------------------------------------
+
+// Parse one "k settings" or "a:b settings" line. With 'live' set, the
+// running channels are reconfigured. Returns an error message or NULL.
+static const char *sub_settings(char *line, int live)
+{
+	struct chan_settings_s set;
+	struct chan_parms_s p;
+	char buf[CONTROL_LINE];
+	const char *err;
+	char *end;
+	long a, b, k;
+	int i;
+
+	a = b = strtol(line, &end, 10);
+	if (end == line)
+		return "expected a sub-channel";
+	if (*end == ':') {
+		line = end + 1;
+		b = strtol(line, &end, 10);
+		if (end == line)
+			return "expected a sub-channel range";
+	}
+	if (a < -M / 2 || b >= M / 2 || a > b)
+		return "no such sub-channel";
+	if (strlen(end) >= sizeof(buf))
+		return "line too long";
+
+	for (k = a; k <= b; k++) {
+		i = (int)((k + M) % M);
+
+		// parse_settings() cuts the line into tokens
+		strcpy(buf, end);
+		set = Set[i];
+		set.seeded = 0;
+		if ((err = parse_settings(&set, buf)) != NULL)
+			return err;
+		set.parms.samplerate = Set[i].parms.samplerate;
+		set.parms.bandwidth = Set[i].parms.bandwidth;
+		set.parms.iq = 1;
+
+		if (live) {
+			if (set.seeded)
+				return "the seed cannot be changed";
+			p = set.parms;
+			p.amplitude *= Gain * set.gain;
+			if (channel_reconfigure(Chan[i], &p, set.ramp) < 0)
+				return "reconfiguration failed";
+		}
+		Set[i] = set;
+	}
+
+	return NULL;
+}
+
+static int read_map(const char *path)
+{
+	char line[CONTROL_LINE];
+	const char *err;
+	FILE *f;
+	int n;
+
+	if ((f = fopen(path, "r")) == NULL) {
+		perror("chansim: map file");
+		return -1;
+	}
+
+	for (n = 1; fgets(line, sizeof(line), f); n++) {
+		line[strcspn(line, "#\r\n")] = 0;
+		if (line[strspn(line, " \t")] == 0)
+			continue;
+		if ((err = sub_settings(line, 0)) != NULL) {
+			fprintf(stderr, "chansim: %s:%d: %s\n", path, n, err);
+			fclose(f);
+			return -1;
+		}
+	}
+
+	fclose(f);
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Worker pool. Sub-channel k belongs to worker k % workers.
+//----------------------------------------------------------------------------
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t Done = PTHREAD_COND_INITIALIZER;
+static int Workers;
+static int Round;			/* chunks started */
+static int Pending;			/* workers still busy with this chunk */
+
+static void process_subchannels(int w, struct chan_work_s *work)
+{
+	float_complex *x;
+	float g;
+	int i, k;
+
+	for (k = w; k < M; k += Workers) {
+		x = Sub + k * WB_FRAMES;
+		if ((g = Set[k].gain) != 1.0F) {
+			for (i = 0; i < Frames; i++)
+				x[i] = make_float_complex(g * crealf(x[i]), g * cimagf(x[i]));
+		}
+		channel_process_iq_work(Chan[k], work, x, x, Frames);
+	}
+}
+
+static void *worker(void *arg)
+{
+	int w = (int)(intptr_t)arg;
+	struct chan_work_s *work;
+	int round = 0;
+
+	if ((work = malloc(sizeof(struct chan_work_s))) == NULL) {
+		fprintf(stderr, "chansim: worker initialization failed\n");
+		exit(1);
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&Lock);
+		while (Round == round)
+			pthread_cond_wait(&Start, &Lock);
+		round = Round;
+		pthread_mutex_unlock(&Lock);
+
+		process_subchannels(w, work);
+
+		pthread_mutex_lock(&Lock);
+		if (--Pending == 0)
+			pthread_cond_signal(&Done);
+		pthread_mutex_unlock(&Lock);
+	}
+
+	return NULL;
+}
+
+static void run_chunk(struct chan_work_s *work)
+{
+	pthread_mutex_lock(&Lock);
+	Round++;
+	Pending = Workers - 1;
+	pthread_cond_broadcast(&Start);
+	pthread_mutex_unlock(&Lock);
+
+	process_subchannels(0, work);
+
+	pthread_mutex_lock(&Lock);
+	while (Pending > 0)
+		pthread_cond_wait(&Done, &Lock);
+	pthread_mutex_unlock(&Lock);
+}
+
+//----------------------------------------------------------------------------
+// Main loop
+//----------------------------------------------------------------------------
+int run_wideband(int subch, int workers, const struct chan_parms_s *defaults,
+		 float gain, const char *mapfile, const char *control)
+{
+	struct control_s *ctl = NULL;
+	struct chan_work_s *work;
+	struct chan_parms_s p;
+	float_complex *frame, *buf;
+	int16_t *pcm;
+	long long total = 0, fed = 0;
+	int chunk, delay, eof = 0, clipped;
+	int i, k, f, n;
+	pthread_t tid;
+	const char *err;
+	char *line;
+	float x;
+
+	if ((Bank = init_pfb(subch)) == NULL) {
+		fprintf(stderr, "chansim: the number of sub-channels must be a power of 2\n");
+		return -1;
+	}
+	M = subch;
+	D = Bank->d;
+	Gain = gain;
+	Workers = (workers < 1) ? 1 : (workers > M ? M : workers);
+	chunk = WB_FRAMES * D;
+	delay = pfb_delay(Bank);
+
+	if (defaults->samplerate % D) {
+		fprintf(stderr, "chansim: the sample rate must be a multiple of %d\n", D);
+		return -1;
+	}
+
+	Chan = calloc(M, sizeof(struct channel_s *));
+	Set = calloc(M, sizeof(struct chan_settings_s));
+	Sub = malloc(M * WB_FRAMES * sizeof(float_complex));
+	frame = malloc(M * sizeof(float_complex));
+	buf = malloc(chunk * sizeof(float_complex));
+	pcm = malloc(chunk * 2 * sizeof(int16_t));
+	work = malloc(sizeof(struct chan_work_s));
+	if (!Chan || !Set || !Sub || !frame || !buf || !pcm || !work) {
+		fprintf(stderr, "chansim: out of memory\n");
+		return -1;
+	}
+
+	// sub-channels differ in seed only, until the map file says otherwise
+	for (k = 0; k < M; k++) {
+		Set[k].parms = *defaults;
+		Set[k].parms.samplerate = 2 * defaults->samplerate / M;
+		Set[k].parms.bandwidth = (float)defaults->samplerate / M;
+		Set[k].parms.iq = 1;
+		Set[k].parms.seed = defaults->seed + k;
+		Set[k].gain = 1.0F;
+	}
+	if (mapfile && read_map(mapfile) < 0)
+		return -1;
+
+	for (k = 0; k < M; k++) {
+		p = Set[k].parms;
+		p.amplitude *= Gain * Set[k].gain;
+		if ((Chan[k] = init_channel_shared(&p)) == NULL) {
+			fprintf(stderr, "chansim: channel initialization failed\n");
+			return -1;
+		}
+	}
+
+	if (control && (ctl = init_control(control)) == NULL) {
+		perror("chansim: control FIFO");
+		return -1;
+	}
+
+	for (i = 1; i < Workers; i++) {
+		if (pthread_create(&tid, NULL, worker, (void *)(intptr_t)i)) {
+			perror("chansim: pthread_create");
+			return -1;
+		}
+		pthread_detach(tid);
+	}
+
+	fprintf(stderr, "Wideband: %d sub-channels, %.1f Hz apart, %d sps each, %d worker(s)\n",
+		M, (float)defaults->samplerate / M, Set[0].parms.samplerate, Workers);
+
+	// The output is delayed by the filter bank: skip the first 'delay'
+	// samples and flush with zeros at the end.
+	while (!eof || fed < total + delay) {
+		if (ctl) {
+			while ((line = control_line(ctl)) != NULL) {
+				if ((err = sub_settings(line, 1)) != NULL)
+					fprintf(stderr, "chansim: control: %s\n", err);
+			}
+		}
+
+		n = eof ? 0 : (int)fread(pcm, 2 * sizeof(int16_t), chunk, stdin);
+		if (n < chunk)
+			eof = 1;
+		total += n;
+
+		for (i = 0; i < n; i++)
+			buf[i] = make_float_complex(pcm[2 * i] * Gain / 32768.0F,
+						    pcm[2 * i + 1] * Gain / 32768.0F);
+		for (; i < chunk; i++)
+			buf[i] = make_float_complex(0.0F, 0.0F);
+
+		Frames = WB_FRAMES;
+		if (eof && (total + delay - fed + D - 1) / D < Frames)
+			Frames = (int)((total + delay - fed + D - 1) / D);
+
+		for (f = 0; f < Frames; f++) {
+			pfb_analyze(Bank, buf + f * D, frame);
+			for (k = 0; k < M; k++)
+				Sub[k * WB_FRAMES + f] = frame[k];
+		}
+
+		run_chunk(work);
+
+		for (f = 0; f < Frames; f++) {
+			for (k = 0; k < M; k++)
+				frame[k] = Sub[k * WB_FRAMES + f];
+			pfb_synthesize(Bank, frame, buf + f * D);
+		}
+
+		// samples fed - delay ... are the input samples of this chunk
+		clipped = 0;
+		for (i = n = 0; i < Frames * D; i++) {
+			if (fed + i < delay || fed + i - delay >= total)
+				continue;
+			x = crealf(buf[i]);
+			if (x > 0.999F || x < -0.999F) {
+				x = (x > 0.0F) ? 0.999F : -0.999F;
+				clipped++;
+			}
+			pcm[n++] = (int16_t)(x * 32768.0F);
+			x = cimagf(buf[i]);
+			if (x > 0.999F || x < -0.999F) {
+				x = (x > 0.0F) ? 0.999F : -0.999F;
+				clipped++;
+			}
+			pcm[n++] = (int16_t)(x * 32768.0F);
+		}
+		fed += Frames * D;
+
+		if (clipped)
+			fprintf(stderr, "chansim: clipping! (%d samples)\n", clipped);
+		if (n && fwrite(pcm, 2 * sizeof(int16_t), n / 2, stdout) != (size_t)n / 2)
+			break;
+	}
+
+	fflush(stdout);
+	free(frame);
+	free(buf);
+	free(pcm);
+	free(work);
+
+	return 0;
+}
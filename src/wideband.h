@@ -0,0 +1,16 @@
+#ifndef _WIDEBAND_H
+#define _WIDEBAND_H
+
+#include "channel.h"
+
+/*
+ * Split the complex baseband on stdin into 'subch' sub-channels, run
+ * each through its own channel and write the resynthesized band to
+ * stdout. 'defaults' (amplitude not scaled by 'gain') is the wideband
+ * setting, 'mapfile' and 'control' (both may be NULL) change single
+ * sub-channels. Returns nonzero on errors.
+ */
+extern int run_wideband(int subch, int workers, const struct chan_parms_s *defaults,
+			float gain, const char *mapfile, const char *control);
+
+#endif
@@ -0,0 +1,141 @@
+//----------------------------------------------------------------------------
+// The output of a channel must not depend on how its input is cut into
+// blocks: a pipe delivers whatever the reads return, a rendering run
+// ends on a short block and a snapshot is taken between two blocks.
+//
+// Each setting is run twice with the same seed, once in CHAN_BLOCK
+// blocks and once in blocks of random lengths, and the outputs are
+// compared bit by bit. Exit status 0 if all are the same.
+//----------------------------------------------------------------------------
+
+#include "channel.h"
+#include "filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEN		40000	/* samples per run */
+
+struct setting_s {
+	const char *name;
+	int simform, noisetype, iq;
+	float amplitude;
+	float offset, drift, doppler0, doppler1;
+	float ramp;		/* to 0 dB over this time after the start */
+};
+
+static const struct setting_s Settings[] = {
+	{ "noise only",		0, 0, 0, 0.0F },
+	{ "flat",		1, 0, 0, 0.0F },
+	{ "poor",		5, 0, 0, 0.0F },
+	{ "extreme laplace",	7, 1, 0, 0.1F },
+	{ "noise only iq",	0, 0, 1, 0.0F },
+	{ "flat iq",		1, 0, 1, 0.0F },
+	{ "good iq",		3, 0, 1, 0.0F },
+	{ "poor iq",		5, 0, 1, 0.1F },
+	{ "flutter iq laplace",	6, 1, 1, 0.0F },
+	{ "extreme iq impulse",	7, 2, 1, 0.0F },
+	{ "offset",		1, 0, 0, 0.0F, 30.0F },
+	{ "drift doppler",	5, 0, 0, 0.0F, -20.0F, 3.0F, 1.0F, -2.0F },
+	{ "offset iq",		3, 0, 1, 0.0F, 150.0F },
+	{ "drift doppler iq",	7, 1, 1, 0.1F, 40.0F, -5.0F, 0.5F, 2.5F },
+	{ "snr ramp",		3, 0, 0, 0.0F, 0.0F, 0.0F, 0.0F, 0.0F, 3.0F },
+	{ "snr ramp iq",	5, 0, 1, 0.1F, 0.0F, 0.0F, 0.0F, 0.0F, 4.0F },
+};
+
+static float In[2 * LEN], Out[2][2 * LEN];
+
+// A fixed test signal, the same for every run.
+static void make_input(int nval)
+{
+	unsigned int x = 12345;
+	int i;
+
+	for (i = 0; i < nval; i++) {
+		x = x * 1103515245U + 12345U;
+		In[i] = ((int)(x >> 16 & 0x7fff) - 16384) / 65536.0F;
+	}
+}
+
+// 'cut' 0: CHAN_BLOCK blocks, else random lengths up to 2 CHAN_BLOCK.
+static int run(const struct setting_s *s, int cut, float *out)
+{
+	struct chan_parms_s p;
+	struct channel_s *ch;
+	unsigned int x = 777;
+	int i, n;
+
+	memset(&p, 0, sizeof(p));
+	p.snr = 10.0F;
+	p.simform = s->simform;
+	p.noisetype = s->noisetype;
+	p.samplerate = 8000;
+	p.bandwidth = 3000.0F;
+	p.amplitude = s->amplitude;
+	p.offset = s->offset;
+	p.drift = s->drift;
+	p.doppler0 = s->doppler0;
+	p.doppler1 = s->doppler1;
+	p.seed = 42;
+	p.iq = s->iq;
+	p.hilbert = FILTER_FIR;
+	if ((ch = init_channel(&p)) == NULL)
+		return -1;
+	if (s->ramp > 0.0F) {
+		p.snr = 0.0F;
+		if (channel_reconfigure(ch, &p, s->ramp) < 0) {
+			clear_channel(ch);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < LEN; i += n) {
+		if (cut) {
+			x = x * 1103515245U + 12345U;
+			n = 1 + (int)(x >> 16) % (2 * CHAN_BLOCK);
+		} else {
+			n = CHAN_BLOCK;
+		}
+		if (n > LEN - i)
+			n = LEN - i;
+		if (s->iq)
+			channel_process_iq(ch, (const float_complex *)In + i,
+					   (float_complex *)out + i, n);
+		else
+			channel_process(ch, In + i, out + i, n);
+	}
+
+	clear_channel(ch);
+
+	return 0;
+}
+
+int main(void)
+{
+	const int count = sizeof(Settings) / sizeof(Settings[0]);
+	int k, i, nval, failed = 0;
+
+	for (k = 0; k < count; k++) {
+		const struct setting_s *s = &Settings[k];
+
+		nval = s->iq ? 2 * LEN : LEN;
+		make_input(nval);
+		if (run(s, 0, Out[0]) < 0 || run(s, 1, Out[1]) < 0) {
+			printf("%-20s channel initialization failed\n", s->name);
+			failed++;
+			continue;
+		}
+
+		for (i = 0; i < nval && Out[0][i] == Out[1][i]; i++)
+			;
+		if (i < nval) {
+			printf("%-20s differs from value %d on\n", s->name, i);
+			failed++;
+		} else {
+			printf("%-20s ok\n", s->name);
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+//----------------------------------------------------------------------------
+// Each lane of a channel group must give the same output as a channel of
+// its own with the lane's seed (see group.h): group.c runs the kernel's
+// steps across the lanes, so a change to the kernel that is not made
+// there too shows up here.
+//
+// Every channel type, noise type and IQ setting is run once as a group
+// and once as GROUP_LANES single channels, and the outputs are compared
+// bit by bit. The settings also switch the automatic amplitude and the
+// shifters on and off. Exit status 0 if all are the same.
+//----------------------------------------------------------------------------
+
+#include "channel.h"
+#include "filter.h"
+#include "group.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEN		16000	/* samples per lane */
+#define L		GROUP_LANES
+
+static float In[2 * LEN * L], Out[2 * LEN * L];
+static float Lane[2 * LEN], Single[2 * LEN];
+static struct group_work_s Work;
+
+// A fixed test signal, different in every lane.
+static void make_input(int nval)
+{
+	unsigned int x = 12345;
+	int i;
+
+	for (i = 0; i < nval; i++) {
+		x = x * 1103515245U + 12345U;
+		In[i] = ((int)(x >> 16 & 0x7fff) - 16384) / 65536.0F;
+	}
+}
+
+static void set_parms(struct chan_parms_s *p, int simform, int noisetype, int iq)
+{
+	memset(p, 0, sizeof(*p));
+	p->snr = 10.0F;
+	p->simform = simform;
+	p->noisetype = noisetype;
+	p->samplerate = 8000;
+	p->bandwidth = 3000.0F;
+	p->amplitude = ((simform + noisetype) & 1) ? 0.1F : 0.0F;
+	if (noisetype == 1) {
+		p->offset = 25.0F;
+		p->drift = 2.0F;
+	} else if (noisetype == 2) {
+		p->doppler0 = 1.5F;
+		p->doppler1 = -2.0F;
+	}
+	p->seed = 42;
+	p->iq = iq;
+	p->hilbert = FILTER_FIR;
+}
+
+// Compare lane 'l' of Out with its own channel. Returns the first value
+// that differs, or -1.
+static int check_lane(const struct chan_parms_s *p, int l)
+{
+	const int w = p->iq ? 2 : 1;
+	struct chan_parms_s q = *p;
+	struct channel_s *ch;
+	int i, c, n;
+
+	q.seed = p->seed + l;
+	if ((ch = init_channel(&q)) == NULL)
+		return 0;
+
+	for (i = 0; i < LEN; i++) {
+		for (c = 0; c < w; c++)
+			Lane[i * w + c] = In[(i * L + l) * w + c];
+	}
+	for (i = 0; i < LEN; i += n) {
+		n = (LEN - i < CHAN_BLOCK) ? LEN - i : CHAN_BLOCK;
+		if (p->iq)
+			channel_process_iq(ch, (const float_complex *)Lane + i,
+					   (float_complex *)Single + i, n);
+		else
+			channel_process(ch, Lane + i, Single + i, n);
+	}
+	clear_channel(ch);
+
+	for (i = 0; i < LEN * w; i++) {
+		if (Single[i] != Out[(i / w * L + l) * w + i % w])
+			return i;
+	}
+
+	return -1;
+}
+
+int main(void)
+{
+	struct chan_parms_s p;
+	struct chan_group_s *g;
+	int simform, noisetype, iq, l, at, failed = 0;
+
+	for (iq = 0; iq <= 1; iq++) {
+		make_input((iq + 1) * LEN * L);
+		for (simform = 0; simform <= 7; simform++) {
+			for (noisetype = 0; noisetype <= 2; noisetype++) {
+				set_parms(&p, simform, noisetype, iq);
+				printf("type %d noise %d%s ", simform, noisetype, iq ? " iq" : "   ");
+
+				if ((g = init_group(&p)) == NULL) {
+					printf("group initialization failed\n");
+					failed++;
+					continue;
+				}
+				group_process(g, &Work, In, Out, LEN);
+				clear_group(g);
+
+				for (l = 0, at = -1; l < L && at < 0; l++)
+					at = check_lane(&p, l);
+				if (at >= 0) {
+					printf("lane %d differs from value %d on\n", l - 1, at);
+					failed++;
+				} else {
+					printf("ok\n");
+				}
+			}
+		}
+	}
+
+	return failed ? 1 : 0;
+}